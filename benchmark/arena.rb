@@ -0,0 +1,41 @@
+# Large write transactions with and without a dirty page arena.
+#
+# Each transaction rewrites random keys of a database big enough that
+# most of them dirty a page of their own, and stores a few values that
+# need overflow pages. Without an arena every dirty page and overflow
+# run is malloc'd and freed; with one they come from a single mapping
+# that is reset when the transaction ends.
+#
+#   ruby -Ilib benchmark/arena.rb [txns] [puts per txn]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+txns  = (ARGV[0] || 20).to_i
+batch = (ARGV[1] || 50_000).to_i
+keys  = 1_000_000
+
+Dir.mktmpdir do |dir|
+  LMDB.new(dir, :mapsize => 1 << 33, :nosync => true) do |env|
+    db = env.database
+    env.transaction { keys.times { |i| db.put('%08d' % i, 'v' * 100, :append => true) } }
+  end
+
+  [{}, { :arena => 1 << 30 }, { :arena => 1 << 30, :hugepages => :thp }].each do |opts|
+    LMDB.new(dir, **{ :mapsize => 1 << 33, :nosync => true }.merge(opts)) do |env|
+      db = env.database
+      rng = Random.new(42)
+      time = Benchmark.realtime do
+        txns.times do
+          env.transaction do
+            batch.times { db.put('%08d' % rng.rand(keys), 'w' * 100) }
+            10.times { |i| db.put("big#{i}", 'x' * 100_000) }
+          end
+        end
+      end
+      printf("%-28s %.3fs (%.2f us per put) %s\n", opts.empty? ? 'malloc' : opts.inspect,
+             time, time * 1e6 / (txns * batch), env.arena_stat.inspect)
+    end
+  end
+end
@@ -0,0 +1,37 @@
+# Write throughput with durable commits versus nosync with auto_sync.
+#
+# Commits small transactions for a few seconds, once syncing on every
+# commit and once with :nosync and a background sync every interval.
+# Samples the sync lag while writing, which bounds what a crash would
+# lose, and prints the sync latencies reported by sync_stat.
+#
+#   ruby -Ilib benchmark/auto_sync.rb [seconds] [interval] [max_dirty_bytes]
+
+require 'lmdb'
+require 'tmpdir'
+
+seconds   = (ARGV[0] || 3).to_f
+interval  = (ARGV[1] || 0.1).to_f
+max_dirty = (ARGV[2] || 0).to_i
+
+[:commit, :auto_sync].each do |mode|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 32, :nosync => mode == :auto_sync) do |env|
+      db = env.database
+      env.auto_sync(:interval => interval, :max_dirty_bytes => max_dirty) if mode == :auto_sync
+      lag, n = 0, 0
+      stop = Time.now + seconds
+      while Time.now < stop
+        env.transaction { 10.times { |i| db.put('%08d%02d' % [n, i], 'v' * 100) } }
+        n += 1
+        lag = [lag, env.sync_stat[:lag]].max if mode == :auto_sync && n % 100 == 0
+      end
+      printf("%-9s %8.0f txns/s", mode, n / seconds)
+      if stat = env.sync_stat
+        printf(", %d syncs, latency mean %.2fms max %.2fms, max lag %.3fs",
+               stat[:syncs], stat[:mean_latency] * 1e3, stat[:max_latency] * 1e3, lag)
+      end
+      puts
+    end
+  end
+end
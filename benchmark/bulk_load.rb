@@ -0,0 +1,34 @@
+# Compare loading sorted data with Database#put(:append) against
+# Database#bulk_load.
+#
+#   ruby -Ilib benchmark/bulk_load.rb [rows] [value size]
+
+require 'lmdb'
+require 'benchmark'
+require 'fileutils'
+require 'tmpdir'
+
+rows  = (ARGV[0] || 1_000_000).to_i
+vsize = (ARGV[1] || 64).to_i
+value = 'x' * vsize
+pairs = Enumerator.new { |y| rows.times { |i| y << ['%012d' % i, value] } }
+
+Dir.mktmpdir do |dir|
+  mapsize = [rows * (vsize + 64) * 3, 1 << 26].max
+
+  [['put :append', lambda { |db| pairs.each { |k, v| db.put(k, v, :append => true) } }],
+   ['bulk_load',   lambda { |db| db.bulk_load(pairs) }],
+   ['bulk_load 0.8', lambda { |db| db.bulk_load(pairs, :fill => 0.8) }]].each do |name, load|
+    path = File.join(dir, name.tr(' :.', '_'))
+    FileUtils.mkpath(path)
+    LMDB.new(path, :mapsize => mapsize) do |env|
+      db = env.database
+      time = Benchmark.realtime { env.transaction { load.call(db) } }
+      stat = db.stat
+      size = File.size(File.join(path, 'data.mdb'))
+      printf("%-14s %8.2fs %10.0f rows/s %8.1f MB/s  leaf pages %d, branch pages %d, depth %d\n",
+             name, time, rows / time, size / time / 1e6,
+             stat[:leaf_pages], stat[:branch_pages], stat[:depth])
+    end
+  end
+end
@@ -0,0 +1,97 @@
+/* Expiring a range of keys: a cursor deleting the first record of the
+ * range until none is left, which copies and rebalances every page it
+ * passes, against mdb_del_range(), which frees the subtrees inside the
+ * range as they are and only edits the pages along its two ends. Dirty
+ * pages counts the pages each leaves in the transaction's dirty list,
+ * freed pages those it adds to the free list.
+ *
+ *   cc -O2 -Iext/lmdb_ext/liblmdb -o delete_range \
+ *      benchmark/delete_range.c ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./delete_range [keys]
+ */
+#include "mdb.c"
+#include <time.h>
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int keys = argc > 1 ? atoi(argv[1]) : 1000000, i, ranged;
+	char dir[] = "/tmp/delete_rangeXXXXXX", path[64], buf[32], fbuf[32], tbuf[32];
+	char value[100];
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_cursor *mc;
+	MDB_val key, data, from, to;
+	size_t count;
+	double t;
+	int rc;
+
+	if (!mkdtemp(dir) || mdb_env_create(&env) || mdb_env_set_mapsize(env, 1UL << 34) ||
+		mdb_env_open(env, dir, MDB_NOSYNC, 0644)) {
+		fprintf(stderr, "cannot open %s\n", dir);
+		return 1;
+	}
+	memset(value, 'v', sizeof(value));
+	data.mv_size = sizeof(value);
+	data.mv_data = value;
+	mdb_txn_begin(env, NULL, 0, &txn);
+	mdb_dbi_open(txn, NULL, 0, &dbi);
+	mdb_cursor_open(txn, dbi, &mc);
+	for (i = 0; i < keys; i++) {
+		key.mv_size = sprintf(buf, "%016u", i);
+		key.mv_data = buf;
+		mdb_cursor_put(mc, &key, &data, MDB_APPEND);
+	}
+	mdb_cursor_close(mc);
+	mdb_txn_commit(txn);
+
+	/* delete the middle half of the keys */
+	from.mv_size = sprintf(fbuf, "%016u", keys / 4);
+	from.mv_data = fbuf;
+	to.mv_size = sprintf(tbuf, "%016u", keys / 4 * 3);
+	to.mv_data = tbuf;
+	printf("%u keys, deleting %u\n", keys, keys / 4 * 3 - keys / 4);
+	for (ranged = 0; ranged <= 1; ranged++) {
+		mdb_txn_begin(env, NULL, 0, &txn);
+		t = now();
+		if (ranged) {
+			mdb_del_range(txn, dbi, &from, &to, &count);
+		} else {
+			mdb_cursor_open(txn, dbi, &mc);
+			count = 0;
+			for (;;) {
+				key = from;
+				if (mdb_cursor_get(mc, &key, &data, MDB_SET_RANGE) ||
+					mdb_cmp(txn, dbi, &key, &to) >= 0)
+					break;
+				if ((rc = mdb_cursor_del(mc, 0)) != 0) {
+					fprintf(stderr, "cursor_del: %s\n", mdb_strerror(rc));
+					break;
+				}
+				count++;
+			}
+			mdb_cursor_close(mc);
+		}
+		t = now() - t;
+		printf("%-12s %8.1f ms  %7zu deleted  %6u dirty pages  %6u freed pages\n",
+			ranged ? "del_range" : "cursor_del", t * 1e3, count,
+			(unsigned)txn->mt_u.dirty_list[0].mid + (unsigned)(txn->mt_spill_pgs ? txn->mt_spill_pgs[0] : 0),
+			(unsigned)txn->mt_free_pgs[0]);
+		mdb_txn_abort(txn);
+	}
+	mdb_env_close(env);
+	sprintf(path, "%s/data.mdb", dir);
+	unlink(path);
+	sprintf(path, "%s/lock.mdb", dir);
+	unlink(path);
+	rmdir(dir);
+	return 0;
+}
@@ -0,0 +1,36 @@
+# Update random keys in one large write transaction.
+#
+# A first pass rewrites every page, so the timed transaction takes its
+# pages from the freelist, highest page number first, and its dirty list
+# grows out of page order. Runs the same transaction with a few dirty
+# page budgets; smaller budgets spill pages to disk during the
+# transaction.
+#
+#   ruby -Ilib benchmark/dirty.rb [keys] [updates] [maxdirty,...]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+keys     = (ARGV[0] || 2_000_000).to_i
+updates  = (ARGV[1] || 1_000_000).to_i
+budgets  = (ARGV[2] || '4096,131071,1048576').split(',').map(&:to_i)
+
+budgets.each do |maxdirty|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 34, :nosync => true, :maxdirty => maxdirty) do |env|
+      db = env.database
+      db.bulk_load((0...keys).lazy.map { |i| ['%010d' % i, 'v' * 40] })
+      env.transaction { (0...keys).step(50) { |i| db.put('%010d' % i, 'w' * 40) } }
+      # Two empty commits so the freed pages become reusable
+      2.times { env.transaction { db.put('pad', '') } }
+
+      random = Random.new(1)
+      time = Benchmark.realtime do
+        env.transaction { updates.times { db.put('%010d' % random.rand(keys), 'u' * 40) } }
+      end
+      printf("maxdirty %8d: %d updates in %.3fs (%.2f us per update), last page %d\n",
+             maxdirty, updates, time, time * 1e6 / updates, env.info[:last_pgno])
+    end
+  end
+end
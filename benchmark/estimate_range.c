@@ -0,0 +1,108 @@
+/* Sizing ranges of keys: counting the records of each range with a
+ * cursor, whose cost grows with the range, against mdb_estimate_range(),
+ * which only looks up the two ends. The keys are inserted in random
+ * order so the pages are unevenly filled, and the error is given as a
+ * share of all the records.
+ *
+ *   cc -O2 -Iext/lmdb_ext/liblmdb -o estimate_range \
+ *      benchmark/estimate_range.c ext/lmdb_ext/liblmdb/mdb.c \
+ *      ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./estimate_range [keys] [ranges]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "lmdb.h"
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int keys = argc > 1 ? atoi(argv[1]) : 1000000;
+	unsigned int ranges = argc > 2 ? atoi(argv[2]) : 1000, i, a, b;
+	char dir[] = "/tmp/estimate_rangeXXXXXX", path[64], buf[32], fbuf[32], tbuf[32];
+	char value[100];
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_cursor *mc;
+	MDB_val key, data, from, to;
+	MDB_stat st, total;
+	size_t counted = 0, diff, maxdiff = 0;
+	double t, tcount = 0, testimate = 0, sumdiff = 0;
+
+	if (!mkdtemp(dir) || mdb_env_create(&env) || mdb_env_set_mapsize(env, 1UL << 34) ||
+		mdb_env_open(env, dir, MDB_NOSYNC, 0644)) {
+		fprintf(stderr, "cannot open %s\n", dir);
+		return 1;
+	}
+	memset(value, 'v', sizeof(value));
+	srandom(1);
+	mdb_txn_begin(env, NULL, 0, &txn);
+	mdb_dbi_open(txn, NULL, 0, &dbi);
+	for (i = 0; i < keys; i++) {
+		key.mv_size = sprintf(buf, "%016u", (unsigned)(i * 2654435761U % keys));
+		key.mv_data = buf;
+		data.mv_size = 1 + random() % sizeof(value);
+		data.mv_data = value;
+		mdb_put(txn, dbi, &key, &data, 0);
+	}
+	mdb_txn_commit(txn);
+
+	mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+	mdb_stat(txn, dbi, &total);
+	mdb_cursor_open(txn, dbi, &mc);
+	for (i = 0; i < ranges; i++) {
+		a = random() % keys;
+		b = a + random() % (keys - a + 1);
+		from.mv_size = sprintf(fbuf, "%016u", a);
+		from.mv_data = fbuf;
+		to.mv_size = sprintf(tbuf, "%016u", b);
+		to.mv_data = tbuf;
+
+		t = now();
+		counted = 0;
+		key = from;
+		if (!mdb_cursor_get(mc, &key, &data, MDB_SET_RANGE)) {
+			do {
+				if (mdb_cmp(txn, dbi, &key, &to) >= 0)
+					break;
+				counted++;
+			} while (!mdb_cursor_get(mc, &key, &data, MDB_NEXT));
+		}
+		tcount += now() - t;
+
+		t = now();
+		mdb_estimate_range(txn, dbi, &from, &to, &st);
+		testimate += now() - t;
+
+		diff = st.ms_entries > counted ? st.ms_entries - counted : counted - st.ms_entries;
+		sumdiff += diff;
+		if (diff > maxdiff)
+			maxdiff = diff;
+	}
+	mdb_cursor_close(mc);
+	mdb_txn_abort(txn);
+
+	printf("%u keys, depth %u, %u ranges\n", keys, total.ms_depth, ranges);
+	printf("cursor count %10.2f us/range\n", tcount * 1e6 / ranges);
+	printf("estimate     %10.2f us/range  mean error %.3f%%  max error %.3f%%\n",
+		testimate * 1e6 / ranges, sumdiff * 100 / ranges / total.ms_entries,
+		maxdiff * 100.0 / total.ms_entries);
+
+	mdb_env_close(env);
+	sprintf(path, "%s/data.mdb", dir);
+	unlink(path);
+	sprintf(path, "%s/lock.mdb", dir);
+	unlink(path);
+	rmdir(dir);
+	return 0;
+}
@@ -0,0 +1,51 @@
+# Page fill and page counts for different split ratios and merge
+# thresholds.
+#
+# "ascending" inserts keys in order except for one in five, which goes
+# up to 50 keys back. "churn" loads random keys, then deletes 60% of
+# them and puts them back, five times. The histogram counts leaf pages
+# by fill in steps of 10%.
+#
+#   ruby -Ilib benchmark/fill.rb [keys]
+
+require 'lmdb'
+require 'tmpdir'
+
+keys = (ARGV[0] || 200_000).to_i
+
+def ascending(keys, rng)
+  Array.new(keys) { |i| '%010d' % (i * 100 + (rng.rand(5) == 0 ? -rng.rand(50) * 100 + 50 : 0)) }
+end
+
+def churn(keys, rng)
+  Array.new(keys) { '%010d' % rng.rand(1 << 32) }.uniq
+end
+
+[[:ascending, {}], [:ascending, { :split_ratio => 0.9, :merge_threshold => 0.1 }],
+ [:churn, {}], [:churn, { :merge_threshold => 0.1 }]].each do |workload, options|
+  rng = Random.new(42)
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 32, :nosync => true) do |env|
+      db = env.database(nil, **options)
+      names = send(workload, keys, rng)
+
+      t = Time.now
+      names.each_slice(1000) do |slice|
+        env.transaction { slice.each { |k| db.put(k, 'value') } }
+      end
+      if workload == :churn
+        5.times do
+          gone = names.sample(keys * 3 / 5, random: rng)
+          env.transaction { gone.each { |k| db.delete(k) } }
+          env.transaction { gone.each { |k| db.put(k, 'value') } }
+        end
+      end
+      time = Time.now - t
+
+      stat = db.stat
+      printf("%-9s %-51s leaves %6d  depth %d  %5.2fs  %s\n",
+             workload, options.inspect, stat[:leaf_pages], stat[:depth], time,
+             db.fill_histogram[:leaf].inspect)
+    end
+  end
+end
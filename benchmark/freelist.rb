@@ -0,0 +1,36 @@
+# Allocate multi-page overflow values from a fragmented freelist.
+#
+# Fills a database with single-page overflow values and deletes every
+# other one, so the freelist holds many pages but no contiguous runs.
+# Then writes large values, each needing a run of contiguous pages, in
+# batches of one transaction each.
+#
+#   ruby -Ilib benchmark/freelist.rb [fragments] [blob size] [blobs per txn]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+fragments = (ARGV[0] || 200_000).to_i
+blob_size = (ARGV[1] || 64 << 10).to_i
+batch     = (ARGV[2] || 100).to_i
+
+Dir.mktmpdir do |dir|
+  LMDB.new(dir, :mapsize => 1 << 34, :nosync => true) do |env|
+    db = env.database
+    small = 'x' * 3000
+    env.transaction { fragments.times { |i| db.put('%010d' % i, small) } }
+    env.transaction { (0...fragments).step(2) { |i| db.delete('%010d' % i) } }
+    # Two empty commits so the freed pages become reusable
+    2.times { env.transaction { db.put('pad', '') } }
+
+    blob = 'b' * blob_size
+    5.times do |round|
+      time = Benchmark.realtime do
+        env.transaction { batch.times { |i| db.put("blob#{round}-#{i}", blob) } }
+      end
+      printf("round %d: %d blobs of %d KB in %.3fs (%.2f ms per blob), last page %d\n",
+             round, batch, blob_size >> 10, time, time * 1000 / batch, env.info[:last_pgno])
+    end
+  end
+end
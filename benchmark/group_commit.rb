@@ -0,0 +1,51 @@
+# Concurrent small write transactions, with and without group commit.
+#
+# Every thread runs its own write transactions of a few puts each.
+# Without group commit the threads take turns behind a mutex, so each
+# transaction pays for its own sync. With :group_commit they share one
+# LMDB transaction and one sync per batch. Prints throughput, the
+# median and 99th percentile latency, and transactions per commit.
+#
+#   ruby -Ilib benchmark/group_commit.rb [threads,...] [txns per thread] [puts per txn]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+counts = (ARGV[0] || '1,4,16,64').split(',').map(&:to_i)
+txns   = (ARGV[1] || 100).to_i
+batch  = (ARGV[2] || 4).to_i
+
+def run(env, group, threads, txns, batch)
+  db = env.database
+  lock = Mutex.new unless group
+  latencies = Queue.new
+  first = env.info[:last_txnid]
+  time = Benchmark.realtime do
+    threads.times.map do |t|
+      Thread.new do
+        txns.times do |n|
+          start = Time.now
+          work = proc { env.transaction { batch.times { |i| db.put('%04d%06d%02d' % [t, n, i], 'v' * 100) } } }
+          lock ? lock.synchronize(&work) : work.call
+          latencies << Time.now - start
+        end
+      end
+    end.each(&:join)
+  end
+  sorted = Array.new(latencies.size) { latencies.pop }.sort
+  [time, sorted[sorted.size / 2], sorted[sorted.size * 99 / 100], env.info[:last_txnid] - first]
+end
+
+counts.each do |threads|
+  [false, true].each do |group|
+    Dir.mktmpdir do |dir|
+      LMDB.new(dir, :mapsize => 1 << 30, :group_commit => group) do |env|
+        time, median, p99, commits = run(env, group, threads, txns, batch)
+        total = threads * txns
+        printf("%-6s %3d threads: %7.0f txns/s, median %7.2fms, p99 %7.2fms, %5.1f txns per commit\n",
+               group ? 'group' : 'mutex', threads, total / time, median * 1e3, p99 * 1e3, total.to_f / commits)
+      end
+    end
+  end
+end
@@ -0,0 +1,36 @@
+# Compare loading shuffled data with Database#put against Database#ingest,
+# with different memory budgets for the sort.
+#
+#   ruby -Ilib benchmark/ingest.rb [rows] [value size]
+
+require 'lmdb'
+require 'benchmark'
+require 'fileutils'
+require 'tmpdir'
+
+rows  = (ARGV[0] || 1_000_000).to_i
+vsize = (ARGV[1] || 64).to_i
+value = 'x' * vsize
+keys  = (0...rows).to_a.shuffle(:random => Random.new(42))
+pairs = Enumerator.new { |y| keys.each { |i| y << ['%012d' % i, value] } }
+
+Dir.mktmpdir do |dir|
+  mapsize = [rows * (vsize + 64) * 3, 1 << 26].max
+
+  [['put',          lambda { |db| pairs.each { |k, v| db.put(k, v) } }],
+   ['ingest 4M',    lambda { |db| db.ingest(pairs, :memory => 4 << 20, :tmpdir => dir) }],
+   ['ingest 64M',   lambda { |db| db.ingest(pairs, :tmpdir => dir) }],
+   ['ingest 512M',  lambda { |db| db.ingest(pairs, :memory => 512 << 20, :tmpdir => dir) }]].each do |name, load|
+    path = File.join(dir, name.tr(' ', '_'))
+    FileUtils.mkpath(path)
+    LMDB.new(path, :mapsize => mapsize) do |env|
+      db = env.database
+      result = nil
+      time = Benchmark.realtime { env.transaction { result = load.call(db) } }
+      stat = db.stat
+      printf("%-12s %8.2fs %10.0f rows/s  leaf pages %d, depth %d", name, time, rows / time, stat[:leaf_pages], stat[:depth])
+      printf(",  %d runs, %.1f MB spilled, peak RSS %.0f MB", result[:runs], result[:spilled] / 1e6, result[:peak_rss] / 1e6) if Hash === result
+      puts
+    end
+  end
+end
@@ -0,0 +1,45 @@
+# Commit latency with and without :io_uring.
+#
+# Loads a database of values that each fill a page, then commits
+# transactions that update 10, 1k and 100k random values, so about as
+# many scattered pages are dirty. Without :io_uring they are written
+# with one writev per run of contiguous pages and then synced; with it
+# they are queued on a ring and submitted together with the sync. Count
+# the system calls with strace, e.g.
+#
+#   strace -f -c ruby -Ilib benchmark/io_uring.rb
+#
+#   ruby -Ilib benchmark/io_uring.rb [entries]
+
+require 'lmdb'
+require 'tmpdir'
+
+entries = (ARGV[0] || 200_000).to_i
+value   = 'v' * 3000
+
+Dir.mktmpdir do |dir|
+  LMDB.new(dir, :mapsize => 1 << 33) do |env|
+    db = env.database
+    env.transaction { entries.times { |i| db.put('%08d' % i, value, :append => true) } }
+  end
+
+  [false, true].each do |io_uring|
+    LMDB.new(dir, :mapsize => 1 << 33, :io_uring => io_uring) do |env|
+      db = env.database
+      name = env.flags.include?(:io_uring) ? 'io_uring' : 'writev'
+      rng = Random.new(42)
+      [[10, 100], [1_000, 10], [100_000, 2]].each do |pages, commits|
+        total = 0
+        commits.times do
+          t = nil
+          env.transaction do
+            pages.times { db.put('%08d' % rng.rand(entries), value) }
+            t = Time.now
+          end
+          total += Time.now - t
+        end
+        printf("%-8s %6d pages %10.3fms per commit\n", name, pages, total / commits * 1e3)
+      end
+    end
+  end
+end
@@ -0,0 +1,125 @@
+/* Search of integer LEAF2 (DUPFIXED) pages: the binary search through
+ * the comparison function that mdb_node_search() uses for other keys,
+ * against mdb_leaf2_search(). Each page is filled with sorted random
+ * keys and searched for random present and absent keys.
+ *
+ *   cc -O2 -DMDB_USE_SIMD -Iext/lmdb_ext/liblmdb -o leaf2_search \
+ *      benchmark/leaf2_search.c ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./leaf2_search [page size]
+ */
+#include "mdb.c"
+#include <time.h>
+
+#define PROBES	(1 << 16)
+#define ROUNDS	200
+
+static MDB_cmp_func *volatile leaf2_cmp;
+static volatile unsigned int sink;
+
+static unsigned int
+cmp_search(MDB_page *mp, MDB_val *key)
+{
+	MDB_cmp_func *cmp = leaf2_cmp;
+	MDB_val nodekey;
+	int low = 0, high = NUMKEYS(mp) - 1, rc = 0;
+	unsigned int i = 0;
+
+	nodekey.mv_size = key->mv_size;
+	while (low <= high) {
+		i = (low + high) >> 1;
+		nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size);
+		rc = cmp(key, &nodekey);
+		if (rc == 0)
+			break;
+		if (rc > 0)
+			low = i + 1;
+		else
+			high = i - 1;
+	}
+	return rc > 0 ? i + 1 : i;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t
+rnd(void)
+{
+	return ((size_t)random() << 33) ^ ((size_t)random() << 2) ^ random();
+}
+
+static int
+cmp_sort(const void *a, const void *b)
+{
+	MDB_val va, vb;
+	va.mv_size = vb.mv_size = leaf2_cmp == mdb_cmp_int ? sizeof(int) : sizeof(size_t);
+	va.mv_data = (void *)a;
+	vb.mv_data = (void *)b;
+	return leaf2_cmp(&va, &vb);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int psize = argc > 1 ? atoi(argv[1]) : 4096;
+	MDB_page *mp = calloc(1, psize);
+	char *probes;
+	unsigned int ksize, nkeys, i, r, sum;
+	double t, old, new;
+	MDB_val key;
+
+	mdb_count_init();
+	for (ksize = sizeof(int); ksize <= sizeof(size_t); ksize += sizeof(size_t) - sizeof(int)) {
+		leaf2_cmp = ksize == sizeof(int) ? mdb_cmp_int : mdb_cmp_long;
+		nkeys = (psize - PAGEHDRSZ) / ksize;
+		mp->mp_flags = P_LEAF|P_LEAF2;
+		mp->mp_lower = PAGEHDRSZ + nkeys * sizeof(indx_t);
+		for (i = 0; i < nkeys; i++) {
+			size_t x = rnd();
+			memcpy(LEAF2KEY(mp, i, ksize), &x, ksize);
+		}
+		qsort(METADATA(mp), nkeys, ksize, cmp_sort);
+
+		probes = malloc(PROBES * ksize);
+		for (i = 0; i < PROBES; i++) {
+			size_t x = rnd();
+			memcpy(probes + i * ksize, i & 1 ? (void *)&x : LEAF2KEY(mp, x % nkeys, ksize), ksize);
+		}
+		key.mv_size = ksize;
+
+		for (i = 0; i < PROBES; i++) {
+			key.mv_data = probes + i * ksize;
+			if (cmp_search(mp, &key) != mdb_leaf2_search(mp, &key)) {
+				fprintf(stderr, "mismatch at probe %u\n", i);
+				return 1;
+			}
+		}
+
+		sum = 0;
+		t = now();
+		for (r = 0; r < ROUNDS; r++)
+			for (i = 0; i < PROBES; i++) {
+				key.mv_data = probes + i * ksize;
+				sum += cmp_search(mp, &key);
+			}
+		old = now() - t;
+		t = now();
+		for (r = 0; r < ROUNDS; r++)
+			for (i = 0; i < PROBES; i++) {
+				key.mv_data = probes + i * ksize;
+				sum += mdb_leaf2_search(mp, &key);
+			}
+		new = now() - t;
+		sink = sum;
+
+		printf("%u-byte keys, %4u per page  compare %6.2f ns  leaf2 %6.2f ns\n",
+			ksize, nkeys, old * 1e9 / ROUNDS / PROBES, new * 1e9 / ROUNDS / PROBES);
+		free(probes);
+	}
+	free(mp);
+	return 0;
+}
@@ -0,0 +1,33 @@
+# Commit latency of writemap environments against the map size.
+#
+# Each environment holds the same small database; only :mapsize
+# differs, and with :writemap the data file is grown to the full map
+# size. Commits that update a handful of keys then only have to sync
+# the pages they dirtied, however large the map is.
+#
+#   ruby -Ilib benchmark/msync.rb [commits]
+
+require 'lmdb'
+require 'tmpdir'
+
+commits = (ARGV[0] || 200).to_i
+
+[30, 34, 37, 39].each do |bits|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << bits, :writemap => true) do |env|
+      db = env.database
+      env.transaction { 10_000.times { |i| db.put('%08d' % i, 'x' * 100, :append => true) } }
+      rng = Random.new(42)
+      total = 0
+      commits.times do
+        t = nil
+        env.transaction do
+          10.times { db.put('%08d' % rng.rand(10_000), 'y' * 100) }
+          t = Time.now
+        end
+        total += Time.now - t
+      end
+      printf("%4dGB map %10.3fms per commit\n", 1 << (bits - 30), total / commits * 1e3)
+    end
+  end
+end
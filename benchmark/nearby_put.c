@@ -0,0 +1,116 @@
+/* Inserting batches of keys into a populated database: mdb_put and
+ * mdb_cursor_put, which descend from the root for every key, against
+ * mdb_cursor_put with MDB_NEARBY, which starts from the leaf of the
+ * previous put. Clustered batches are sorted keys from a narrow range,
+ * as when loading a day's worth of events; random batches are spread
+ * over the whole database, where the hint cannot help.
+ *
+ *   cc -O2 -Iext/lmdb_ext/liblmdb -o nearby_put \
+ *      benchmark/nearby_put.c ext/lmdb_ext/liblmdb/mdb.c \
+ *      ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./nearby_put [keys]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define BATCH	10000
+#define BATCHES	50
+
+enum { PUT, CURSOR_PUT, NEARBY_PUT };
+static const char *const names[] = { "mdb_put", "cursor_put", "nearby" };
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int keys = argc > 1 ? atoi(argv[1]) : 1000000, i, b, how, batch[BATCH];
+	char dir[] = "/tmp/nearby_putXXXXXX", path[64], buf[32], name[4];
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi[3];
+	MDB_cursor *mc;
+	MDB_val key, data;
+	int clustered;
+	double t;
+
+	if (!mkdtemp(dir) || mdb_env_create(&env) || mdb_env_set_mapsize(env, 1UL << 34) ||
+		mdb_env_set_maxdbs(env, 3) || mdb_env_open(env, dir, MDB_NOSYNC|MDB_WRITEMAP, 0644)) {
+		fprintf(stderr, "cannot open %s\n", dir);
+		return 1;
+	}
+	data.mv_size = 8;
+	data.mv_data = "payload";
+	mdb_txn_begin(env, NULL, 0, &txn);
+	for (how = PUT; how <= NEARBY_PUT; how++) {
+		sprintf(name, "d%u", how);
+		mdb_dbi_open(txn, name, MDB_CREATE, &dbi[how]);
+		mdb_cursor_open(txn, dbi[how], &mc);
+		for (i = 0; i < keys; i++) {
+			key.mv_size = sprintf(buf, "%016u", i * 4);
+			key.mv_data = buf;
+			mdb_cursor_put(mc, &key, &data, MDB_APPEND);
+		}
+		mdb_cursor_close(mc);
+	}
+	mdb_txn_commit(txn);
+
+	printf("%u keys, batches of %u\n", keys, BATCH);
+	for (clustered = 1; clustered >= 0; clustered--) {
+		printf("%-9s", clustered ? "clustered" : "random");
+		for (how = PUT; how <= NEARBY_PUT; how++) {
+			srandom(clustered);
+			t = 0;
+			for (b = 0; b < BATCHES; b++) {
+				unsigned int base = random() % keys;
+				for (i = 0; i < BATCH; i++) {
+					if (clustered)
+						batch[i] = (base + random() % (BATCH * 4)) % keys * 4 + 1 + random() % 3;
+					else
+						batch[i] = random() % keys * 4 + 1 + random() % 3;
+				}
+				if (clustered)
+					qsort(batch, BATCH, sizeof(batch[0]), cmp_uint);
+				mdb_txn_begin(env, NULL, 0, &txn);
+				mdb_cursor_open(txn, dbi[how], &mc);
+				t -= now();
+				for (i = 0; i < BATCH; i++) {
+					key.mv_size = sprintf(buf, "%016u", batch[i]);
+					key.mv_data = buf;
+					if (how == PUT)
+						mdb_put(txn, dbi[how], &key, &data, 0);
+					else
+						mdb_cursor_put(mc, &key, &data, how == NEARBY_PUT ? MDB_NEARBY : 0);
+				}
+				t += now();
+				mdb_cursor_close(mc);
+				mdb_txn_commit(txn);
+			}
+			printf("  %s %6.1f ns", names[how], t * 1e9 / (BATCH * BATCHES));
+		}
+		printf("\n");
+	}
+	mdb_env_close(env);
+	sprintf(path, "%s/data.mdb", dir);
+	unlink(path);
+	sprintf(path, "%s/lock.mdb", dir);
+	unlink(path);
+	rmdir(dir);
+	return 0;
+}
@@ -0,0 +1,197 @@
+/* Tree descents with the node searches specialized for the default
+ * comparison functions, against the binary search calling the
+ * comparison function for every probe that mdb_node_search() keeps
+ * for custom comparators. Each database gets a million keys of one
+ * kind, and the same random keys are looked up with both searches.
+ *
+ *   cc -O2 -Iext/lmdb_ext/liblmdb -o node_search \
+ *      benchmark/node_search.c ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./node_search [keys]
+ */
+#include "mdb.c"
+#include <time.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <x86intrin.h>
+#define CYCLES()	__rdtsc()
+#else
+#define CYCLES()	0
+#endif
+
+#define PROBES	(1 << 20)
+
+enum { SHORT, LONG, INT, LONG_UNIFORM, LONG_CLUSTERED };
+static const char *kinds[] = {
+	"16-byte strings", "40-byte strings", "4-byte integers",
+	"8-byte integers", "8-byte clusters"
+};
+
+static size_t
+rnd(void)
+{
+	return ((size_t)random() << 33) ^ ((size_t)random() << 2) ^ random();
+}
+
+static size_t
+make_key(int kind, char *buf)
+{
+	size_t x = rnd();
+	unsigned int u = x;
+
+	switch (kind) {
+	case SHORT:
+		return sprintf(buf, "%016zx", x);
+	case LONG:
+		return sprintf(buf, "tenant/%04zu/objects/%016zx/", x % 100, x >> 8);
+	case INT:
+		memcpy(buf, &u, sizeof(u));
+		return sizeof(u);
+	case LONG_CLUSTERED:
+		x = (x % 64) << 48 | (x & 0xfffff);
+		/* FALLTHRU */
+	default:
+		memcpy(buf, &x, sizeof(x));
+		return sizeof(x);
+	}
+}
+
+/** The search loop for custom comparison functions */
+static unsigned int
+generic_search(MDB_cursor *mc, MDB_page *mp, MDB_val *key, int *exactp)
+{
+	MDB_cmp_func *cmp = mc->mc_dbx->md_cmp;
+	MDB_val nodekey;
+	MDB_node *node;
+	int low = IS_LEAF(mp) ? 0 : 1, high = NUMKEYS(mp) - 1, rc = 0;
+	unsigned int i = 0;
+
+	if (cmp == mdb_cmp_cint && IS_BRANCH(mp))
+		cmp = NODEPTR(mp, 1)->mn_ksize == sizeof(size_t) ? mdb_cmp_long : mdb_cmp_int;
+	while (low <= high) {
+		i = (low + high) >> 1;
+		node = NODEPTR(mp, i);
+		nodekey.mv_size = NODEKSZ(node);
+		nodekey.mv_data = NODEKEY(node);
+		rc = cmp(key, &nodekey);
+		if (rc == 0)
+			break;
+		if (rc > 0)
+			low = i + 1;
+		else
+			high = i - 1;
+	}
+	*exactp = rc == 0;
+	return rc > 0 ? i + 1 : i;
+}
+
+/** Descend from the root to the leaf holding a key */
+static int
+descend(MDB_cursor *mc, MDB_val *key, int generic)
+{
+	MDB_page *mp;
+	unsigned int i;
+	int exact;
+
+	mdb_page_get(mc->mc_txn, mc->mc_db->md_root, &mp, NULL);
+	mc->mc_top = 0;
+	mc->mc_snum = 1;
+	for (;;) {
+		mc->mc_pg[0] = mp;
+		if (generic) {
+			i = generic_search(mc, mp, key, &exact);
+		} else {
+			mdb_node_search(mc, key, &exact);
+			i = mc->mc_ki[0];
+		}
+		if (IS_LEAF(mp))
+			return exact;
+		if (i >= NUMKEYS(mp))
+			i = NUMKEYS(mp) - 1;
+		else if (!exact)
+			i--;
+		mdb_page_get(mc->mc_txn, NODEPGNO(NODEPTR(mp, i)), &mp, NULL);
+	}
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int keys = argc > 1 ? atoi(argv[1]) : 1000000, i;
+	char dir[] = "/tmp/node_searchXXXXXX", *probes;
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_cursor *mc;
+	MDB_val key, data;
+	int kind, generic, found;
+	unsigned long long c;
+	double t;
+
+	if (!mkdtemp(dir) || mdb_env_create(&env) || mdb_env_set_mapsize(env, 1UL << 32) ||
+		mdb_env_set_maxdbs(env, 8) || mdb_env_open(env, dir, MDB_NOSYNC, 0644)) {
+		fprintf(stderr, "cannot open %s\n", dir);
+		return 1;
+	}
+	probes = malloc((size_t)PROBES * 64);
+	data.mv_size = 8;
+	data.mv_data = "payload";
+
+	for (kind = SHORT; kind <= LONG_CLUSTERED; kind++) {
+		mdb_txn_begin(env, NULL, 0, &txn);
+		mdb_dbi_open(txn, kinds[kind], MDB_CREATE | (kind >= INT ? MDB_INTEGERKEY : 0), &dbi);
+		srandom(kind);
+		for (i = 0; i < keys; i++) {
+			char buf[64];
+			key.mv_data = buf;
+			key.mv_size = make_key(kind, buf);
+			mdb_put(txn, dbi, &key, &data, 0);
+		}
+		mdb_txn_commit(txn);
+
+		/* Replay the same sequence so every probe is present */
+		srandom(kind);
+		for (i = 0; i < PROBES; i++) {
+			if (i % keys == 0)
+				srandom(kind);
+			*(unsigned char *)(probes + i * 64) = make_key(kind, probes + i * 64 + 1);
+		}
+
+		mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+		mdb_cursor_open(txn, dbi, &mc);
+		printf("%-16s depth %u", kinds[kind], mc->mc_db->md_depth);
+		for (generic = 1; generic >= 0; generic--) {
+			found = 0;
+			t = now();
+			c = CYCLES();
+			for (i = 0; i < PROBES; i++) {
+				key.mv_size = *(unsigned char *)(probes + i * 64);
+				key.mv_data = probes + i * 64 + 1;
+				found += descend(mc, &key, generic);
+			}
+			c = CYCLES() - c;
+			t = now() - t;
+			if (found != PROBES)
+				fprintf(stderr, "only found %d keys\n", found);
+			printf("  %s %6.1f ns %5.0f cycles", generic ? "compare" : "inlined",
+				t * 1e9 / PROBES, (double)c / PROBES);
+		}
+		printf("\n");
+		mdb_cursor_close(mc);
+		mdb_txn_abort(txn);
+	}
+	mdb_env_close(env);
+	free(probes);
+	snprintf(probes = malloc(sizeof(dir) + 16), sizeof(dir) + 16, "%s/data.mdb", dir);
+	unlink(probes);
+	sprintf(probes, "%s/lock.mdb", dir);
+	unlink(probes);
+	rmdir(dir);
+	free(probes);
+	return 0;
+}
@@ -0,0 +1,38 @@
+# Tree depth and throughput against the page size.
+#
+# Each environment gets the same keys with values of 2-8KB, which at
+# the default page size all go to overflow pages. Larger pages keep
+# them in the leaves and make the tree shallower.
+#
+#   ruby -Ilib benchmark/pagesize.rb [keys]
+
+require 'lmdb'
+require 'tmpdir'
+
+keys = (ARGV[0] || 50_000).to_i
+rng = Random.new(42)
+values = Array.new(keys) { 'x' * rng.rand(2048..8192) }
+order = (0...keys).to_a.shuffle(random: rng)
+
+[4096, 8192, 16384, 32768].each do |pagesize|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :pagesize => pagesize, :mapsize => 1 << 32, :nosync => true) do |env|
+      db = env.database
+
+      t = Time.now
+      order.each_slice(1000) do |slice|
+        env.transaction { slice.each { |i| db.put('%08d' % i, values[i]) } }
+      end
+      write = Time.now - t
+
+      t = Time.now
+      env.transaction(true) { order.each { |i| db.get('%08d' % i) } }
+      read = Time.now - t
+
+      stat = db.stat
+      printf("%6d page  depth %d  leaves %7d  overflow %7d  %9.0f puts/s  %9.0f gets/s\n",
+             pagesize, stat[:depth], stat[:leaf_pages], stat[:overflow_pages],
+             keys / write, keys / read)
+    end
+  end
+end
@@ -0,0 +1,42 @@
+# Durable write throughput of group commits with and without pipelining.
+#
+# Threads run small write transactions for a few seconds, which
+# :group_commit shares. Without :pipeline the next batch can only begin
+# once the previous one is synced; with it, the next batch is built
+# while the previous one is being flushed. The overlap saves at most the
+# time to build a batch, which is small next to a sync, so expect the
+# two to be close.
+#
+#   ruby -Ilib benchmark/pipeline.rb [seconds] [threads]
+
+require 'lmdb'
+require 'tmpdir'
+
+seconds   = (ARGV[0] || 3).to_f
+nthreads  = (ARGV[1] || 16).to_i
+
+def run(seconds, nthreads)
+  stop = Time.now + seconds
+  counts = Array.new(nthreads, 0)
+  nthreads.times.map do |t|
+    Thread.new do
+      n = 0
+      while Time.now < stop
+        yield t, n
+        n += 1
+      end
+      counts[t] = n
+    end
+  end.each(&:join)
+  counts.sum / seconds
+end
+
+[false, true].each do |pipeline|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 32, :pipeline => pipeline, :group_commit => true) do |env|
+      db = env.database
+      rate = run(seconds, nthreads) { |t, n| env.transaction { db.put('%02d%08d' % [t, n], 'v' * 100) } }
+      printf("%-11s %8.0f commits/s\n", pipeline ? 'pipeline' : 'no pipeline', rate)
+    end
+  end
+end
@@ -0,0 +1,40 @@
+# Leaf page density, tree depth and lookups with :prefixkey.
+#
+# The keys share a long tenant/namespace/date prefix, as in an index
+# keyed by path. With :prefixkey each leaf page stores that prefix
+# once, so pages hold more entries and the tree gets shallower.
+#
+#   ruby -Ilib benchmark/prefixkey.rb [keys]
+
+require 'lmdb'
+require 'tmpdir'
+
+keys = (ARGV[0] || 200_000).to_i
+rng = Random.new(42)
+names = Array.new(keys) do |i|
+  'tenant/%04d/namespace/events/2014-%02d-%02d/%08d' % [i % 16, i % 12 + 1, i % 28 + 1, i]
+end
+order = (0...keys).to_a.shuffle(random: rng)
+
+[false, true].each do |prefixkey|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 32, :nosync => true) do |env|
+      db = env.database(nil, :prefixkey => prefixkey)
+
+      t = Time.now
+      order.each_slice(1000) do |slice|
+        env.transaction { slice.each { |i| db.put(names[i], 'value') } }
+      end
+      write = Time.now - t
+
+      t = Time.now
+      env.transaction(true) { order.each { |i| db.get(names[i]) } }
+      read = Time.now - t
+
+      stat = db.stat
+      printf("%-10s depth %d  leaves %6d  %6.1f entries/leaf  %9.0f puts/s  %6.2f us/get\n",
+             prefixkey ? 'prefixkey' : 'plain', stat[:depth], stat[:leaf_pages],
+             keys.to_f / stat[:leaf_pages], keys / write, read * 1e6 / keys)
+    end
+  end
+end
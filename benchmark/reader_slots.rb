@@ -0,0 +1,43 @@
+# Read transaction begin rate with many processes.
+#
+# Forks the given numbers of processes, each opening the environment
+# and running short read-only transactions (one get each) until the
+# time is up. Every transaction claims a reader slot and releases it
+# again, since the binding opens environments with :notls.
+#
+#   ruby -Ilib benchmark/reader_slots.rb [processes,...] [seconds]
+
+require 'lmdb'
+require 'tmpdir'
+
+procs   = (ARGV[0] || '1,16,64,128').split(',').map(&:to_i)
+seconds = (ARGV[1] || 3).to_f
+
+Dir.mktmpdir do |dir|
+  LMDB.new(dir, :maxreaders => procs.max + 2) { |env| env.database['key'] = 'value' }
+
+  procs.each do |n|
+    stop = Time.now + seconds
+    pipes = n.times.map do
+      r, w = IO.pipe
+      fork do
+        r.close
+        LMDB.new(dir, :maxreaders => procs.max + 2) do |env|
+          db = env.database
+          count = 0
+          while Time.now < stop
+            100.times { db['key'] }
+            count += 100
+          end
+          w.puts count
+        end
+        exit!
+      end
+      w.close
+      r
+    end
+    total = pipes.map { |r| r.read.to_i }.inject(0, :+)
+    Process.waitall
+    printf("%4d processes: %10.0f read txns/s\n", n, total / seconds)
+  end
+end
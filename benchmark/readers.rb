@@ -0,0 +1,50 @@
+# Write with a large reader table.
+#
+# Opens as many read transactions as there are reader slots, one per
+# thread, and closes them again. Slots stay in the table's scan range
+# once used, as they would in a prefork server whose workers each hold
+# one. Then times write transactions that allocate many pages, while
+# one reader keeps an old snapshot open so freed pages can't all be
+# reused straight away.
+#
+#   ruby -Ilib benchmark/readers.rb [maxreaders,...] [txns] [puts per txn]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+readers = (ARGV[0] || '126,1024,4096').split(',').map(&:to_i)
+txns    = (ARGV[1] || 200).to_i
+batch   = (ARGV[2] || 5000).to_i
+
+readers.each do |maxreaders|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 34, :nosync => true, :maxreaders => maxreaders) do |env|
+      db = env.database
+      db['key'] = 'value'
+
+      ready, done = Queue.new, Queue.new
+      threads = (maxreaders - 1).times.map do
+        Thread.new { env.transaction(true) { ready << true; done.pop } }
+      end
+      threads.each { ready.pop }
+      threads.each { done << true }
+      threads.each(&:join)
+
+      snapshot = Queue.new
+      old = Thread.new { env.transaction(true) { ready << true; snapshot.pop } }
+      ready.pop
+
+      value = 'v' * 200
+      time = Benchmark.realtime do
+        txns.times do |t|
+          env.transaction { batch.times { |i| db.put('%06d%06d' % [i, t], value) } }
+        end
+      end
+      snapshot << true
+      old.join
+      printf("maxreaders %5d: %d txns of %d puts in %.3fs (%.2f us per put), last page %d\n",
+             maxreaders, txns, batch, time, time * 1e6 / (txns * batch), env.info[:last_pgno])
+    end
+  end
+end
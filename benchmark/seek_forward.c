@@ -0,0 +1,113 @@
+/* Forward seeks through a database as in a merge join: MDB_SET_RANGE,
+ * which descends from the root whenever the key is off the current
+ * leaf, against MDB_SEEK_FORWARD, which climbs the cursor stack only as
+ * far as needed. Pages fetched counts the pages each seek reads from
+ * the tree besides those already on the cursor stack.
+ *
+ *   cc -O2 -Iext/lmdb_ext/liblmdb -o seek_forward \
+ *      benchmark/seek_forward.c ext/lmdb_ext/liblmdb/midl.c -lpthread
+ *   ./seek_forward [keys]
+ */
+#include "mdb.c"
+#include <time.h>
+
+#define SEEKS	(1 << 20)
+
+/** The pages a seek will fetch, mirroring mdb_cursor_set() and mdb_cursor_climb() */
+static unsigned int
+pages_fetched(MDB_cursor *mc, MDB_val *key, MDB_cursor_op op)
+{
+	MDB_page *mp = mc->mc_pg[mc->mc_top];
+	unsigned int top, nkeys = NUMKEYS(mp);
+
+	if (!mc->mc_top || (mdb_node_cmp(mc, mp, NODEPTR(mp, 0), key) >= 0 &&
+		mdb_node_cmp(mc, mp, NODEPTR(mp, nkeys-1), key) <= 0))
+		return 0;
+	if (op == MDB_SET_RANGE)
+		return mc->mc_db->md_depth;
+	for (top = mc->mc_top - 1; top > 0; top--) {
+		mp = mc->mc_pg[top];
+		nkeys = NUMKEYS(mp);
+		if (nkeys > 2 && mdb_node_cmp(mc, mp, NODEPTR(mp, 1), key) >= 0 &&
+			mdb_node_cmp(mc, mp, NODEPTR(mp, nkeys-1), key) < 0)
+			break;
+	}
+	return mc->mc_top - top;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int keys = argc > 1 ? atoi(argv[1]) : 2000000, i, x, stride;
+	unsigned long long fetched;
+	char dir[] = "/tmp/seek_forwardXXXXXX", path[64], buf[32];
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_cursor *mc;
+	MDB_val key, data;
+	MDB_cursor_op op;
+	double t;
+
+	if (!mkdtemp(dir) || mdb_env_create(&env) || mdb_env_set_mapsize(env, 1UL << 32) ||
+		mdb_env_open(env, dir, MDB_NOSYNC, 0644)) {
+		fprintf(stderr, "cannot open %s\n", dir);
+		return 1;
+	}
+	mdb_txn_begin(env, NULL, 0, &txn);
+	mdb_dbi_open(txn, NULL, 0, &dbi);
+	mdb_cursor_open(txn, dbi, &mc);
+	data.mv_size = 8;
+	data.mv_data = "payload";
+	for (i = 0; i < keys; i++) {
+		key.mv_size = sprintf(buf, "%016u", i * 3);
+		key.mv_data = buf;
+		mdb_cursor_put(mc, &key, &data, MDB_APPEND);
+	}
+	mdb_cursor_close(mc);
+	mdb_txn_commit(txn);
+
+	mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+	mdb_cursor_open(txn, dbi, &mc);
+	printf("%u keys, depth %u\n", keys, mc->mc_db->md_depth);
+	for (stride = 4; stride <= 40000; stride *= 10) {
+		printf("stride %5u", stride);
+		for (op = MDB_SET_RANGE; op <= MDB_SEEK_FORWARD; op++) {
+			srandom(stride);
+			mdb_cursor_get(mc, &key, &data, MDB_FIRST);
+			fetched = 0;
+			t = now();
+			for (i = 0, x = 0; i < SEEKS; i++) {
+				x += random() % stride * 3 + 1;
+				if (x >= keys * 3) {
+					x = 0;
+					mdb_cursor_get(mc, &key, &data, MDB_FIRST);
+				}
+				key.mv_size = sprintf(buf, "%016u", x);
+				key.mv_data = buf;
+				fetched += pages_fetched(mc, &key, op);
+				mdb_cursor_get(mc, &key, &data, op);
+			}
+			t = now() - t;
+			printf("  %s %6.1f ns %5.2f pages", op == MDB_SET_RANGE ? "set_range" : "seek_forward",
+				t * 1e9 / SEEKS, (double)fetched / SEEKS);
+		}
+		printf("\n");
+	}
+	mdb_cursor_close(mc);
+	mdb_txn_abort(txn);
+	mdb_env_close(env);
+	sprintf(path, "%s/data.mdb", dir);
+	unlink(path);
+	sprintf(path, "%s/lock.mdb", dir);
+	unlink(path);
+	rmdir(dir);
+	return 0;
+}
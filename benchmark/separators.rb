@@ -0,0 +1,42 @@
+# Branch pages and tree depth for long keys.
+#
+# The keys are a random 16 digit id followed by a long path, so two
+# neighbouring keys differ early on. Branch pages only need enough of
+# a key to tell its neighbours apart, which gives them more fanout
+# than copying whole keys up from the leaves.
+#
+#   ruby -Ilib benchmark/separators.rb [keys]
+
+require 'lmdb'
+require 'tmpdir'
+
+keys = (ARGV[0] || 200_000).to_i
+rng = Random.new(42)
+names = Array.new(keys) do
+  '%016x/' % rng.rand(1 << 64) + 'objects/archive/2014/' * 10
+end
+
+[[:put, names], [:bulk_load, names.sort]].each do |how, order|
+  Dir.mktmpdir do |dir|
+    LMDB.new(dir, :mapsize => 1 << 32, :nosync => true) do |env|
+      db = env.database
+
+      if how == :put
+        order.each_slice(1000) do |slice|
+          env.transaction { slice.each { |k| db.put(k, 'value') } }
+        end
+      else
+        env.transaction { db.bulk_load(order.map { |k| [k, 'value'] }) }
+      end
+
+      t = Time.now
+      env.transaction(true) { names.each { |k| db.get(k) } }
+      read = Time.now - t
+
+      stat = db.stat
+      printf("%-9s depth %d  branches %5d  leaves %6d  %6.2f us/get\n",
+             how, stat[:depth], stat[:branch_pages], stat[:leaf_pages],
+             read * 1e6 / keys)
+    end
+  end
+end
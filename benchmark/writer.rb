@@ -0,0 +1,61 @@
+# Many threads writing single records, directly or through a Writer.
+#
+# Directly, every put is its own write transaction, and the threads
+# take turns on the environment's write lock. Through a Writer, the
+# threads only queue their puts and wait for the futures, and the
+# writer thread commits them in batches. Prints throughput, commits,
+# and the context switches of the process where /proc reports them.
+#
+#   ruby -Ilib benchmark/writer.rb [threads,...] [puts per thread] [max_batch] [max_delay]
+
+require 'lmdb'
+require 'benchmark'
+require 'tmpdir'
+
+counts    = (ARGV[0] || '1,4,16,64').split(',').map(&:to_i)
+puts      = (ARGV[1] || 500).to_i
+max_batch = (ARGV[2] || 1000).to_i
+max_delay = (ARGV[3] || 0).to_f
+
+# Summed over all threads, so workers are sampled before they exit
+def switches
+  Dir['/proc/self/task/*/status'].map do |file|
+    (File.read(file) rescue '').scan(/^(?:non)?voluntary_ctxt_switches:\s+(\d+)/).flatten.map(&:to_i).inject(0, :+)
+  end.inject(0, :+)
+end
+
+counts.each do |threads|
+  [:direct, :writer].each do |mode|
+    Dir.mktmpdir do |dir|
+      LMDB.new(dir, :mapsize => 1 << 30) do |env|
+        db = env.database
+        writer = env.writer(:max_batch => max_batch, :max_delay => max_delay) if mode == :writer
+        lock = Mutex.new
+        finished, exit = Queue.new, Queue.new
+        txnid, ctx = env.info[:last_txnid], switches
+        workers = nil
+        time = Benchmark.realtime do
+          workers = threads.times.map do |t|
+            Thread.new do
+              if writer
+                puts.times.map { |i| writer.put(db, '%04d%06d' % [t, i], 'v' * 100) }.each(&:value)
+              else
+                puts.times { |i| lock.synchronize { db.put('%04d%06d' % [t, i], 'v' * 100) } }
+              end
+              finished << true
+              exit.pop
+            end
+          end
+          threads.times { finished.pop }
+        end
+        ctx = switches - ctx
+        threads.times { exit << true }
+        workers.each(&:join)
+        writer.close if writer
+        total = threads * puts
+        printf("%-6s %3d threads: %8.0f puts/s, %6d commits, %7d context switches\n",
+               mode, threads, total / time, env.info[:last_txnid] - txnid, ctx)
+      end
+    end
+  end
+end
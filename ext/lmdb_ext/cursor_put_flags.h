@@ -1,2 +1,3 @@
 #include "put_flags.h"
 FLAG(MULTIPLE, multiple)
+FLAG(NEARBY, nearby)
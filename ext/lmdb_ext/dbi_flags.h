@@ -4,4 +4,5 @@ FLAG(INTEGERKEY, integerkey)
 FLAG(DUPFIXED, dupfixed)
 FLAG(INTEGERDUP, integerdup)
 FLAG(REVERSEDUP, reversedup)
+FLAG(PREFIXKEY, prefixkey)
 FLAG(CREATE, create)
@@ -6,3 +6,5 @@ FLAG(NOMETASYNC, nometasync)
 FLAG(WRITEMAP, writemap)
 FLAG(MAPASYNC, mapasync)
 FLAG(NOTLS, notls)
+FLAG(PIPELINE, pipeline)
+FLAG(IO_URING, io_uring)
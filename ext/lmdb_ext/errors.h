@@ -13,3 +13,8 @@ ERROR(TLS_FULL)
 ERROR(TXN_FULL)
 ERROR(CURSOR_FULL)
 ERROR(PAGE_FULL)
+ERROR(MAP_RESIZED)
+ERROR(INCOMPATIBLE)
+ERROR(BAD_RSLOT)
+ERROR(BAD_TXN)
+ERROR(BAD_VALSIZE)
@@ -2,14 +2,33 @@ require 'mkmf'
 
 $CFLAGS = '-std=c99 -Wall -g'
 
-# Embed lmdb if we cannot find it
-if enable_config("bundled-lmdb", false) || !(find_header('lmdb.h') && have_library('lmdb', 'mdb_env_create'))
+# Embed lmdb if we cannot find it, or if it lacks the bulk loader
+if enable_config("bundled-lmdb", false) || !(find_header('lmdb.h') && have_library('lmdb', 'mdb_env_create') &&
+                                             have_func('mdb_loader_open', 'lmdb.h'))
   $INCFLAGS << " -I$(srcdir)/liblmdb"
   $VPATH ||= []
   $VPATH << "$(srcdir)/liblmdb"
   $srcs = Dir.glob("#{$srcdir}/{,liblmdb/}*.c").map {|n| File.basename(n) }
 end
 
+# Write pages through io_uring with :io_uring where the kernel headers have it
+if enable_config("io-uring", true) && have_header('linux/io_uring.h') &&
+    have_macro('__NR_io_uring_setup', 'sys/syscall.h')
+  $defs << '-DMDB_USE_IO_URING'
+end
+
+# Search integer DUPFIXED pages with SSE/AVX2 where the compiler can target them
+if enable_config("simd", true) && have_header('immintrin.h') &&
+    checking_for('AVX2 target attribute') {
+      try_compile(<<-SRC)
+#include <immintrin.h>
+__attribute__((target("avx2"))) static int f(void) { return _mm256_movemask_epi8(_mm256_setzero_si256()); }
+int main(void) { return __builtin_cpu_supports("avx2") ? f() : 0; }
+SRC
+    }
+  $defs << '-DMDB_USE_SIMD'
+end
+
 have_header 'limits.h'
 have_header 'string.h'
 have_header 'stdlib.h'
@@ -19,5 +38,8 @@ have_header 'assert.h'
 
 have_header 'ruby.h'
 have_func 'rb_funcall_passing_block'
+have_func 'rb_funcall_passing_block_kw'
+have_header 'ruby/thread.h'
+have_func 'rb_thread_call_without_gvl', 'ruby/thread.h'
 
 create_makefile('lmdb_ext')
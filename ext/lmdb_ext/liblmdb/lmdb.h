@@ -227,6 +227,9 @@ typedef unsigned int	MDB_dbi;
 /** @brief Opaque structure for navigating through a database */
 typedef struct MDB_cursor MDB_cursor;
 
+/** @brief Opaque structure for bulk loading a database */
+typedef struct MDB_loader MDB_loader;
+
 /** @brief Generic structure used for passing keys and data in and out
  * of the database.
  *
@@ -271,6 +274,8 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_FIXEDMAP	0x01
 	/** no environment directory */
 #define MDB_NOSUBDIR	0x4000
+	/** write pages and sync through io_uring, see #mdb_env_open() */
+#define MDB_IO_URING	0x8000
 	/** don't fsync after commit */
 #define MDB_NOSYNC		0x10000
 	/** read only */
@@ -289,6 +294,8 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_NORDAHEAD	0x800000
 	/** don't initialize malloc'd memory before writing to datafile */
 #define MDB_NOMEMINIT	0x1000000
+	/** release the write lock before syncing, see #mdb_txn_commit_async() */
+#define MDB_PIPELINE	0x2000000
 /** @} */
 
 /**	@defgroup	mdb_dbi_open	Database Flags
@@ -309,6 +316,8 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_INTEGERDUP	0x20
 	/** with #MDB_DUPSORT, use reverse string dups */
 #define MDB_REVERSEDUP	0x40
+	/** store the key prefix shared by a leaf page only once */
+#define MDB_PREFIXKEY	0x80
 	/** create DB if not already existing */
 #define MDB_CREATE		0x40000
 /** @} */
@@ -335,6 +344,10 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_APPENDDUP	0x40000
 /** Store multiple data items in one call. Only for #MDB_DUPFIXED. */
 #define MDB_MULTIPLE	0x80000
+/** For mdb_cursor_put: the key is at or shortly after the cursor's current
+ * position, so search for it from there as #MDB_SEEK_FORWARD does.
+ */
+#define MDB_NEARBY	0x100000
 /*	@} */
 
 /** @brief Cursor Get operations.
@@ -366,7 +379,10 @@ typedef enum MDB_cursor_op {
 	MDB_PREV_NODUP,			/**< Position at last data item of previous key */
 	MDB_SET,				/**< Position at specified key */
 	MDB_SET_KEY,			/**< Position at specified key, return key + data */
-	MDB_SET_RANGE			/**< Position at first key greater than or equal to specified key. */
+	MDB_SET_RANGE,			/**< Position at first key greater than or equal to specified key. */
+	MDB_SEEK_FORWARD		/**< Like #MDB_SET_RANGE, but starting from the current position:
+								only the pages between it and the key are searched. For
+								keys at or shortly after the current one. */
 } MDB_cursor_op;
 
 /** @defgroup  errors	Return Codes
@@ -438,6 +454,25 @@ typedef struct MDB_envinfo {
 	unsigned int me_numreaders;		/**< max reader slots used in the environment */
 } MDB_envinfo;
 
+/** @defgroup	mdb_arena	Dirty page arena flags
+ *	@{
+ */
+	/** back the arena with huge pages from the hugetlb pool, if there are enough */
+#define MDB_ARENA_HUGETLB	0x01
+	/** advise the kernel to back the arena with transparent huge pages */
+#define MDB_ARENA_THP		0x02
+/** @} */
+
+/** @brief Statistics for the dirty page arena of an environment */
+typedef struct MDB_arenainfo {
+	size_t	ma_size;		/**< bytes reserved for the arena, 0 if there is none */
+	size_t	ma_resident;	/**< bytes of the arena backed by memory */
+	size_t	ma_pages;		/**< pages handed out by the arena */
+	size_t	ma_reused;		/**< of those, pages whose memory was in use before */
+	size_t	ma_fallbacks;	/**< pages that did not fit and were malloc'd */
+	unsigned int ma_flags;	/**< #MDB_ARENA_HUGETLB if backed by the hugetlb pool */
+} MDB_arenainfo;
+
 	/** @brief Return the mdb library version information.
 	 *
 	 * @param[out] major if non-NULL, the library major version number is copied here
@@ -508,6 +543,10 @@ int  mdb_env_create(MDB_env **env);
 	 *		Incompatible with nested transactions.
 	 *		Processes with and without MDB_WRITEMAP on the same environment do
 	 *		not cooperate well.
+	 *		A commit syncs only the ranges of the map it dirtied, unless
+	 *		earlier writes have not been synced yet, the transaction spilled
+	 *		pages, or the commit before it was made by another process,
+	 *		whose writes this one can't see.
 	 *	<li>#MDB_NOMETASYNC
 	 *		Flush system buffers to disk only once per transaction, omit the
 	 *		metadata flush. Defer that until the system flushes files to disk,
@@ -577,6 +616,26 @@ int  mdb_env_create(MDB_env **env);
 	 *		caller is expected to overwrite all of the memory that was
 	 *		reserved in that case.
 	 *		This flag may be changed at any time using #mdb_env_set_flags().
+	 *	<li>#MDB_PIPELINE
+	 *		Pipeline commits. #mdb_txn_commit_async() releases the write
+	 *		lock as soon as the transaction's pages are written, so the next
+	 *		write transaction can run while #mdb_env_sync_txn() syncs the data
+	 *		and writes the meta page. Write transactions start from the newest
+	 *		commit; read transactions only see durable ones. The pages of the
+	 *		newest durable commit are not reused until a later one is durable.
+	 *		#mdb_txn_commit() still returns only once the transaction is durable.
+	 *		Writers in other processes block until this process's pending
+	 *		commits are durable, or until it exits, so every commit should
+	 *		eventually be passed to #mdb_env_sync_txn(). After a failed sync
+	 *		later commits fail too. Cannot be combined with #MDB_WRITEMAP,
+	 *		and is not implemented on Windows.
+	 *	<li>#MDB_IO_URING
+	 *		Write a commit's pages through an io_uring, and submit them in
+	 *		one call with the fdatasync that follows. Only implemented on
+	 *		Linux when built with MDB_USE_IO_URING, and ignored with
+	 *		#MDB_RDONLY or #MDB_WRITEMAP. If the ring can't be set up the
+	 *		flag is cleared and pages are written with writev() as usual,
+	 *		so #mdb_env_get_flags() tells which one is in use.
 	 * </ul>
 	 * @param[in] mode The UNIX permissions to set on created files. This parameter
 	 * is ignored on Windows.
@@ -750,6 +809,24 @@ int  mdb_env_get_fd(MDB_env *env, mdb_filehandle_t *fd);
 	 */
 int  mdb_env_set_mapsize(MDB_env *env, size_t size);
 
+	/** @brief Set the page size of a new environment.
+	 *
+	 * The page size is fixed when the environment is created; by default it
+	 * is the OS page size. Larger pages keep bigger items in the B-tree
+	 * instead of on overflow pages, and make trees shallower, at the cost
+	 * of writing more per dirtied page. The size is ignored when opening
+	 * an existing environment, which keeps its own.
+	 * This function may only be called after #mdb_env_create() and before #mdb_env_open().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] size The page size in bytes, a power of two from 4096 to 32768.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the environment is already open.
+	 * </ul>
+	 */
+int  mdb_env_set_pagesize(MDB_env *env, unsigned int size);
+
 	/** @brief Set the maximum number of threads/reader slots for the environment.
 	 *
 	 * This defines the number of slots in the lock table that is used to track readers in the
@@ -781,6 +858,115 @@ int  mdb_env_set_maxreaders(MDB_env *env, unsigned int readers);
 	 */
 int  mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers);
 
+	/** @brief Set the maximum number of dirty pages in a write transaction.
+	 *
+	 * A write transaction keeps the pages it modifies in memory until it
+	 * commits. When it has this many dirty pages, some of them are written
+	 * out early ("spilled") to make room, and read back if they are needed
+	 * again. The default is 131071 pages. Larger values let big transactions
+	 * run without spilling, at the cost of more memory.
+	 * This function may only be called after #mdb_env_create() and before #mdb_env_open().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] pages The maximum number of dirty pages, at least 64
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the environment is already open.
+	 * </ul>
+	 */
+int  mdb_env_set_maxdirty(MDB_env *env, unsigned int pages);
+
+	/** @brief Get the maximum number of dirty pages in a write transaction.
+	 *
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] pages Address of an integer to store the number of pages
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_get_maxdirty(MDB_env *env, unsigned int *pages);
+
+	/** @brief Set up an arena for the dirty pages of write transactions.
+	 *
+	 * Write transactions normally malloc every page they modify and free
+	 * them when they end. With an arena, pages are instead taken in order
+	 * from one anonymous memory mapping of the given size, reserved by
+	 * #mdb_env_open(), and the whole arena is released at once when a
+	 * transaction commits or aborts. Up to \b retain bytes of the memory
+	 * a transaction used stay mapped for the next one; the rest is given
+	 * back to the system. Pages that don't fit in the arena are malloc'd.
+	 * The arena is not used with #MDB_WRITEMAP, nor on Windows.
+	 * This function may only be called after #mdb_env_create() and before #mdb_env_open().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] size The number of bytes to reserve, or 0 for no arena
+	 * @param[in] retain The number of bytes to keep between transactions
+	 * @param[in] flags Special options for the arena. This parameter
+	 * must be set to 0 or by bitwise OR'ing together one or more of the
+	 * values described here.
+	 * <ul>
+	 *	<li>#MDB_ARENA_HUGETLB
+	 *		Back the arena with huge pages from the hugetlb pool. If the
+	 *		pool can't hold the whole arena, normal pages are used.
+	 *	<li>#MDB_ARENA_THP
+	 *		Ask the kernel to back the arena with transparent huge pages.
+	 * </ul>
+	 * With either flag, \b size and \b retain are rounded up to 2MB.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the environment is already open.
+	 * </ul>
+	 */
+int  mdb_env_set_arena(MDB_env *env, size_t size, size_t retain, unsigned int flags);
+
+	/** @brief Return statistics about the dirty page arena.
+	 *
+	 * The counters cover all write transactions since the environment
+	 * was created, and are only read safely while no write transaction
+	 * is running in this process.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] info The address of an #MDB_arenainfo structure
+	 * 	where the statistics will be copied
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_env_arena_info(MDB_env *env, MDB_arenainfo *info);
+
+	/** @brief Get the amount of committed data not yet synced to disk.
+	 *
+	 * Counts the bytes of pages written by transactions since the start
+	 * of the last completed sync, whether it was done by #mdb_env_sync()
+	 * or by a commit. With #MDB_NOSYNC or #MDB_MAPASYNC this is roughly
+	 * how much a system crash would lose. The value is only updated by
+	 * this process, and may be read while another thread commits.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] bytes Address where the number of bytes will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_get_unsynced(MDB_env *env, size_t *bytes);
+
+	/** @brief Get the number of I/O operations done through io_uring.
+	 *
+	 * Counts the page writes and syncs of this process's commits that
+	 * completed on the io_uring of an #MDB_IO_URING environment. It stays
+	 * 0 when the library was built without io_uring, or when the flag was
+	 * dropped because the kernel does not support it. It may be read while
+	 * another thread commits.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] ops Address where the number of operations will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_get_uring_ops(MDB_env *env, size_t *ops);
+
 	/** @brief Set the maximum number of named databases for the environment.
 	 *
 	 * This function is only needed if multiple databases will be used in the
@@ -799,7 +985,11 @@ int  mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs);
 
 	/** @brief Get the maximum size of a key for the environment.
 	 *
-	 * This is the compile-time constant #MDB_MAXKEYSIZE, default 511.
+	 * This is derived from the page size when the environment is opened,
+	 * and is 0 before that: about a quarter of the page size, minus
+	 * per-node overhead, e.g. 1009 bytes for 4KB pages. Building with a
+	 * non-zero MDB_MAXKEYSIZE caps it. Databases holding keys longer than
+	 * 511 bytes can't be fully used by older versions of the library.
 	 * See @ref MDB_val.
 	 * @param[in] env An environment handle returned by #mdb_env_create()
 	 * @return The maximum size of a key
@@ -866,6 +1056,39 @@ MDB_env *mdb_txn_env(MDB_txn *txn);
 	 */
 int  mdb_txn_commit(MDB_txn *txn);
 
+	/** @brief Commit a transaction without waiting for it to be durable.
+	 *
+	 * In an environment opened with #MDB_PIPELINE the transaction's pages
+	 * are written and the write lock is released, but the data is not
+	 * synced and the meta page not written yet; pass the returned id to
+	 * #mdb_env_sync_txn() for that. Otherwise this is #mdb_txn_commit().
+	 * The transaction handle is freed as by #mdb_txn_commit().
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[out] txnid Address where the id of the commit will be stored.
+	 * A transaction that made no changes returns the id of the commit it
+	 * started from.
+	 * @return A non-zero error value on failure and 0 on success. Errors are
+	 * as for #mdb_txn_commit().
+	 */
+int  mdb_txn_commit_async(MDB_txn *txn, size_t *txnid);
+
+	/** @brief Wait until a commit is durable.
+	 *
+	 * Syncs the data file and writes the meta page for the newest pending
+	 * commit, unless another thread is already doing it. Commits become
+	 * durable in the order they were made, so this also covers every
+	 * earlier commit. Returns at once without #MDB_PIPELINE.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] txnid A commit id returned by #mdb_txn_commit_async()
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 *	<li>EIO - a low-level I/O error occurred while writing.
+	 * </ul>
+	 */
+int  mdb_env_sync_txn(MDB_env *env, size_t txnid);
+
 	/** @brief Abandon all the operations of the transaction instead of saving them.
 	 *
 	 * The transaction handle is freed. It and its cursors must not be used
@@ -966,6 +1189,16 @@ int  mdb_txn_renew(MDB_txn *txn);
 	 *	<li>#MDB_REVERSEDUP
 	 *		This option specifies that duplicate data items should be compared as
 	 *		strings in reverse order.
+	 *	<li>#MDB_PREFIXKEY
+	 *		Keys are stored prefix-compressed: the bytes shared by all keys on a
+	 *		leaf page are kept once per page. This fits more keys with long common
+	 *		prefixes onto each page. It may not be combined with #MDB_REVERSEKEY,
+	 *		#MDB_INTEGERKEY, #MDB_DUPSORT or a custom comparison function. Keys
+	 *		returned by a cursor on such a database are only valid until the next
+	 *		operation on that cursor. Creating such a database raises the data
+	 *		format version of the environment for good, so versions of the library
+	 *		without support for this flag refuse to open it with
+	 *		#MDB_VERSION_MISMATCH.
 	 *	<li>#MDB_CREATE
 	 *		Create the named database if it doesn't exist. This option is not
 	 *		allowed in a read-only transaction or a read-only environment.
@@ -977,6 +1210,7 @@ int  mdb_txn_renew(MDB_txn *txn);
 	 *	<li>#MDB_NOTFOUND - the specified database doesn't exist in the environment
 	 *		and #MDB_CREATE was not specified.
 	 *	<li>#MDB_DBS_FULL - too many databases have been opened. See #mdb_env_set_maxdbs().
+	 *	<li>#MDB_INCOMPATIBLE - the database uses flags this library doesn't know.
 	 * </ul>
 	 */
 int  mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *dbi);
@@ -995,6 +1229,51 @@ int  mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *d
 	 */
 int  mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 
+	/** @brief Count the pages of a database by how full they are.
+	 *
+	 * The tree is walked from the root and every branch and leaf page is
+	 * counted in one of \b buckets equal ranges of fill, the first for
+	 * pages below 100/buckets percent full. Overflow pages and the trees
+	 * of sorted duplicates are not included.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] buckets The number of fill ranges, from 1 to 1000.
+	 * @param[out] leaf An array of \b buckets counters for leaf pages.
+	 * @param[out] branch An array of \b buckets counters for branch pages.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_page_fill(MDB_txn *txn, MDB_dbi dbi, unsigned int buckets, size_t *leaf, size_t *branch);
+
+	/** @brief Estimate the size of a range of keys in a database.
+	 *
+	 * The range runs from the first key not less than \b from up to, but
+	 * not including, the first key not less than \b to. Both ends are
+	 * looked up once, and the share of the tree between them is worked
+	 * out from the positions on their paths, taking the children of every
+	 * branch page to be the same size. The database's totals are scaled
+	 * by that share, so the cost is two searches however large the range.
+	 * When both ends fall on one leaf page of a database without sorted
+	 * duplicates the entry count is exact.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] from The key to start at, or NULL to start at the first key.
+	 * @param[in] to The key to stop at, or NULL to run to the last key.
+	 * @param[out] stat The address of an #MDB_stat structure where the
+	 *	estimated entries and pages of the range will be stored. The page
+	 *	size and depth are those of the whole database.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 *	<li>MDB_BAD_VALSIZE - a key is longer than the maximum key size.
+	 * </ul>
+	 */
+int  mdb_estimate_range(MDB_txn *txn, MDB_dbi dbi, MDB_val *from, MDB_val *to, MDB_stat *stat);
+
 	/** @brief Retrieve the DB flags for a database handle.
 	 *
 	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
@@ -1025,6 +1304,66 @@ void mdb_dbi_close(MDB_env *env, MDB_dbi dbi);
 	 */
 int  mdb_drop(MDB_txn *txn, MDB_dbi dbi, int del);
 
+	/** @brief Start a bulk load of an empty database.
+	 *
+	 * A bulk load builds the B-tree bottom-up from data items supplied
+	 * in ascending key order. Every page is filled up to \b fill and
+	 * written only once, without any page splits. Completed pages may
+	 * be spilled to disk while the load proceeds. The new tree replaces
+	 * the database's root when the load is closed with \b commit set.
+	 *
+	 * The database must not be used through any other handle until
+	 * #mdb_loader_close() has been called.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] fill Page fill target in tenths of a percent, 1 to 1000.
+	 * @param[out] loader Address where the new #MDB_loader handle will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_INCOMPATIBLE - the database was opened with #MDB_DUPSORT.
+	 *	<li>EACCES - an attempt was made to modify a read-only database.
+	 *	<li>EINVAL - the database is not empty, or an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_loader_open(MDB_txn *txn, MDB_dbi dbi, unsigned int fill, MDB_loader **loader);
+
+	/** @brief Limit the memory used by a bulk load.
+	 *
+	 * By default a bulk load keeps completed pages in memory until the
+	 * transaction runs short of dirty pages. With a limit set, completed
+	 * pages are written out as soon as that many pages are dirty.
+	 * @param[in] loader A loader handle returned by #mdb_loader_open()
+	 * @param[in] pages The number of dirty pages to allow, or 0 for the default.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_loader_set_dirty(MDB_loader *loader, unsigned int pages);
+
+	/** @brief Append a key/data pair to a bulk load.
+	 *
+	 * @param[in] loader A loader handle returned by #mdb_loader_open()
+	 * @param[in] key The key to store. It must sort after all keys stored so far.
+	 * @param[in] data The data to store
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_KEYEXIST - the key is not greater than the previous key.
+	 *	<li>#MDB_MAP_FULL - the database is full, see #mdb_env_set_mapsize().
+	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages.
+	 * </ul>
+	 * Any error other than #MDB_KEYEXIST leaves the transaction unusable.
+	 */
+int  mdb_loader_put(MDB_loader *loader, MDB_val *key, MDB_val *data);
+
+	/** @brief Finish a bulk load and free the loader handle.
+	 *
+	 * @param[in] loader A loader handle returned by #mdb_loader_open()
+	 * @param[in] commit Non-zero to link the new tree into the database.
+	 * If zero and any data was loaded, the transaction must be aborted.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_loader_close(MDB_loader *loader, int commit);
+
 	/** @brief Set a custom key comparison function for a database.
 	 *
 	 * The comparison function is called whenever it is necessary to compare a
@@ -1042,6 +1381,7 @@ int  mdb_drop(MDB_txn *txn, MDB_dbi dbi, int del);
 	 * errors are:
 	 * <ul>
 	 *	<li>EINVAL - an invalid parameter was specified.
+	 *	<li>#MDB_INCOMPATIBLE - the database was opened with #MDB_PREFIXKEY.
 	 * </ul>
 	 */
 int  mdb_set_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp);
@@ -1105,6 +1445,31 @@ int  mdb_set_relfunc(MDB_txn *txn, MDB_dbi dbi, MDB_rel_func *rel);
 	 */
 int  mdb_set_relctx(MDB_txn *txn, MDB_dbi dbi, void *ctx);
 
+	/** @brief Set how full a database's pages are kept.
+	 *
+	 * By default a leaf page is split in the middle, unless the new key
+	 * goes at its end, and a page is merged with a neighbor when it falls
+	 * below 25% full. A database filled in mostly ascending order packs
+	 * better with a higher split fill. One with a lot of churn avoids
+	 * splitting and merging the same pages back and forth with a lower
+	 * merge threshold. Like the comparison functions these settings are
+	 * not stored in the database, and last until the handle is closed.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] split How full to leave the left page when a leaf page
+	 * splits, in tenths of a percent, or 0 for the default.
+	 * @param[in] merge The fill in tenths of a percent below which a page
+	 * is merged, or 0 for the default. At most 500, and no more than what
+	 * either half of a split is left with, so a fresh split is never due
+	 * for a merge.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_set_fill(MDB_txn *txn, MDB_dbi dbi, unsigned int split, unsigned int merge);
+
 	/** @brief Get items from a database.
 	 *
 	 * This function retrieves key/data pairs from the database. The address
@@ -1207,6 +1572,30 @@ int  mdb_put(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data,
 	 */
 int  mdb_del(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
 
+	/** @brief Delete a range of keys from a database.
+	 *
+	 * This function removes every key from \b from up to but not including
+	 * \b to, with all of their data items. Subtrees that lie entirely
+	 * inside the range are freed without being read into the transaction's
+	 * dirty pages, so only the pages along the two ends of the range are
+	 * modified. Any cursors on the database must be positioned again
+	 * afterwards.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] from The first key to delete, or NULL to start at the
+	 * first key of the database.
+	 * @param[in] to The key to stop at, or NULL to delete to the end of
+	 * the database.
+	 * @param[out] count If non-NULL, set to the number of data items deleted.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_del_range(MDB_txn *txn, MDB_dbi dbi, MDB_val *from, MDB_val *to, size_t *count);
+
 	/** @brief Create a cursor handle.
 	 *
 	 * A cursor is associated with a specific transaction and database.
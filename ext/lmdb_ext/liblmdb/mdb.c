@@ -96,6 +96,21 @@
 #endif
 #endif
 
+#ifdef MDB_USE_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+	/* The SIMD count functions need GCC's x86-64 target attributes
+	 * and CPU checks, and pthread_once(), which Windows lacks.
+	 */
+#if defined(MDB_USE_SIMD) && (!(defined(__GNUC__) && defined(__x86_64__)) || defined(_WIN32))
+#undef MDB_USE_SIMD
+#endif
+#ifdef MDB_USE_SIMD
+#include <immintrin.h>
+#endif
+
 #ifdef USE_VALGRIND
 #include <valgrind/memcheck.h>
 #define VGMEMP_CREATE(h,r,z)    VALGRIND_CREATE_MEMPOOL(h,r,z)
@@ -290,6 +305,27 @@ mdb_sem_wait(sem_t *sem)
 
 #ifndef MS_ASYNC
 #define	MS_ASYNC	0
+#endif
+
+/** Compare and swap a 32-bit word, true if it was swapped. This is
+ *	also a full memory barrier.
+ */
+#ifndef MDB_CAS32
+# ifdef _WIN32
+#  define MDB_CAS32(ptr,old,new)	\
+	(InterlockedCompareExchange((LONG volatile *)(ptr), (LONG)(new), (LONG)(old)) == (LONG)(old))
+# else
+#  define MDB_CAS32(ptr,old,new)	__sync_bool_compare_and_swap(ptr, old, new)
+# endif
+#endif
+
+/** A full memory barrier */
+#ifndef MDB_FENCE
+# ifdef _WIN32
+#  define MDB_FENCE()	MemoryBarrier()
+# else
+#  define MDB_FENCE()	__sync_synchronize()
+# endif
 #endif
 
 	/** A page number in the database.
@@ -357,6 +393,9 @@ static txnid_t mdb_debug_start;
 	 */
 #define MAX_PAGESIZE	 0x8000
 
+	/** The smallest page size #mdb_env_set_pagesize() accepts. */
+#define MIN_PAGESIZE	 0x1000
+
 	/** The minimum number of keys required in a database page.
 	 *	Setting this to a larger value will place a smaller bound on the
 	 *	maximum size of a data item. Data items larger than this size will
@@ -371,6 +410,13 @@ static txnid_t mdb_debug_start;
 	 */
 #define MDB_MINKEYS	 2
 
+	/**	The number of keys of #ENV_MAXKEY() size that must fit on a branch
+	 *	page. With four, an underfilled branch page with a single key can
+	 *	always take a key from its neighbor or be merged into it, and a
+	 *	split never leaves a branch page with just one key.
+	 */
+#define MDB_MINBRANCHKEYS	 4
+
 	/**	A stamp that identifies a file as an MDB file.
 	 *	There's nothing special about this value other than that it is easily
 	 *	recognizable, and it will reflect any byte order mismatches.
@@ -379,25 +425,38 @@ static txnid_t mdb_debug_start;
 
 	/**	The version number for a database's datafile format. */
 #define MDB_DATA_VERSION	 1
+	/**	The datafile format version once the environment has held an
+	 *	#MDB_PREFIXKEY database. Builds that don't know #P_PREFIX pages
+	 *	refuse such a file with #MDB_VERSION_MISMATCH instead of
+	 *	misreading its keys. The version is never lowered again.
+	 */
+#define MDB_DATA_VERSION_PREFIX	 2
 	/**	The version number for a database's lockfile format. */
-#define MDB_LOCK_VERSION	 1
+#define MDB_LOCK_VERSION	 2
 
-	/**	@brief The maximum size of a key in the database.
-	 *
-	 *	The library rejects bigger keys, and cannot deal with records
-	 *	with bigger keys stored by a library with bigger max keysize.
+	/**	@brief A compile-time cap on the size of a key in the database.
 	 *
-	 *	We require that keys all fit onto a regular page. This limit
-	 *	could be raised a bit further if needed; to something just
-	 *	under (page size / #MDB_MINKEYS / 3).
+	 *	The maximum key size of an environment is derived from its page
+	 *	size, see #ENV_MAXKEY(). If this is non-zero, keys are also
+	 *	limited to this size. Older versions of the library had a fixed
+	 *	limit of 511, and reject operations on records with bigger keys.
 	 *
 	 *	Note that data items in an #MDB_DUPSORT database are actually keys
 	 *	of a subDB, so they're also limited to this size.
 	 */
 #ifndef MDB_MAXKEYSIZE
-#define MDB_MAXKEYSIZE	 511
+#define MDB_MAXKEYSIZE	 0
 #endif
 
+	/**	@brief The maximum size of a key in an environment.
+	 *
+	 *	We require that keys all fit onto a regular page, together with
+	 *	the #MDB_db record of a subDB, which cannot go on an overflow
+	 *	page, and that #MDB_MINBRANCHKEYS of them fit on a branch page.
+	 *	This is set when the environment is opened.
+	 */
+#define ENV_MAXKEY(env)	((env)->me_maxkey)
+
 	/**	@brief The maximum size of a data item.
 	 *
 	 *	We only store a 32 bit value for node sizes.
@@ -405,11 +464,13 @@ static txnid_t mdb_debug_start;
 #define MAXDATASIZE	0xffffffffUL
 
 #if MDB_DEBUG
+	/**	The longest key that is shown in full by #DKEY(). */
+#define DKBUF_MAXKEYSIZE	 511
 	/**	A key buffer.
 	 *	@ingroup debug
 	 *	This is used for printing a hex dump of a key's contents.
 	 */
-#define DKBUF	char kbuf[(MDB_MAXKEYSIZE*2+1)]
+#define DKBUF	char kbuf[(DKBUF_MAXKEYSIZE*2+1)]
 	/**	Display a key in hex.
 	 *	@ingroup debug
 	 *	Invoke a function to display a key in hex.
@@ -477,6 +538,10 @@ typedef uint16_t	 indx_t;
  *	the longer we delay reclaiming old pages, the more likely it is that a
  *	string of contiguous pages can be found after coalescing old pages from
  *	many old transactions together.
+ *
+ *	For the same reason the writer doesn't rescan the table on every page
+ *	allocation. The oldest reader only moves forward during a write txn,
+ *	so the result of a scan is kept for the txn, see #mdb_find_oldest().
  *	@{
  */
 	/**	Number of slots in the reader table.
@@ -486,6 +551,13 @@ typedef uint16_t	 indx_t;
 	 */
 #define DEFAULT_READERS	126
 
+	/**	Bounds for #mdb_env_set_maxdirty(). A txn must be able to keep
+	 *	the pages its cursors are on dirty, and the dirty list needs
+	 *	(pages+1) * sizeof(MDB_ID2) bytes of memory.
+	 */
+#define MDB_MINDIRTY	64
+#define MDB_MAXDIRTY	((1U << 30) - 1)
+
 	/**	The size of a CPU cache line in bytes. We want our lock structures
 	 *	aligned to this size to avoid false cache line sharing in the
 	 *	lock table.
@@ -566,7 +638,8 @@ typedef struct MDB_txbody {
 	txnid_t		mtb_txnid;
 		/** The number of slots that have been used in the reader table.
 		 *	This always records the maximum count, it is not decremented
-		 *	when readers release their slots.
+		 *	when readers release their slots. Slots are claimed and the
+		 *	count raised by compare-and-swap, see #mdb_reader_claim().
 		 */
 	unsigned	mtb_numreaders;
 } MDB_txbody;
@@ -584,14 +657,24 @@ typedef struct MDB_txninfo {
 		char pad[(sizeof(MDB_txbody)+CACHELINE-1) & ~(CACHELINE-1)];
 	} mt1;
 	union {
+		struct {
 #if defined(_WIN32) || defined(MDB_USE_POSIX_SEM)
-		char mt2_wmname[MNAME_LEN];
-#define	mti_wmname	mt2.mt2_wmname
+			char mt2_wmname[MNAME_LEN];
+#define	mti_wmname	mt2.mt2b.mt2_wmname
 #else
-		pthread_mutex_t	mt2_wmutex;
-#define mti_wmutex	mt2.mt2_wmutex
+			pthread_mutex_t	mt2_wmutex;
+#define mti_wmutex	mt2.mt2b.mt2_wmutex
 #endif
-		char pad[(MNAME_LEN+CACHELINE-1) & ~(CACHELINE-1)];
+			/** Newest commit written by an #MDB_PIPELINE writer
+			 *	that may not be durable yet, see #mdb_txn_commit_async().
+			 */
+			txnid_t		mt2_pending;
+#define mti_pending	mt2.mt2b.mt2_pending
+			/** The process that made #mti_pending */
+			MDB_PID_T	mt2_pending_pid;
+#define mti_pending_pid	mt2.mt2b.mt2_pending_pid
+		} mt2b;
+		char pad[(MNAME_LEN+2*sizeof(txnid_t)+CACHELINE-1) & ~(CACHELINE-1)];
 	} mt2;
 	MDB_reader	mti_readers[1];
 } MDB_txninfo;
@@ -615,7 +698,7 @@ typedef struct MDB_page {
 		pgno_t		p_pgno;	/**< page number */
 		void *		p_next;	/**< for in-memory list of freed structs */
 	} mp_p;
-	uint16_t	mp_pad;
+	uint16_t	mp_pad;		/**< key size of LEAF2 sub-pages, see also #PAGEPFXSZ() */
 /**	@defgroup mdb_page	Page Flags
  *	@ingroup internal
  *	Flags for the page headers.
@@ -628,6 +711,7 @@ typedef struct MDB_page {
 #define	P_DIRTY		 0x10		/**< dirty page, also set for #P_SUBP pages */
 #define	P_LEAF2		 0x20		/**< for #MDB_DUPFIXED records */
 #define	P_SUBP		 0x40		/**< for #MDB_DUPSORT sub-pages */
+#define	P_PREFIX	 0x80		/**< for #MDB_PREFIXKEY leaf pages */
 #define	P_KEEP		 0x8000		/**< leave this page alone during spill */
 /** @} */
 	uint16_t	mp_flags;		/**< @ref mdb_page */
@@ -663,6 +747,8 @@ typedef struct MDB_page {
 	 *	Pages emptier than this are candidates for merging.
 	 */
 #define FILL_THRESHOLD	 250
+	/** The fill factor below which a cursor's pages are merged. */
+#define MERGE_THRESHOLD(mc)	 ((mc)->mc_dbx->md_merge ? (mc)->mc_dbx->md_merge : FILL_THRESHOLD)
 
 	/** Test if a page is a leaf page */
 #define IS_LEAF(p)	 F_ISSET((p)->mp_flags, P_LEAF)
@@ -674,6 +760,16 @@ typedef struct MDB_page {
 #define IS_OVERFLOW(p)	 F_ISSET((p)->mp_flags, P_OVERFLOW)
 	/** Test if a page is a sub page */
 #define IS_SUBP(p)	 F_ISSET((p)->mp_flags, P_SUBP)
+	/** Test if a page is a prefix-compressed leaf page */
+#define IS_PREFIX(p)	 F_ISSET((p)->mp_flags, P_PREFIX)
+
+	/** The length of the key prefix shared by all nodes on a page.
+	 *	Only #P_PREFIX pages have one; the nodes store the rest of
+	 *	their keys and #mp_pad holds the prefix length.
+	 */
+#define PAGEPFXSZ(p)	 (IS_PREFIX(p) ? (p)->mp_pad : 0)
+	/** Address of the key prefix, which is kept at the end of the page */
+#define PAGEPFX(env, p)	 ((char *)(p) + (env)->me_psize - EVEN((p)->mp_pad))
 
 	/** The number of overflow pages needed to store the given size. */
 #define OVPAGES(size, psize)	((PAGEHDRSZ-1 + (size)) / (psize) + 1)
@@ -712,6 +808,9 @@ typedef struct MDB_node {
 	/** Size of the node header, excluding dynamic data at the end */
 #define NODESIZE	 offsetof(MDB_node, mn_data)
 
+	/** Round \b n up to an even number */
+#define EVEN(n)		 (((n) + 1U) & -2)
+
 	/** Bit position of top word in page number, for shifting mn_flags */
 #define PGNO_TOPWORD ((pgno_t)-1 > 0xffffffffu ? 32 : 0)
 
@@ -781,12 +880,11 @@ typedef struct MDB_node {
 	 */
 #define LEAF2KEY(p, i, ks)	((char *)(p) + PAGEHDRSZ + ((i)*(ks)))
 
-	/** Set the \b node's key into \b keyptr, if requested. */
-#define MDB_GET_KEY(node, keyptr)	{ if ((keyptr) != NULL) { \
-	(keyptr)->mv_size = NODEKSZ(node); (keyptr)->mv_data = NODEKEY(node); } }
-
-	/** Set the \b node's key into \b key. */
-#define MDB_GET_KEY2(node, key)	{ key.mv_size = NODEKSZ(node); key.mv_data = NODEKEY(node); }
+	/** Set the key of \b node on the cursor's page into \b keyptr, if requested.
+	 *	Keys on #P_PREFIX pages are rebuilt in the cursor's key buffer.
+	 */
+#define MDB_GET_KEY(mc, node, keyptr)	{ if ((keyptr) != NULL) \
+	mdb_node_key((mc)->mc_txn->mt_env, (mc)->mc_pg[(mc)->mc_top], node, keyptr, (mc)->mc_kbuf); }
 
 	/** Information about a single database in the environment. */
 typedef struct MDB_db {
@@ -804,7 +902,9 @@ typedef struct MDB_db {
 #define MDB_VALID	0x8000		/**< DB handle is valid, for me_dbflags */
 #define PERSISTENT_FLAGS	(0xffff & ~(MDB_VALID))
 #define VALID_FLAGS	(MDB_REVERSEKEY|MDB_DUPSORT|MDB_INTEGERKEY|MDB_DUPFIXED|\
-	MDB_INTEGERDUP|MDB_REVERSEDUP|MDB_CREATE)
+	MDB_INTEGERDUP|MDB_REVERSEDUP|MDB_PREFIXKEY|MDB_CREATE)
+	/** DB flags this version knows how to read */
+#define KNOWN_FLAGS	(VALID_FLAGS & PERSISTENT_FLAGS)
 
 	/** Handle for the DB used to track free pages. */
 #define	FREE_DBI	0
@@ -819,7 +919,8 @@ typedef struct MDB_meta {
 		/** Stamp identifying this as an MDB file. It must be set
 		 *	to #MDB_MAGIC. */
 	uint32_t	mm_magic;
-		/** Version number of this lock file. Must be set to #MDB_DATA_VERSION. */
+		/** Version number of this data file. Must be set to #MDB_DATA_VERSION,
+		 *	or #MDB_DATA_VERSION_PREFIX. */
 	uint32_t	mm_version;
 	void		*mm_address;		/**< address for fixed mapping */
 	size_t		mm_mapsize;			/**< size of mmap region */
@@ -855,6 +956,8 @@ typedef struct MDB_dbx {
 	MDB_cmp_func	*md_dcmp;	/**< function for comparing data items */
 	MDB_rel_func	*md_rel;	/**< user relocate function */
 	void		*md_relctx;		/**< user-provided context for md_rel */
+	unsigned int	md_split;	/**< left page fill after a leaf split, or 0 */
+	unsigned int	md_merge;	/**< merge threshold, or 0 for #FILL_THRESHOLD */
 } MDB_dbx;
 
 	/** A database transaction.
@@ -879,7 +982,7 @@ struct MDB_txn {
 	 */
 	MDB_IDL		mt_spill_pgs;
 	union {
-		/** For write txns: Modified pages. Sorted when not MDB_WRITEMAP. */
+		/** For write txns: Modified pages, see @ref dhash. */
 		MDB_ID2L	dirty_list;
 		/** For read txns: This thread/txn's reader table slot, or NULL. */
 		MDB_reader	*reader;
@@ -914,6 +1017,7 @@ struct MDB_txn {
 #define MDB_TXN_ERROR		0x02		/**< an error has occurred */
 #define MDB_TXN_DIRTY		0x04		/**< must write, even if dirty list is empty */
 #define MDB_TXN_SPILLS		0x08		/**< txn or a parent has spilled pages */
+#define MDB_TXN_PREFIXKEY	0x10		/**< commit as #MDB_DATA_VERSION_PREFIX */
 /** @} */
 	unsigned int	mt_flags;		/**< @ref mdb_txn */
 	/** dirty_list room: Array size - #dirty pages visible to this txn.
@@ -922,6 +1026,10 @@ struct MDB_txn {
 	 *	dirty_list into mt_parent after freeing hidden mt_parent pages.
 	 */
 	unsigned int	mt_dirty_room;
+	/** dirty_list[1..mt_dirty_sorted] is in page number order */
+	unsigned int	mt_dirty_sorted;
+	/** Hash table over dirty_list, see @ref dhash */
+	MDB_ID2L	mt_dirty_hash;
 };
 
 /** Enough space for 2^32 nodes with minimum of 2 keys per node. I.e., plenty.
@@ -957,6 +1065,8 @@ struct MDB_cursor {
 	MDB_dbx		*mc_dbx;
 	/** The @ref mt_dbflag for this database */
 	unsigned char	*mc_dbflag;
+	/** Space to rebuild returned keys in, for #MDB_PREFIXKEY databases */
+	char		*mc_kbuf;
 	unsigned short 	mc_snum;	/**< number of pushed pages */
 	unsigned short	mc_top;		/**< index of top page, normally mc_snum-1 */
 /** @defgroup mdb_cursor	Cursor Flags
@@ -998,6 +1108,16 @@ typedef struct MDB_pgstate {
 	txnid_t		mf_pglast;	/**< ID of last used record, or 0 if !mf_pghead */
 } MDB_pgstate;
 
+	/** A run of contiguous pages in me_pghead, see @ref pgext */
+typedef struct MDB_pgext {
+	pgno_t		mx_pgno;	/**< first page of the run */
+	pgno_t		mx_len;		/**< number of pages in the run */
+} MDB_pgext;
+
+#ifdef MDB_USE_IO_URING
+typedef struct MDB_uring MDB_uring;
+#endif
+
 	/** The database environment. */
 struct MDB_env {
 	HANDLE		me_fd;		/**< The main data file */
@@ -1016,6 +1136,7 @@ struct MDB_env {
 	unsigned int	me_os_psize;	/**< OS page size, from #GET_PAGESIZE */
 	unsigned int	me_maxreaders;	/**< size of the reader table */
 	unsigned int	me_numreaders;	/**< max numreaders set by this env */
+	unsigned int	me_rhint;	/**< reader slot to try first, see #mdb_reader_claim() */
 	MDB_dbi		me_numdbs;		/**< number of DBs opened */
 	MDB_dbi		me_maxdbs;		/**< size of the DB table */
 	MDB_PID_T	me_pid;		/**< process ID of this env */
@@ -1024,6 +1145,11 @@ struct MDB_env {
 	MDB_txninfo	*me_txns;		/**< the memory map of the lock file or NULL */
 	MDB_meta	*me_metas[2];	/**< pointers to the two meta pages */
 	void		*me_pbuf;		/**< scratch area for DUPSORT put() */
+	/** Scratch area for two keys of #ENV_MAXKEY() size each. Page splits,
+	 *	merges and rebalances of every DB build keys in it: keys of
+	 *	#P_PREFIX pages and the separators cut for branch pages.
+	 */
+	char		*me_kbuf;
 	MDB_txn		*me_txn;		/**< current write transaction */
 	size_t		me_mapsize;		/**< size of the data memory map */
 	off_t		me_size;		/**< current file size */
@@ -1034,15 +1160,70 @@ struct MDB_env {
 	MDB_pgstate	me_pgstate;		/**< state of old pages from freeDB */
 #	define		me_pglast	me_pgstate.mf_pglast
 #	define		me_pghead	me_pgstate.mf_pghead
+	MDB_pgext	*me_pgext[2];	/**< extent index of me_pghead, see @ref pgext */
+	int			me_pgext_ok;	/**< me_pgext[] is in sync with me_pghead */
+	txnid_t		me_oldest;		/**< cached result of #mdb_find_oldest() */
+	txnid_t		me_oldest_txnid;	/**< write txn #me_oldest was found in */
+	pgno_t		me_oldest_pgno;	/**< its mt_next_pgno at the time */
 	MDB_page	*me_dpages;		/**< list of malloc'd blocks for re-use */
+	char		*me_arena;		/**< dirty page arena, see @ref arena */
+	size_t		me_arena_size;	/**< bytes reserved for #me_arena */
+	size_t		me_arena_retain;	/**< bytes of #me_arena kept between txns */
+	size_t		me_arena_used;	/**< bytes of #me_arena handed out in this txn */
+	size_t		me_arena_resident;	/**< bytes of #me_arena backed by memory */
+	MDB_page	*me_arena_free;	/**< arena pages freed in this txn */
+	unsigned int	me_arena_flags;	/**< #MDB_ARENA_HUGETLB, #MDB_ARENA_THP */
+	size_t		me_arena_pages;	/**< counters for #mdb_env_arena_info() */
+	size_t		me_arena_reused;
+	size_t		me_arena_fallbacks;
 	/** IDL of pages that became unused in a write txn */
 	MDB_IDL		me_free_pgs;
-	/** ID2L of pages written during a write txn. Length MDB_IDL_UM_SIZE. */
+	/** ID2L of pages written during a write txn. Length me_maxdirty+1. */
 	MDB_ID2L	me_dirty_list;
+	/** Hash table over me_dirty_list, see @ref dhash */
+	MDB_ID2L	me_dirty_hash;
+	/** Max number of dirty pages in a write txn before pages get spilled */
+	unsigned int	me_maxdirty;
+	/** Bytes of pages flushed by write txns since the env was opened,
+	 *	counted once the meta page of their commit is written. This and
+	 *	#me_synced are read and updated under #me_sync_mutex, since a
+	 *	background thread may sync the env while a txn commits.
+	 */
+	size_t		me_written;
+	/** #me_written as of the start of the last completed sync */
+	size_t		me_synced;
+	/** Bytes flushed by the current write txn, not yet in #me_written */
+	size_t		me_flushed;
+	/** The last commit counted in #me_written. Writes of commits by other
+	 *	processes in between are not, so they need a sync of the whole map.
+	 */
+	txnid_t		me_written_txnid;
+#ifdef MDB_USE_IO_URING
+	MDB_uring	*me_uring;		/**< ring for #MDB_IO_URING, see @ref uring */
+#endif
+#ifndef _WIN32
+	/** The newest two commits made by #mdb_txn_commit_async() in an
+	 *	#MDB_PIPELINE environment, indexed by txnid & 1. They are only
+	 *	valid for ids above the durable one, up to #me_pending_txnid.
+	 */
+	MDB_meta	me_pending[2];
+	txnid_t		me_pending_txnid;
+	txnid_t		me_durable;		/**< newest commit known to be durable */
+	int			me_syncing;		/**< a thread is in #mdb_env_sync_txn() */
+	int			me_pend_locked;	/**< we hold #MDB_PENDING_LOCK */
+	int			me_sync_rc;		/**< a failed sync makes later ones fail */
+	pthread_mutex_t	me_sync_mutex;	/**< protects the fields above */
+	pthread_cond_t	me_sync_cond;	/**< signalled when #me_durable advances */
+	/** Freed top-level txns for re-use, linked by mt_child, see #mdb_txn_free() */
+	MDB_txn		*me_txn_pool;
+	unsigned int	me_txn_pooled;	/**< number of txns in #me_txn_pool */
+	pthread_mutex_t	me_txn_mutex;	/**< protects #me_txn_pool */
+#endif
 	/** Max number of freelist items that can fit in a single overflow page */
 	int			me_maxfree_1pg;
 	/** Max size of a node on a page */
 	unsigned int	me_nodemax;
+	unsigned int	me_maxkey;	/**< max size of a key, see #ENV_MAXKEY() */
 #ifdef _WIN32
 	int		me_pidquery;		/**< Used in OpenProcess */
 	HANDLE		me_rmutex;		/* Windows mutexes don't reside in shared mem */
@@ -1066,9 +1247,23 @@ typedef struct MDB_ntxn {
 #define MDB_COMMIT_PAGES	IOV_MAX
 #endif
 
+	/** max number of freed txns an environment keeps for re-use */
+#define MDB_TXN_POOL	32
+
 	/* max bytes to write in one call */
 #define MAX_WRITE		(0x80000000U >> (sizeof(ssize_t) == 4))
 
+	/** max number of separate ranges to msync() at the end of an
+	 *	#MDB_WRITEMAP commit. Each one is a sync of its own, so beyond
+	 *	this the span from the first dirty page to the last is synced.
+	 */
+#define MDB_MSYNC_RANGES	8
+
+	/** dirty ranges of an #MDB_WRITEMAP commit closer than this many
+	 *	bytes are synced as one
+	 */
+#define MDB_MSYNC_GAP	(1U << 20)
+
 static int  mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp);
 static int  mdb_page_new(MDB_cursor *mc, uint32_t flags, int num, MDB_page **mp);
 static int  mdb_page_touch(MDB_cursor *mc);
@@ -1090,7 +1285,11 @@ static int	mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata,
 
 static int  mdb_env_read_header(MDB_env *env, MDB_meta *meta);
 static int  mdb_env_pick_meta(const MDB_env *env);
-static int  mdb_env_write_meta(MDB_txn *txn);
+#ifndef _WIN32
+static txnid_t mdb_env_durable(MDB_env *env);
+#endif
+static void mdb_txn_meta(MDB_txn *txn, MDB_meta *meta);
+static int  mdb_env_write_meta(MDB_env *env, const MDB_meta *src);
 #if !(defined(_WIN32) || defined(MDB_USE_POSIX_SEM)) /* Drop unused excl arg */
 # define mdb_env_close0(env, excl) mdb_env_close1(env)
 #endif
@@ -1127,6 +1326,11 @@ static void	mdb_xcursor_init1(MDB_cursor *mc, MDB_node *node);
 
 static int	mdb_drop0(MDB_cursor *mc, int subs);
 static void mdb_default_cmp(MDB_txn *txn, MDB_dbi dbi);
+#ifdef MDB_USE_SIMD
+static void mdb_count_init(void);
+	/** Guards the one-time setup of #mdb_count_funcs */
+static pthread_once_t mdb_count_once = PTHREAD_ONCE_INIT;
+#endif
 
 /** @cond */
 static MDB_cmp_func	mdb_cmp_memn, mdb_cmp_memnr, mdb_cmp_int, mdb_cmp_cint, mdb_cmp_long;
@@ -1202,7 +1406,7 @@ mdb_dkey(MDB_val *key, char *buf)
 	if (!key)
 		return "";
 
-	if (key->mv_size > MDB_MAXKEYSIZE)
+	if (key->mv_size > DKBUF_MAXKEYSIZE)
 		return "MDB_MAXKEYSIZE";
 	/* may want to make this a dynamic check: if the key is mostly
 	 * printable characters, print it as-is instead of converting to hex.
@@ -1330,8 +1534,13 @@ mdb_dcmp(MDB_txn *txn, MDB_dbi dbi, const MDB_val *a, const MDB_val *b)
 	return txn->mt_dbxs[dbi].md_dcmp(a, b);
 }
 
+#define MDB_ARENA_PAGE(env, p) ((env)->me_arena && \
+	(size_t)((char *)(p) - (env)->me_arena) < (env)->me_arena_size)
+static MDB_page *mdb_arena_alloc(MDB_env *env, size_t size);
+
 /** Allocate memory for a page.
- * Re-use old malloc'd pages first for singletons, otherwise just malloc.
+ * Re-use old malloc'd pages first for singletons, otherwise take it
+ * from the arena, or just malloc.
  */
 static MDB_page *
 mdb_page_malloc(MDB_txn *txn, unsigned num)
@@ -1345,6 +1554,15 @@ mdb_page_malloc(MDB_txn *txn, unsigned num)
 	 * many pages they will be filling in at least up to the last page.
 	 */
 	if (num == 1) {
+		if (env->me_arena_free) {
+			ret = env->me_arena_free;
+			VGMEMP_ALLOC(env, ret, sz);
+			VGMEMP_DEFINED(ret, sizeof(ret->mp_next));
+			env->me_arena_free = ret->mp_next;
+			env->me_arena_pages++;
+			env->me_arena_reused++;
+			return ret;
+		}
 		if (ret) {
 			VGMEMP_ALLOC(env, ret, sz);
 			VGMEMP_DEFINED(ret, sizeof(ret->mp_next));
@@ -1356,7 +1574,8 @@ mdb_page_malloc(MDB_txn *txn, unsigned num)
 		sz *= num;
 		off = sz - psize;
 	}
-	if ((ret = malloc(sz)) != NULL) {
+	if ((env->me_arena && (ret = mdb_arena_alloc(env, sz)) != NULL) ||
+		(ret = malloc(sz)) != NULL) {
 		if (!(env->me_flags & MDB_NOMEMINIT)) {
 			memset((char *)ret + off, 0, psize);
 			ret->mp_pad = 0;
@@ -1373,9 +1592,14 @@ mdb_page_malloc(MDB_txn *txn, unsigned num)
 static void
 mdb_page_free(MDB_env *env, MDB_page *mp)
 {
-	mp->mp_next = env->me_dpages;
 	VGMEMP_FREE(env, mp);
-	env->me_dpages = mp;
+	if (MDB_ARENA_PAGE(env, mp)) {
+		mp->mp_next = env->me_arena_free;
+		env->me_arena_free = mp;
+	} else {
+		mp->mp_next = env->me_dpages;
+		env->me_dpages = mp;
+	}
 }
 
 /** Free a dirty page */
@@ -1384,6 +1608,11 @@ mdb_dpage_free(MDB_env *env, MDB_page *dp)
 {
 	if (!IS_OVERFLOW(dp) || dp->mp_pages == 1) {
 		mdb_page_free(env, dp);
+	} else if (MDB_ARENA_PAGE(env, dp)) {
+		/* Arena runs are split up for use as single pages */
+		unsigned i, n = dp->mp_pages;
+		for (i = 0; i < n; i++)
+			mdb_page_free(env, (MDB_page *)((char *)dp + i * env->me_psize));
 	} else {
 		/* large pages just get freed directly */
 		VGMEMP_FREE(env, dp);
@@ -1391,6 +1620,318 @@ mdb_dpage_free(MDB_env *env, MDB_page *dp)
 	}
 }
 
+/** @defgroup arena	Dirty page arena
+ *
+ *	A write txn that dirties many pages would otherwise malloc each of
+ *	them and its overflow runs, and free them all again when it ends.
+ *	With #mdb_env_set_arena() they are instead carved in order from one
+ *	anonymous mapping, reserved when the environment is opened and
+ *	optionally backed by huge pages. Pages freed during the txn are kept
+ *	on #me_arena_free for re-use within it; when a top-level txn ends
+ *	the whole arena is reset at once by #mdb_arena_reset(). Memory the
+ *	arena touched stays mapped for the next txn, up to the retain limit.
+ *	Pages that don't fit are malloc'd as before.
+ *	@{
+ */
+#ifndef _WIN32
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+#endif
+
+	/** Size of a huge page, the granularity of a huge page backed arena */
+#define MDB_ARENA_HUGE	(2U << 20)
+
+/** Reserve the arena of an environment, if it has one configured.
+ * @param[in] env the environment
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_arena_open(MDB_env *env)
+{
+#ifndef _WIN32
+	size_t size;
+	void *p = MAP_FAILED;
+
+	if (env->me_arena_flags & (MDB_ARENA_HUGETLB|MDB_ARENA_THP)) {
+		env->me_arena_size = (env->me_arena_size + MDB_ARENA_HUGE-1) & ~(size_t)(MDB_ARENA_HUGE-1);
+		env->me_arena_retain = (env->me_arena_retain + MDB_ARENA_HUGE-1) & ~(size_t)(MDB_ARENA_HUGE-1);
+	}
+	size = env->me_arena_size;
+#ifdef MAP_HUGETLB
+	/* Without MAP_NORESERVE, this fails unless the huge pages exist */
+	if (env->me_arena_flags & MDB_ARENA_HUGETLB)
+		p = mmap(NULL, size, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+	if (p == MAP_FAILED) {
+		env->me_arena_flags &= ~MDB_ARENA_HUGETLB;
+		p = mmap(NULL, size, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (p == MAP_FAILED)
+			return ErrCode();
+#ifdef MADV_HUGEPAGE
+		if (env->me_arena_flags & MDB_ARENA_THP)
+			(void) madvise(p, size, MADV_HUGEPAGE);
+#endif
+	}
+	env->me_arena = p;
+#endif
+	return MDB_SUCCESS;
+}
+
+/** Release the arena of an environment.
+ * @param[in] env the environment
+ */
+static void
+mdb_arena_close(MDB_env *env)
+{
+#ifndef _WIN32
+	if (env->me_arena)
+		munmap(env->me_arena, env->me_arena_size);
+#endif
+	env->me_arena = NULL;
+	env->me_arena_free = NULL;
+	env->me_arena_used = env->me_arena_resident = 0;
+}
+
+/** Take memory for a page or a run of pages from the arena.
+ * @param[in] env the environment
+ * @param[in] size the number of bytes
+ * @return the memory, or NULL if the arena is used up.
+ */
+static MDB_page *
+mdb_arena_alloc(MDB_env *env, size_t size)
+{
+	MDB_page *ret;
+	size_t num = size / env->me_psize;
+
+	if (size > env->me_arena_size - env->me_arena_used) {
+		env->me_arena_fallbacks += num;
+		return NULL;
+	}
+	ret = (MDB_page *)(env->me_arena + env->me_arena_used);
+	env->me_arena_used += size;
+	env->me_arena_pages += num;
+	if (env->me_arena_used <= env->me_arena_resident)
+		env->me_arena_reused += num;
+	return ret;
+}
+
+/** Make the whole arena free again at the end of a top-level write txn,
+ *	and give back the memory it touched beyond the retain limit.
+ * @param[in] env the environment
+ */
+static void
+mdb_arena_reset(MDB_env *env)
+{
+	size_t used = env->me_arena_used;
+
+	if (!env->me_arena)
+		return;
+	env->me_arena_free = NULL;
+	env->me_arena_used = 0;
+	if (env->me_arena_resident < used)
+		env->me_arena_resident = used;
+#ifndef _WIN32
+	if (env->me_arena_resident > env->me_arena_retain) {
+		(void) madvise(env->me_arena + env->me_arena_retain,
+			env->me_arena_resident - env->me_arena_retain, MADV_DONTNEED);
+		env->me_arena_resident = env->me_arena_retain;
+	}
+#endif
+}
+
+int
+mdb_env_set_arena(MDB_env *env, size_t size, size_t retain, unsigned int flags)
+{
+	if (!env || env->me_map || (flags & ~(MDB_ARENA_HUGETLB|MDB_ARENA_THP)))
+		return EINVAL;
+	env->me_arena_size = size;
+	env->me_arena_retain = retain < size ? retain : size;
+	env->me_arena_flags = flags;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_env_arena_info(MDB_env *env, MDB_arenainfo *info)
+{
+	if (!env || !info)
+		return EINVAL;
+	info->ma_size = env->me_arena ? env->me_arena_size : 0;
+	info->ma_resident = env->me_arena_resident > env->me_arena_used ?
+		env->me_arena_resident : env->me_arena_used;
+	info->ma_pages = env->me_arena_pages;
+	info->ma_reused = env->me_arena_reused;
+	info->ma_fallbacks = env->me_arena_fallbacks;
+	info->ma_flags = env->me_arena ? env->me_arena_flags : 0;
+	return MDB_SUCCESS;
+}
+/** @} */
+
+/** @defgroup dhash	Dirty page list
+ *
+ *	Keeping mt_u.dirty_list sorted on every insert costs a memmove of
+ *	the tail of the list per dirty page, which adds up in transactions
+ *	that touch many pages out of order. Pages are now appended, and a
+ *	hash table with linear probing maps page numbers to dirty pages
+ *	for lookups. The list is only sorted, by #mdb_dlist_sort(), where
+ *	page order matters: before pages are flushed, spilled or merged
+ *	into a parent txn.
+ *
+ *	The table is an ID2L whose element 0 holds the number of slots, a
+ *	power of two. Slots with mid 0 are free; page 0 is a meta page and
+ *	never dirty. It is kept at most half full, and holds exactly the
+ *	pages in the dirty list.
+ *	@{
+ */
+#define DHASH_START	1024	/**< initial number of slots */
+
+static unsigned
+mdb_dhash_slot(MDB_ID2L dh, pgno_t pgno)
+{
+	unsigned h = (unsigned)pgno * 2654435761U;
+	return 1 + ((h ^ (h >> 16)) & (unsigned)(dh[0].mid - 1));
+}
+
+#define DHASH_NEXT(dh, i)	((i) == (dh)[0].mid ? 1 : (i) + 1)
+
+/** Add or replace a page in the hash table */
+static void
+mdb_dhash_put(MDB_ID2L dh, MDB_ID2 *id)
+{
+	unsigned i = mdb_dhash_slot(dh, id->mid);
+
+	while (dh[i].mid && dh[i].mid != id->mid)
+		i = DHASH_NEXT(dh, i);
+	dh[i] = *id;
+}
+
+/** Look up a dirty page by page number */
+static MDB_page *
+mdb_dhash_get(MDB_ID2L dh, pgno_t pgno)
+{
+	unsigned i = mdb_dhash_slot(dh, pgno);
+
+	for (; dh[i].mid; i = DHASH_NEXT(dh, i))
+		if (dh[i].mid == pgno)
+			return dh[i].mptr;
+	return NULL;
+}
+
+/** Remove a page from the hash table, shifting back the pages after it */
+static void
+mdb_dhash_del(MDB_ID2L dh, pgno_t pgno)
+{
+	unsigned i = mdb_dhash_slot(dh, pgno), j, k;
+
+	for (; dh[i].mid != pgno; i = DHASH_NEXT(dh, i))
+		if (!dh[i].mid)
+			return;
+	for (j = i;;) {
+		j = DHASH_NEXT(dh, j);
+		if (!dh[j].mid)
+			break;
+		k = mdb_dhash_slot(dh, dh[j].mid);
+		/* Leave it if its home slot is cyclically in (i, j] */
+		if (i < j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		dh[i] = dh[j];
+		i = j;
+	}
+	dh[i].mid = 0;
+}
+
+/** Empty the hash table of all pages in the txn's dirty list */
+static void
+mdb_dhash_clear(MDB_txn *txn)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list, dh = txn->mt_dirty_hash;
+	unsigned i, n = dl[0].mid;
+
+	if (n > dh[0].mid / 8) {
+		memset(dh + 1, 0, dh[0].mid * sizeof(MDB_ID2));
+	} else {
+		for (i = 1; i <= n; i++)
+			mdb_dhash_del(dh, dl[i].mid);
+	}
+}
+
+/** Rebuild the hash table of a txn with \b size slots */
+static int
+mdb_dhash_resize(MDB_txn *txn, unsigned size)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list, dh;
+	unsigned i;
+
+	if (!(dh = malloc((size + 1) * sizeof(MDB_ID2))))
+		return ENOMEM;
+	memset(dh + 1, 0, size * sizeof(MDB_ID2));
+	dh[0].mid = size;
+	for (i = 1; i <= dl[0].mid; i++)
+		mdb_dhash_put(dh, &dl[i]);
+
+	free(txn->mt_dirty_hash);
+	txn->mt_dirty_hash = dh;
+	if (!txn->mt_parent)
+		txn->mt_env->me_dirty_hash = dh;
+	return MDB_SUCCESS;
+}
+
+/** Make sure the hash table has room for \b num more dirty pages */
+static int
+mdb_dhash_need(MDB_txn *txn, unsigned num)
+{
+	unsigned size = txn->mt_dirty_hash[0].mid;
+
+	num += txn->mt_u.dirty_list[0].mid;
+	if (num * 2 <= size)
+		return MDB_SUCCESS;
+	while (num * 2 > size)
+		size *= 2;
+	return mdb_dhash_resize(txn, size);
+}
+
+/** Append a page to the txn's dirty list.
+ * The caller must have checked that the list has room.
+ */
+static int
+mdb_dlist_insert(MDB_txn *txn, MDB_ID2 *id)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+	unsigned n = dl[0].mid + 1;
+	int rc;
+
+	if ((rc = mdb_dhash_need(txn, 1)) != MDB_SUCCESS)
+		return rc;
+
+	dl[n] = *id;
+	dl[0].mid = n;
+	if (txn->mt_dirty_sorted == n - 1 && (n == 1 || dl[n-1].mid < id->mid))
+		txn->mt_dirty_sorted = n;
+	mdb_dhash_put(txn->mt_dirty_hash, id);
+	return MDB_SUCCESS;
+}
+
+static int
+mdb_mid2_cmp(const void *a, const void *b)
+{
+	MDB_ID x = ((const MDB_ID2 *)a)->mid, y = ((const MDB_ID2 *)b)->mid;
+	return x < y ? -1 : x > y;
+}
+
+/** Put the txn's dirty list in page number order */
+static void
+mdb_dlist_sort(MDB_txn *txn)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+
+	if (txn->mt_dirty_sorted < dl[0].mid)
+		qsort(dl + 1, dl[0].mid, sizeof(MDB_ID2), mdb_mid2_cmp);
+	txn->mt_dirty_sorted = dl[0].mid;
+}
+/** @} */
+
 /**	Return all dirty pages to dpage list */
 static void
 mdb_dlist_free(MDB_txn *txn)
@@ -1399,10 +1940,12 @@ mdb_dlist_free(MDB_txn *txn)
 	MDB_ID2L dl = txn->mt_u.dirty_list;
 	unsigned i, n = dl[0].mid;
 
+	mdb_dhash_clear(txn);
 	for (i = 1; i <= n; i++) {
 		mdb_dpage_free(env, dl[i].mptr);
 	}
 	dl[0].mid = 0;
+	txn->mt_dirty_sorted = 0;
 }
 
 /** Set or clear P_KEEP in dirty, non-overflow, non-sub pages watched by txn.
@@ -1471,7 +2014,8 @@ mdb_pages_xkeep(MDB_cursor *mc, unsigned pflags, int all)
 	return rc;
 }
 
-static int mdb_page_flush(MDB_txn *txn, int keep);
+static int mdb_page_flush(MDB_txn *txn, int keep, int sync);
+static int mdb_pages_spill(MDB_cursor *m0, unsigned int need);
 
 /**	Spill pages from the dirty list back to disk.
  * This is intended to prevent running into #MDB_TXN_FULL situations,
@@ -1509,10 +2053,7 @@ static int
 mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 {
 	MDB_txn *txn = m0->mc_txn;
-	MDB_page *dp;
-	MDB_ID2L dl = txn->mt_u.dirty_list;
-	unsigned int i, j, need;
-	int rc;
+	unsigned int i, need;
 
 	if (m0->mc_flags & C_SUB)
 		return MDB_SUCCESS;
@@ -1531,8 +2072,36 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	if (txn->mt_dirty_room > i)
 		return MDB_SUCCESS;
 
+	/* Less aggressive spill - we originally spilled the entire dirty list,
+	 * with a few exceptions for cursor pages and DB root pages. But this
+	 * turns out to be a lot of wasted effort because in a large txn many
+	 * of those pages will need to be used again. So now we spill only 1/8th
+	 * of the dirty pages. Testing revealed this to be a good tradeoff,
+	 * better than 1/2, 1/4, or 1/10.
+	 */
+	if (need < txn->mt_env->me_maxdirty / 8)
+		need = txn->mt_env->me_maxdirty / 8;
+
+	return mdb_pages_spill(m0, need);
+}
+
+/** Spill up to \b need pages from the tail of the dirty list.
+ *	Pages seen by cursors and DB root pages are kept, see #mdb_page_spill().
+ * @param[in] m0 cursor A cursor handle identifying the transaction.
+ * @param[in] need The number of pages to spill.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_pages_spill(MDB_cursor *m0, unsigned int need)
+{
+	MDB_txn *txn = m0->mc_txn;
+	MDB_page *dp;
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+	unsigned int i, j;
+	int rc;
+
 	if (!txn->mt_spill_pgs) {
-		txn->mt_spill_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX);
+		txn->mt_spill_pgs = mdb_midl_alloc(txn->mt_env->me_maxdirty);
 		if (!txn->mt_spill_pgs)
 			return ENOMEM;
 	} else {
@@ -1551,15 +2120,8 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	if ((rc = mdb_pages_xkeep(m0, P_DIRTY, 1)) != MDB_SUCCESS)
 		goto done;
 
-	/* Less aggressive spill - we originally spilled the entire dirty list,
-	 * with a few exceptions for cursor pages and DB root pages. But this
-	 * turns out to be a lot of wasted effort because in a large txn many
-	 * of those pages will need to be used again. So now we spill only 1/8th
-	 * of the dirty pages. Testing revealed this to be a good tradeoff,
-	 * better than 1/2, 1/4, or 1/10.
-	 */
-	if (need < MDB_IDL_UM_MAX / 8)
-		need = MDB_IDL_UM_MAX / 8;
+	/* Spill the highest page numbers */
+	mdb_dlist_sort(txn);
 
 	/* Save the page IDs of all the pages we're flushing */
 	/* flush from the tail forward, this saves a lot of shifting later on. */
@@ -1592,7 +2154,7 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	mdb_midl_sort(txn->mt_spill_pgs);
 
 	/* Flush the spilled part of dirty list */
-	if ((rc = mdb_page_flush(txn, i)) != MDB_SUCCESS)
+	if ((rc = mdb_page_flush(txn, i, 0)) != MDB_SUCCESS)
 		goto done;
 
 	/* Reset any dirty pages we kept that page_flush didn't see */
@@ -1603,62 +2165,318 @@ done:
 	return rc;
 }
 
-/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0. */
+/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0.
+ *
+ *	Readers which start during a write txn use the last committed txn,
+ *	mt_txnid-1, so a result found earlier in the same write txn is still
+ *	a safe lower bound. It can only be too low if an old reader has
+ *	finished since. The table is scanned again once the txn has grown
+ *	the map by as many pages as there are reader slots, which keeps the
+ *	cost per allocated page flat however many readers there are.
+ */
 static txnid_t
 mdb_find_oldest(MDB_txn *txn)
 {
-	int i;
+	MDB_env *env = txn->mt_env;
+	MDB_reader *r;
+	int i, n;
 	txnid_t mr, oldest = txn->mt_txnid - 1;
-	if (txn->mt_env->me_txns) {
-		MDB_reader *r = txn->mt_env->me_txns->mti_readers;
-		for (i = txn->mt_env->me_txns->mti_numreaders; --i >= 0; ) {
-			if (r[i].mr_pid) {
-				mr = r[i].mr_txnid;
-				if (oldest > mr)
-					oldest = mr;
-			}
-		}
+
+#ifndef _WIN32
+	/* Keep the newest durable snapshot intact, see @ref pipeline */
+	if (env->me_flags & MDB_PIPELINE) {
+		mr = mdb_env_durable(env);
+		if (oldest > mr)
+			oldest = mr;
 	}
+#endif
+	if (!env->me_txns)
+		return oldest;
+	n = env->me_txns->mti_numreaders;
+	if (env->me_oldest_txnid == txn->mt_txnid &&
+		(env->me_oldest == oldest ||
+		 txn->mt_next_pgno - env->me_oldest_pgno < (unsigned)n))
+		return env->me_oldest;
+
+	r = env->me_txns->mti_readers;
+	for (i = n; --i >= 0; ) {
+		if (r[i].mr_pid) {
+			mr = r[i].mr_txnid;
+			if (oldest > mr)
+				oldest = mr;
+		}
+	}
+	env->me_oldest = oldest;
+	env->me_oldest_txnid = txn->mt_txnid;
+	env->me_oldest_pgno = txn->mt_next_pgno;
 	return oldest;
 }
 
 /** Add a page to the txn's dirty list */
-static void
+static int
 mdb_page_dirty(MDB_txn *txn, MDB_page *mp)
 {
 	MDB_ID2 mid;
-	int (*insert)(MDB_ID2L, MDB_ID2 *);
+	int rc;
 
-	if (txn->mt_env->me_flags & MDB_WRITEMAP) {
-		insert = mdb_mid2l_append;
-	} else {
-		insert = mdb_mid2l_insert;
-	}
 	mid.mid = mp->mp_pgno;
 	mid.mptr = mp;
-	insert(txn->mt_u.dirty_list, &mid);
+	if ((rc = mdb_dlist_insert(txn, &mid)) != MDB_SUCCESS)
+		return rc;
 	txn->mt_dirty_room--;
+	return MDB_SUCCESS;
 }
 
-/** Allocate page numbers and memory for writing.  Maintain me_pglast,
- * me_pghead and mt_next_pgno.
+/** @defgroup pgext	Freelist extent index
  *
- * If there are free pages available from older transactions, they
- * are re-used first. Otherwise allocate a new page at mt_next_pgno.
- * Do not modify the freedB, just merge freeDB records into me_pghead[]
- * and move me_pglast to say which records were consumed.  Only this
- * function can create me_pghead and move me_pglast/mt_next_pgno.
- * @param[in] mc cursor A cursor handle identifying the transaction and
- *	database for which we are allocating.
- * @param[in] num the number of pages to allocate.
- * @param[out] mp Address of the allocated page(s). Requests for multiple pages
- *  will always be satisfied by a single contiguous chunk of memory.
- * @return 0 on success, non-zero on failure.
+ *	me_pghead[] is a descending list of page numbers, so finding \\b num
+ *	contiguous pages for an overflow page means scanning it, and the scan
+ *	is repeated every time another freeDB record gets merged in. On a
+ *	fragmented freelist that makes large allocations quadratic.
+ *
+ *	The extent index keeps every run of two or more contiguous pages in
+ *	me_pghead[] in two sorted lists: me_pgext[PGEXT_SIZE] by length and
+ *	page number, for best-fit lookups, and me_pgext[PGEXT_PGNO] by page
+ *	number, to find the run a page belongs to. Element 0 of each list
+ *	holds the number of runs in mx_len and the allocated size in mx_pgno.
+ *
+ *	The index is built by the first multi-page allocation of a write txn
+ *	and kept up to date by #mdb_page_alloc(). Anything else that changes
+ *	me_pghead[] must drop it with #mdb_pgext_reset().
+ *	@{
  */
+enum { PGEXT_SIZE, PGEXT_PGNO };
+
+#define mdb_pgext_reset(env)	((env)->me_pgext_ok = 0)
+
 static int
-mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
+mdb_pgext_cmp(const MDB_pgext *a, const MDB_pgext *b, int by)
 {
-#ifdef MDB_PARANOID	/* Seems like we can ignore this now */
+	if (by == PGEXT_SIZE && a->mx_len != b->mx_len)
+		return a->mx_len < b->mx_len ? -1 : 1;
+	return a->mx_pgno < b->mx_pgno ? -1 : a->mx_pgno > b->mx_pgno;
+}
+
+static int
+mdb_pgext_cmp_size(const void *a, const void *b)
+{
+	return mdb_pgext_cmp(a, b, PGEXT_SIZE);
+}
+
+/** Return the position of the first run in \\b xl that is not less than \\b key */
+static unsigned
+mdb_pgext_search(MDB_pgext *xl, const MDB_pgext *key, int by)
+{
+	unsigned lo = 1, hi = xl[0].mx_len + 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (mdb_pgext_cmp(&xl[mid], key, by) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/** Make sure both lists have room for \\b num runs */
+static int
+mdb_pgext_need(MDB_env *env, unsigned num)
+{
+	MDB_pgext *xl;
+	unsigned by, size;
+
+	for (by = 0; by < 2; by++) {
+		xl = env->me_pgext[by];
+		if (xl && xl[0].mx_pgno >= num)
+			continue;
+		size = num + (num >> 1) + 16;
+		if (!(xl = realloc(xl, (size + 1) * sizeof(MDB_pgext))))
+			return ENOMEM;
+		if (!env->me_pgext[by])
+			xl[0].mx_len = 0;
+		xl[0].mx_pgno = size;
+		env->me_pgext[by] = xl;
+	}
+	return MDB_SUCCESS;
+}
+
+/** Add the run of \\b len pages starting at \\b pgno to the index */
+static int
+mdb_pgext_insert(MDB_env *env, pgno_t pgno, pgno_t len)
+{
+	MDB_pgext key, *xl;
+	unsigned by, x;
+	int rc;
+
+	if (len < 2)
+		return MDB_SUCCESS;
+	if ((rc = mdb_pgext_need(env, env->me_pgext[0][0].mx_len + 1)))
+		return rc;
+
+	key.mx_pgno = pgno;
+	key.mx_len = len;
+	for (by = 0; by < 2; by++) {
+		xl = env->me_pgext[by];
+		x = mdb_pgext_search(xl, &key, by);
+		memmove(xl + x + 1, xl + x, (xl[0].mx_len - x + 1) * sizeof(MDB_pgext));
+		xl[x] = key;
+		xl[0].mx_len++;
+	}
+	return MDB_SUCCESS;
+}
+
+/** Remove a run from the index */
+static void
+mdb_pgext_delete(MDB_env *env, pgno_t pgno, pgno_t len)
+{
+	MDB_pgext key, *xl;
+	unsigned by, x;
+
+	if (len < 2)
+		return;
+
+	key.mx_pgno = pgno;
+	key.mx_len = len;
+	for (by = 0; by < 2; by++) {
+		xl = env->me_pgext[by];
+		x = mdb_pgext_search(xl, &key, by);
+		assert(x <= xl[0].mx_len && !mdb_pgext_cmp(&xl[x], &key, PGEXT_SIZE));
+		memmove(xl + x, xl + x + 1, (xl[0].mx_len - x) * sizeof(MDB_pgext));
+		xl[0].mx_len--;
+	}
+}
+
+/** Find the run that contains page \\b pgno.
+ * @return A copy of the run, or a run of length 0 if \\b pgno is not in one.
+ */
+static MDB_pgext
+mdb_pgext_find(MDB_env *env, pgno_t pgno)
+{
+	MDB_pgext key, *xl = env->me_pgext[PGEXT_PGNO];
+	unsigned x;
+
+	key.mx_pgno = pgno + 1;
+	key.mx_len = 0;
+	x = mdb_pgext_search(xl, &key, PGEXT_PGNO);
+	if (x > 1 && xl[x-1].mx_pgno + xl[x-1].mx_len > pgno)
+		return xl[x-1];
+	return key;
+}
+
+/** Build the index from scratch. On failure the index is just left out of use. */
+static int
+mdb_pgext_build(MDB_env *env)
+{
+	pgno_t *mop = env->me_pghead;
+	unsigned i, j, n = mop ? mop[0] : 0;
+	MDB_pgext *xl;
+	int rc;
+
+	if ((rc = mdb_pgext_need(env, n / 2)))
+		return rc;
+
+	/* Runs come out of the tail of me_pghead in ascending order */
+	xl = env->me_pgext[PGEXT_PGNO];
+	xl[0].mx_len = 0;
+	for (i = n; i; i = j) {
+		for (j = i - 1; j && mop[j] == mop[j+1] + 1; j--) ;
+		if (i - j >= 2) {
+			xl[++xl[0].mx_len].mx_pgno = mop[i];
+			xl[xl[0].mx_len].mx_len = i - j;
+		}
+	}
+	memcpy(env->me_pgext[PGEXT_SIZE] + 1, xl + 1, xl[0].mx_len * sizeof(MDB_pgext));
+	env->me_pgext[PGEXT_SIZE][0].mx_len = xl[0].mx_len;
+	qsort(env->me_pgext[PGEXT_SIZE] + 1, xl[0].mx_len, sizeof(MDB_pgext), mdb_pgext_cmp_size);
+
+	env->me_pgext_ok = 1;
+	return MDB_SUCCESS;
+}
+
+/** Update the index after the pages in \\b idl were merged into me_pghead.
+ * A new page may start a run, grow one, or join two runs into one.
+ */
+static int
+mdb_pgext_merge(MDB_env *env, MDB_IDL idl)
+{
+	pgno_t *mop = env->me_pghead, lo, hi = 0;
+	MDB_pgext run, *xl;
+	unsigned i, x, y, n;
+	int rc;
+
+	for (i = idl[0]; i; i--) {
+		if (idl[i] <= hi)
+			continue;	/* already part of the last run we indexed */
+
+		/* Walk out to both ends of the run, jumping over known runs */
+		x = y = mdb_midl_search(mop, idl[i]);
+		while (x < mop[0] && mop[x+1] == mop[x] - 1) {
+			run = mdb_pgext_find(env, mop[x+1]);
+			x += run.mx_len ? mop[x] - run.mx_pgno : 1;
+		}
+		while (y > 1 && mop[y-1] == mop[y] + 1) {
+			run = mdb_pgext_find(env, mop[y-1]);
+			y -= run.mx_len ? run.mx_pgno + run.mx_len - 1 - mop[y] : 1;
+		}
+		lo = mop[x];
+		hi = mop[y];
+		if (lo == hi)
+			continue;
+
+		/* Replace the runs inside [lo, hi] by a single one */
+		xl = env->me_pgext[PGEXT_PGNO];
+		run.mx_pgno = lo;
+		x = mdb_pgext_search(xl, &run, PGEXT_PGNO);
+		for (y = x; y <= xl[0].mx_len && xl[y].mx_pgno <= hi; y++) {
+			MDB_pgext *sl = env->me_pgext[PGEXT_SIZE];
+			n = mdb_pgext_search(sl, &xl[y], PGEXT_SIZE);
+			memmove(sl + n, sl + n + 1, (sl[0].mx_len - n) * sizeof(MDB_pgext));
+			sl[0].mx_len--;
+		}
+		memmove(xl + x, xl + y, (xl[0].mx_len - y + 1) * sizeof(MDB_pgext));
+		xl[0].mx_len -= y - x;
+		if ((rc = mdb_pgext_insert(env, lo, hi - lo + 1)))
+			return rc;
+	}
+	return MDB_SUCCESS;
+}
+
+/** Find the shortest run of at least \\b num pages.
+ * @return The position in me_pghead of the first page of the run, or 0.
+ */
+static unsigned
+mdb_pgext_fit(MDB_env *env, int num)
+{
+	MDB_pgext key, *xl = env->me_pgext[PGEXT_SIZE];
+	unsigned x;
+
+	key.mx_pgno = 0;
+	key.mx_len = num;
+	x = mdb_pgext_search(xl, &key, PGEXT_SIZE);
+	return x <= xl[0].mx_len ? mdb_midl_search(env->me_pghead, xl[x].mx_pgno) : 0;
+}
+/** @} */
+
+/** Allocate page numbers and memory for writing.  Maintain me_pglast,
+ * me_pghead and mt_next_pgno.
+ *
+ * If there are free pages available from older transactions, they
+ * are re-used first. Otherwise allocate a new page at mt_next_pgno.
+ * Do not modify the freedB, just merge freeDB records into me_pghead[]
+ * and move me_pglast to say which records were consumed.  Only this
+ * function can create me_pghead and move me_pglast/mt_next_pgno.
+ * @param[in] mc cursor A cursor handle identifying the transaction and
+ *	database for which we are allocating.
+ * @param[in] num the number of pages to allocate.
+ * @param[out] mp Address of the allocated page(s). Requests for multiple pages
+ *  will always be satisfied by a single contiguous chunk of memory.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
+{
+#ifdef MDB_PARANOID	/* Seems like we can ignore this now */
 	/* Get at most <Max_retries> more freeDB records once me_pghead
 	 * has enough pages.  If not enough, use new pages from the map.
 	 * If <Paranoid> and mc is updating the freeDB, only get new
@@ -1678,12 +2496,20 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 	txnid_t oldest = 0, last;
 	MDB_cursor_op op;
 	MDB_cursor m2;
+	MDB_pgext run;
 
 	*mp = NULL;
 
 	/* If our dirty list is already full, we can't do anything */
 	if (txn->mt_dirty_room == 0)
 		return MDB_TXN_FULL;
+	/* Make sure mdb_page_dirty() cannot fail once we have the page */
+	if ((rc = mdb_dhash_need(txn, 1)) != MDB_SUCCESS)
+		return rc;
+
+	/* Without the extent index we fall back to scanning me_pghead */
+	if (num > 1 && !env->me_pgext_ok)
+		mdb_pgext_build(env);
 
 	for (op = MDB_FIRST;; op = MDB_NEXT) {
 		MDB_val key, data;
@@ -1691,15 +2517,23 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		pgno_t *idl, old_id, new_id;
 
 		/* Seek a big enough contiguous page range. Prefer
-		 * pages at the tail, just truncating the list.
+		 * pages at the tail, just truncating the list, or
+		 * the best fit from the extent index.
 		 */
 		if (mop_len >= (unsigned)num) {
-			i = mop_len;
-			do {
-				pgno = mop[i];
-				if (mop[i-n2] == pgno+n2)
+			if (num > 1 && env->me_pgext_ok) {
+				if ((i = mdb_pgext_fit(env, num)) != 0) {
+					pgno = mop[i];
 					goto search_done;
-			} while (--i >= (unsigned)num);
+				}
+			} else {
+				i = mop_len;
+				do {
+					pgno = mop[i];
+					if (mop[i-n2] == pgno+n2)
+						goto search_done;
+				} while (--i >= (unsigned)num);
+			}
 			if (Max_retries < INT_MAX && --retry < 0)
 				break;
 		}
@@ -1767,6 +2601,8 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 			mop[k--] = new_id;
 		}
 		mop[0] = mop_len;
+		if (env->me_pgext_ok && mdb_pgext_merge(env, idl))
+			mdb_pgext_reset(env);
 	}
 
 	/* Use new pages from the map when nothing suitable in the freeDB */
@@ -1785,6 +2621,15 @@ search_done:
 			return ENOMEM;
 	}
 	if (i) {
+		/* We always take the first pages of a run */
+		if (env->me_pgext_ok) {
+			run = mdb_pgext_find(env, pgno);
+			if (run.mx_len) {
+				mdb_pgext_delete(env, run.mx_pgno, run.mx_len);
+				if (mdb_pgext_insert(env, pgno + num, run.mx_len - num))
+					mdb_pgext_reset(env);
+			}
+		}
 		mop[0] = mop_len -= num;
 		/* Move any stragglers down */
 		for (j = i-num; j < mop_len; )
@@ -1845,9 +2690,11 @@ mdb_page_unspill(MDB_txn *txn, MDB_page *mp, MDB_page **ret)
 		x = mdb_midl_search(tx2->mt_spill_pgs, pn);
 		if (x <= tx2->mt_spill_pgs[0] && tx2->mt_spill_pgs[x] == pn) {
 			MDB_page *np;
-			int num;
+			int num, rc;
 			if (txn->mt_dirty_room == 0)
 				return MDB_TXN_FULL;
+			if ((rc = mdb_dhash_need(txn, 1)) != MDB_SUCCESS)
+				return rc;
 			if (IS_OVERFLOW(mp))
 				num = mp->mp_pages;
 			else
@@ -1876,7 +2723,7 @@ mdb_page_unspill(MDB_txn *txn, MDB_page *mp, MDB_page **ret)
 				 * page remains spilled until child commits
 				 */
 
-			mdb_page_dirty(txn, np);
+			mdb_page_dirty(txn, np);	/* cannot fail, see above */
 			np->mp_flags |= P_DIRTY;
 			*ret = np;
 			break;
@@ -1929,24 +2776,24 @@ mdb_page_touch(MDB_cursor *mc)
 		/* If txn has a parent, make sure the page is in our
 		 * dirty list.
 		 */
-		if (dl[0].mid) {
-			unsigned x = mdb_mid2l_search(dl, pgno);
-			if (x <= dl[0].mid && dl[x].mid == pgno) {
-				if (mp != dl[x].mptr) { /* bad cursor? */
-					mc->mc_flags &= ~(C_INITIALIZED|C_EOF);
-					return MDB_CORRUPTED;
-				}
-				return 0;
+		if (dl[0].mid && (np = mdb_dhash_get(txn->mt_dirty_hash, pgno))) {
+			if (mp != np) { /* bad cursor? */
+				mc->mc_flags &= ~(C_INITIALIZED|C_EOF);
+				return MDB_CORRUPTED;
 			}
+			return 0;
 		}
-		assert(dl[0].mid < MDB_IDL_UM_MAX);
+		assert(dl[0].mid < txn->mt_env->me_maxdirty);
 		/* No - copy it */
 		np = mdb_page_malloc(txn, 1);
 		if (!np)
 			return ENOMEM;
 		mid.mid = pgno;
 		mid.mptr = np;
-		mdb_mid2l_insert(dl, &mid);
+		if ((rc = mdb_dlist_insert(txn, &mid)) != MDB_SUCCESS) {
+			mdb_dpage_free(txn->mt_env, np);
+			return rc;
+		}
 	} else {
 		return 0;
 	}
@@ -1984,10 +2831,49 @@ done:
 	return 0;
 }
 
+#ifdef _WIN32
+#define LOCK_SYNC(env)
+#define UNLOCK_SYNC(env)
+#else
+#define LOCK_SYNC(env)	pthread_mutex_lock(&(env)->me_sync_mutex)
+#define UNLOCK_SYNC(env)	pthread_mutex_unlock(&(env)->me_sync_mutex)
+#endif
+
+/** Record that the bytes counted in #me_written up to \b written are synced. */
+static void
+mdb_env_synced(MDB_env *env, size_t written)
+{
+	LOCK_SYNC(env);
+	if (written > env->me_synced)
+		env->me_synced = written;
+	UNLOCK_SYNC(env);
+}
+
+/** Count the pages flushed by a txn whose meta page has been written.
+ * @param[in] env An environment handle.
+ * @param[in] synced The commit synced its pages and its meta page, and
+ *	with them everything written before.
+ */
+static void
+mdb_env_written(MDB_env *env, int synced)
+{
+	LOCK_SYNC(env);
+	env->me_written += env->me_flushed;
+	if (synced)
+		env->me_synced = env->me_written;
+	UNLOCK_SYNC(env);
+	env->me_flushed = 0;
+}
+
 int
 mdb_env_sync(MDB_env *env, int force)
 {
 	int rc = 0;
+	size_t written;
+
+	LOCK_SYNC(env);
+	written = env->me_written;
+	UNLOCK_SYNC(env);
 	if (force || !F_ISSET(env->me_flags, MDB_NOSYNC)) {
 		if (env->me_flags & MDB_WRITEMAP) {
 			int flags = ((env->me_flags & MDB_MAPASYNC) && !force)
@@ -1998,9 +2884,13 @@ mdb_env_sync(MDB_env *env, int force)
 			else if (flags == MS_SYNC && MDB_FDATASYNC(env->me_fd))
 				rc = ErrCode();
 #endif
+			else if (flags == MS_SYNC)
+				mdb_env_synced(env, written);
 		} else {
 			if (MDB_FDATASYNC(env->me_fd))
 				rc = ErrCode();
+			else
+				mdb_env_synced(env, written);
 		}
 	}
 	return rc;
@@ -2144,6 +3034,212 @@ mdb_reader_pid(MDB_env *env, enum Pidlock_op op, MDB_PID_T pid)
 #endif
 }
 
+/** @defgroup pipeline	Pipelined commits
+ *
+ *	In an #MDB_PIPELINE env a commit only writes its pages and records
+ *	its meta in #MDB_env.me_pending before releasing the write lock.
+ *	#mdb_env_sync_txn() then syncs the data file and writes the meta
+ *	page for the newest pending commit. While that runs, the next write
+ *	txn starts from the pending meta. It may only reuse pages that are
+ *	free in the newest durable snapshot, so a crash at any point leaves
+ *	a usable meta page behind.
+ *	@{
+ */
+#ifndef _WIN32
+/** The byte of the lock file that a process holds a write lock on while
+ *	it has commits that are not durable yet. Writers in other processes
+ *	wait for it in #mdb_env_wait_pending(), and the kernel releases it
+ *	if the process dies. Reader pids are locked at their own offsets,
+ *	which stay well below this.
+ */
+#define MDB_PENDING_LOCK	0x7fffffff
+
+/** Take, wait for or release #MDB_PENDING_LOCK.
+ * @param[in] env the environment handle
+ * @param[in] type F_WRLCK to take the lock, waiting until no other
+ *	process holds it, or F_UNLCK to release it.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_env_pending_lock(MDB_env *env, short type)
+{
+	struct flock lock_info;
+	int rc;
+
+	memset(&lock_info, 0, sizeof(lock_info));
+	lock_info.l_type = type;
+	lock_info.l_whence = SEEK_SET;
+	lock_info.l_start = MDB_PENDING_LOCK;
+	lock_info.l_len = 1;
+	while ((rc = fcntl(env->me_lfd, type == F_UNLCK ? F_SETLK : F_SETLKW, &lock_info)) &&
+			(rc = ErrCode()) == EINTR) ;
+	return rc;
+}
+
+/** Return the newest commit whose meta page has been written */
+static txnid_t
+mdb_env_durable(MDB_env *env)
+{
+	if (env->me_txns)
+		return env->me_txns->mti_txnid;
+	return env->me_metas[mdb_env_pick_meta(env)]->mm_txnid;
+}
+
+/** Record a commit whose pages have been written. Expects the write lock.
+ * @param[in] env the environment handle
+ * @param[in] meta the commit's meta, filled in by #mdb_txn_meta()
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_env_pend(MDB_env *env, const MDB_meta *meta)
+{
+	MDB_txninfo *ti = env->me_txns;
+	int rc;
+
+	pthread_mutex_lock(&env->me_sync_mutex);
+	/* A failed sync loses this commit too, don't pretend otherwise */
+	if ((rc = env->me_sync_rc) == 0 && ti) {
+		/* Writers in other processes wait for us while this is held */
+		if (!env->me_pend_locked &&
+			!(rc = mdb_env_pending_lock(env, F_WRLCK)))
+			env->me_pend_locked = 1;
+		if (!rc) {
+			ti->mti_pending_pid = env->me_pid;
+			ti->mti_pending = meta->mm_txnid;
+		}
+	}
+	if (!rc) {
+		env->me_pending[meta->mm_txnid & 1] = *meta;
+		env->me_pending_txnid = meta->mm_txnid;
+	}
+	pthread_mutex_unlock(&env->me_sync_mutex);
+	return rc;
+}
+
+/** Wait for the pending commits of another process to become durable.
+ *	That process holds #MDB_PENDING_LOCK until they are. If it died or
+ *	failed to sync first its commits are lost, and we go on from the
+ *	last durable one. Expects the write lock.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_env_wait_pending(MDB_env *env)
+{
+	MDB_txninfo *ti = env->me_txns;
+	int rc;
+
+	if (ti->mti_pending_pid == env->me_pid)
+		return MDB_SUCCESS;
+	if ((rc = mdb_env_pending_lock(env, F_WRLCK)) ||
+		(rc = mdb_env_pending_lock(env, F_UNLCK)))
+		return rc;
+	if (ti->mti_pending > ti->mti_txnid)
+		ti->mti_pending = 0;
+	return MDB_SUCCESS;
+}
+#endif
+
+int
+mdb_env_sync_txn(MDB_env *env, size_t txnid)
+{
+#ifndef _WIN32
+	MDB_meta meta[2];
+	txnid_t durable, pending;
+	int rc;
+
+	if (!env)
+		return EINVAL;
+	if (!(env->me_flags & MDB_PIPELINE))
+		return MDB_SUCCESS;
+
+	pthread_mutex_lock(&env->me_sync_mutex);
+	if (txnid > env->me_pending_txnid && txnid > mdb_env_durable(env)) {
+		pthread_mutex_unlock(&env->me_sync_mutex);
+		return EINVAL;
+	}
+	while (!(rc = env->me_sync_rc) && (durable = mdb_env_durable(env)) < txnid) {
+		if (env->me_syncing) {
+			pthread_cond_wait(&env->me_sync_cond, &env->me_sync_mutex);
+			continue;
+		}
+		pending = env->me_pending_txnid;
+		meta[0] = env->me_pending[pending & 1];
+		meta[1] = env->me_pending[(pending - 1) & 1];
+		env->me_syncing = 1;
+		pthread_mutex_unlock(&env->me_sync_mutex);
+
+		/* Writing the newest meta into the slot of the durable one would
+		 * leave nothing to fall back on if that write is torn. Write the
+		 * one before it into the other slot first.
+		 */
+		if (!(rc = mdb_env_sync(env, 0)) &&
+			(((pending - durable) & 1) || !(rc = mdb_env_write_meta(env, &meta[1]))))
+			rc = mdb_env_write_meta(env, &meta[0]);
+
+		pthread_mutex_lock(&env->me_sync_mutex);
+		env->me_syncing = 0;
+		if (rc)
+			env->me_sync_rc = rc;
+		pthread_cond_broadcast(&env->me_sync_cond);
+	}
+	/* Let other processes write once nothing of ours is pending */
+	if (env->me_pend_locked && !env->me_syncing &&
+		(rc || mdb_env_durable(env) >= env->me_pending_txnid)) {
+		mdb_env_pending_lock(env, F_UNLCK);
+		env->me_pend_locked = 0;
+	}
+	pthread_mutex_unlock(&env->me_sync_mutex);
+	return rc;
+#else
+	return MDB_SUCCESS;
+#endif
+}
+/** @} */
+
+/** Claim a free slot in the reader table for this process.
+ *	Slots are taken with a compare-and-swap on their pid, so readers
+ *	don't serialize on the reader mutex. The search starts at the slot
+ *	this process released last, which is usually still free.
+ * @param[in] env the environment
+ * @param[out] ret the claimed slot, with its txnid still unset
+ * @return 0 on success, #MDB_READERS_FULL if all slots are taken.
+ */
+static int
+mdb_reader_claim(MDB_env *env, MDB_reader **ret)
+{
+	MDB_txninfo *ti = env->me_txns;
+	MDB_reader *mr = ti->mti_readers;
+	MDB_PID_T pid = env->me_pid;
+	unsigned int i, n, nr;
+
+	for (;;) {
+		nr = ti->mti_numreaders;
+		i = env->me_rhint;
+		for (n = 0; n < nr; n++, i++) {
+			if (i >= nr)
+				i = 0;
+			if (!mr[i].mr_pid && MDB_CAS32(&mr[i].mr_pid, 0, pid))
+				goto found;
+		}
+		if (nr >= env->me_maxreaders)
+			return MDB_READERS_FULL;
+		/* Open up a new slot. Another reader may get to it first. */
+		i = nr;
+		if (MDB_CAS32(&ti->mti_numreaders, nr, nr+1) &&
+			MDB_CAS32(&mr[i].mr_pid, 0, pid))
+			goto found;
+	}
+
+found:
+	mr[i].mr_tid = pthread_self();
+	env->me_rhint = i + 1;
+	/* Save numreaders for un-mutexed mdb_env_close() */
+	while ((n = env->me_numreaders) <= i && !MDB_CAS32(&env->me_numreaders, n, i+1))
+		;
+	*ret = &mr[i];
+	return MDB_SUCCESS;
+}
+
 /** Common code for #mdb_txn_begin() and #mdb_txn_renew().
  * @param[in] txn the transaction handle to initialize
  * @return 0 on success, non-zero on failure.
@@ -2154,7 +3250,7 @@ mdb_txn_renew0(MDB_txn *txn)
 	MDB_env *env = txn->mt_env;
 	MDB_txninfo *ti = env->me_txns;
 	MDB_meta *meta;
-	unsigned int i, nr;
+	unsigned int i;
 	uint16_t x;
 	int rc, new_notls = 0;
 
@@ -2174,49 +3270,42 @@ mdb_txn_renew0(MDB_txn *txn)
 				if (r->mr_pid != env->me_pid || r->mr_txnid != (txnid_t)-1)
 					return MDB_BAD_RSLOT;
 			} else {
-				MDB_PID_T pid = env->me_pid;
-				pthread_t tid = pthread_self();
-
 				if (!(env->me_flags & MDB_LIVE_READER)) {
-					rc = mdb_reader_pid(env, Pidset, pid);
-					if (rc) {
-						UNLOCK_MUTEX_R(env);
+					rc = mdb_reader_pid(env, Pidset, env->me_pid);
+					if (rc)
 						return rc;
-					}
 					env->me_flags |= MDB_LIVE_READER;
 				}
 
-				LOCK_MUTEX_R(env);
-				nr = ti->mti_numreaders;
-				for (i=0; i<nr; i++)
-					if (ti->mti_readers[i].mr_pid == 0)
-						break;
-				if (i == env->me_maxreaders) {
-					UNLOCK_MUTEX_R(env);
-					return MDB_READERS_FULL;
-				}
-				ti->mti_readers[i].mr_pid = pid;
-				ti->mti_readers[i].mr_tid = tid;
-				if (i == nr)
-					ti->mti_numreaders = ++nr;
-				/* Save numreaders for un-mutexed mdb_env_close() */
-				env->me_numreaders = nr;
-				UNLOCK_MUTEX_R(env);
-
-				r = &ti->mti_readers[i];
+				if ((rc = mdb_reader_claim(env, &r)) != MDB_SUCCESS)
+					return rc;
 				new_notls = (env->me_flags & MDB_NOTLS);
 				if (!new_notls && (rc=pthread_setspecific(env->me_txkey, r))) {
 					r->mr_pid = 0;
 					return rc;
 				}
 			}
-			txn->mt_txnid = r->mr_txnid = ti->mti_txnid;
+			/* Without the reader mutex a writer may not see our txnid
+			 * before it moves on; make sure it is still the latest.
+			 */
+			do {
+				r->mr_txnid = ti->mti_txnid;
+				MDB_FENCE();
+			} while (r->mr_txnid != ti->mti_txnid);
+			txn->mt_txnid = r->mr_txnid;
 			txn->mt_u.reader = r;
 			meta = env->me_metas[txn->mt_txnid & 1];
 		}
 	} else {
 		if (ti) {
 			LOCK_MUTEX_W(env);
+#ifndef _WIN32
+			if (ti->mti_pending > ti->mti_txnid &&
+				(rc = mdb_env_wait_pending(env)) != MDB_SUCCESS) {
+				UNLOCK_MUTEX_W(env);
+				return rc;
+			}
+#endif
 
 			txn->mt_txnid = ti->mti_txnid;
 			meta = env->me_metas[txn->mt_txnid & 1];
@@ -2224,17 +3313,33 @@ mdb_txn_renew0(MDB_txn *txn)
 			meta = env->me_metas[ mdb_env_pick_meta(env) ];
 			txn->mt_txnid = meta->mm_txnid;
 		}
+#ifndef _WIN32
+		if (env->me_flags & MDB_PIPELINE) {
+			/* Go on from our newest commit, durable or not */
+			pthread_mutex_lock(&env->me_sync_mutex);
+			if (env->me_pending_txnid > txn->mt_txnid) {
+				txn->mt_txnid = env->me_pending_txnid;
+				meta = &env->me_pending[txn->mt_txnid & 1];
+			}
+			pthread_mutex_unlock(&env->me_sync_mutex);
+		}
+#endif
 		txn->mt_txnid++;
+		if (meta->mm_version == MDB_DATA_VERSION_PREFIX)
+			txn->mt_flags |= MDB_TXN_PREFIXKEY;
 #if MDB_DEBUG
 		if (txn->mt_txnid == mdb_debug_start)
 			mdb_debug = 1;
 #endif
-		txn->mt_dirty_room = MDB_IDL_UM_MAX;
+		txn->mt_dirty_room = env->me_maxdirty;
 		txn->mt_u.dirty_list = env->me_dirty_list;
 		txn->mt_u.dirty_list[0].mid = 0;
+		txn->mt_dirty_sorted = 0;
+		txn->mt_dirty_hash = env->me_dirty_hash;
 		txn->mt_free_pgs = env->me_free_pgs;
 		txn->mt_free_pgs[0] = 0;
 		txn->mt_spill_pgs = NULL;
+		env->me_flushed = 0;
 		env->me_txn = txn;
 	}
 
@@ -2285,6 +3390,62 @@ mdb_txn_renew(MDB_txn *txn)
 	return rc;
 }
 
+/** Get a zeroed top-level txn, from the environment's pool if it has one.
+ *	Only the MDB_txn itself is cleared for a pooled txn. #mdb_txn_renew0()
+ *	sets up the DB records and flags it uses, and closing a write txn
+ *	leaves its cursor array cleared.
+ * @param[in] env the environment
+ * @return the txn, or NULL if it could not be allocated.
+ */
+static MDB_txn *
+mdb_txn_alloc(MDB_env *env)
+{
+	MDB_txn *txn;
+
+#ifndef _WIN32
+	if (env->me_txn_pool) {
+		pthread_mutex_lock(&env->me_txn_mutex);
+		if ((txn = env->me_txn_pool) != NULL) {
+			env->me_txn_pool = txn->mt_child;
+			env->me_txn_pooled--;
+		}
+		pthread_mutex_unlock(&env->me_txn_mutex);
+		if (txn) {
+			memset(txn, 0, sizeof(MDB_txn));
+			return txn;
+		}
+	}
+#endif
+	txn = calloc(1, sizeof(MDB_txn) +
+		env->me_maxdbs * (sizeof(MDB_db)+sizeof(MDB_cursor *)+1));
+	if (!txn)
+		DPRINTF(("calloc: %s", strerror(ErrCode())));
+	return txn;
+}
+
+/** Free a finished txn, or keep it for re-use if it is a top-level one.
+ * @param[in] txn the transaction handle
+ */
+static void
+mdb_txn_free(MDB_txn *txn)
+{
+#ifndef _WIN32
+	MDB_env *env = txn->mt_env;
+
+	if (!txn->mt_parent && env->me_txn_pooled < MDB_TXN_POOL) {
+		pthread_mutex_lock(&env->me_txn_mutex);
+		if (env->me_txn_pooled < MDB_TXN_POOL) {
+			txn->mt_child = env->me_txn_pool;
+			env->me_txn_pool = txn;
+			env->me_txn_pooled++;
+			txn = NULL;
+		}
+		pthread_mutex_unlock(&env->me_txn_mutex);
+	}
+#endif
+	free(txn);
+}
+
 int
 mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 {
@@ -2309,34 +3470,41 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		}
 		tsize = sizeof(MDB_ntxn);
 	}
-	size = tsize + env->me_maxdbs * (sizeof(MDB_db)+1);
-	if (!(flags & MDB_RDONLY))
-		size += env->me_maxdbs * sizeof(MDB_cursor *);
-
-	if ((txn = calloc(1, size)) == NULL) {
-		DPRINTF(("calloc: %s", strerror(ErrCode())));
+	if (parent) {
+		size = tsize + env->me_maxdbs * (sizeof(MDB_db)+sizeof(MDB_cursor *)+1);
+		if ((txn = calloc(1, size)) == NULL) {
+			DPRINTF(("calloc: %s", strerror(ErrCode())));
+			return ENOMEM;
+		}
+	} else if ((txn = mdb_txn_alloc(env)) == NULL) {
 		return ENOMEM;
 	}
+	/* Read-only txns leave the cursor array unused, so that any txn
+	 * can take over a pooled one.
+	 */
 	txn->mt_dbs = (MDB_db *) ((char *)txn + tsize);
-	if (flags & MDB_RDONLY) {
+	txn->mt_dbflags = (unsigned char *)((MDB_cursor **)(txn->mt_dbs +
+		env->me_maxdbs) + env->me_maxdbs);
+	if (flags & MDB_RDONLY)
 		txn->mt_flags |= MDB_TXN_RDONLY;
-		txn->mt_dbflags = (unsigned char *)(txn->mt_dbs + env->me_maxdbs);
-	} else {
+	else
 		txn->mt_cursors = (MDB_cursor **)(txn->mt_dbs + env->me_maxdbs);
-		txn->mt_dbflags = (unsigned char *)(txn->mt_cursors + env->me_maxdbs);
-	}
 	txn->mt_env = env;
 
 	if (parent) {
 		unsigned int i;
-		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*MDB_IDL_UM_SIZE);
-		if (!txn->mt_u.dirty_list ||
+		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*(env->me_maxdirty + 1));
+		txn->mt_dirty_hash = calloc(DHASH_START + 1, sizeof(MDB_ID2));
+		if (!txn->mt_u.dirty_list || !txn->mt_dirty_hash ||
 			!(txn->mt_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)))
 		{
 			free(txn->mt_u.dirty_list);
+			free(txn->mt_dirty_hash);
 			free(txn);
 			return ENOMEM;
 		}
+		txn->mt_dirty_hash[0].mid = DHASH_START;
+		txn->mt_dirty_sorted = 0;
 		txn->mt_txnid = parent->mt_txnid;
 		txn->mt_dirty_room = parent->mt_dirty_room;
 		txn->mt_u.dirty_list[0].mid = 0;
@@ -2370,7 +3538,7 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		rc = mdb_txn_renew0(txn);
 	}
 	if (rc)
-		free(txn);
+		mdb_txn_free(txn);
 	else {
 		*ret = txn;
 		DPRINTF(("begin txn %"Z"u%c %p on mdbenv %p, root page %"Z"u",
@@ -2444,8 +3612,11 @@ mdb_txn_reset0(MDB_txn *txn, const char *act)
 
 		if (!(env->me_flags & MDB_WRITEMAP)) {
 			mdb_dlist_free(txn);
+		} else {
+			mdb_dhash_clear(txn);
 		}
 		mdb_midl_free(env->me_pghead);
+		mdb_pgext_reset(env);
 
 		if (txn->mt_parent) {
 			txn->mt_parent->mt_child = NULL;
@@ -2453,6 +3624,7 @@ mdb_txn_reset0(MDB_txn *txn, const char *act)
 			mdb_midl_free(txn->mt_free_pgs);
 			mdb_midl_free(txn->mt_spill_pgs);
 			free(txn->mt_u.dirty_list);
+			free(txn->mt_dirty_hash);
 			return;
 		}
 
@@ -2460,6 +3632,7 @@ mdb_txn_reset0(MDB_txn *txn, const char *act)
 			env->me_free_pgs = txn->mt_free_pgs;
 		env->me_pghead = NULL;
 		env->me_pglast = 0;
+		mdb_arena_reset(env);
 
 		env->me_txn = NULL;
 		/* The writer mutex was locked in mdb_txn_begin. */
@@ -2492,10 +3665,12 @@ mdb_txn_abort(MDB_txn *txn)
 
 	mdb_txn_reset0(txn, "abort");
 	/* Free reader slot tied to this txn (if MDB_NOTLS && writable FS) */
-	if ((txn->mt_flags & MDB_TXN_RDONLY) && txn->mt_u.reader)
+	if ((txn->mt_flags & MDB_TXN_RDONLY) && txn->mt_u.reader) {
+		txn->mt_env->me_rhint = txn->mt_u.reader - txn->mt_env->me_txns->mti_readers;
 		txn->mt_u.reader->mr_pid = 0;
+	}
 
-	free(txn);
+	mdb_txn_free(txn);
 }
 
 /** Save the freelist as of this transaction to the freeDB.
@@ -2657,33 +3832,302 @@ mdb_freelist_save(MDB_txn *txn)
 	return rc;
 }
 
+#ifdef MDB_USE_IO_URING
+/** @defgroup uring	io_uring page flush
+ *
+ *	With #MDB_IO_URING, #mdb_page_flush() queues one IORING_OP_WRITEV
+ *	per run of up to #MDB_COMMIT_PAGES contiguous pages instead of
+ *	writing them itself, and submits them together with the commit's
+ *	fdatasync. The fdatasync carries IOSQE_IO_DRAIN, so it starts once
+ *	every write before it has completed. A flush that needs more than
+ *	#MDB_URING_ENTRIES writes submits and reaps them in rounds.
+ *
+ *	The ring is set up with raw syscalls when the env is opened. If
+ *	that fails, e.g. because the kernel is too old or io_uring is
+ *	disabled, #MDB_IO_URING is cleared and pages are written as usual.
+ *	@{
+ */
+	/** Number of submission queue entries */
+#define MDB_URING_ENTRIES	128
+	/** Number of iovecs the queued writes can use */
+#define MDB_URING_IOVS	(MDB_URING_ENTRIES * MDB_COMMIT_PAGES)
+
+	/** An io_uring and the iovecs of the writes queued on it */
+struct MDB_uring {
+	int		mu_fd;
+	unsigned	mu_entries;		/**< size of the submission queue */
+	unsigned	*mu_sq_tail;
+	unsigned	*mu_sq_mask;
+	unsigned	*mu_sq_array;
+	unsigned	*mu_cq_head;
+	unsigned	*mu_cq_tail;
+	unsigned	*mu_cq_mask;
+	struct io_uring_sqe	*mu_sqes;
+	struct io_uring_cqe	*mu_cqes;
+	void	*mu_sq_map;
+	void	*mu_cq_map;
+	size_t	mu_sq_size;
+	size_t	mu_cq_size;
+	unsigned	mu_queued;		/**< SQEs filled in but not submitted */
+	unsigned	mu_pending;		/**< SQEs submitted but not reaped */
+	unsigned	mu_iov_used;	/**< iovecs in use by queued writes */
+	int		mu_rc;			/**< first error reaped, if any */
+	size_t	mu_ops;			/**< SQEs reaped, see #mdb_env_get_uring_ops() */
+	struct iovec	mu_iov[MDB_URING_IOVS];
+};
+
+static void
+mdb_uring_close(MDB_uring *u)
+{
+	if (u->mu_sqes)
+		munmap(u->mu_sqes, u->mu_entries * sizeof(struct io_uring_sqe));
+	if (u->mu_cq_map && u->mu_cq_map != u->mu_sq_map)
+		munmap(u->mu_cq_map, u->mu_cq_size);
+	if (u->mu_sq_map)
+		munmap(u->mu_sq_map, u->mu_sq_size);
+	close(u->mu_fd);
+	free(u);
+}
+
+/** Set up the io_uring of an env.
+ * @param[in] env the environment handle
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_uring_open(MDB_env *env)
+{
+	struct io_uring_params p;
+	MDB_uring *u;
+	char *sq, *cq;
+	int fd, rc;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(__NR_io_uring_setup, MDB_URING_ENTRIES, &p);
+	if (fd < 0)
+		return ErrCode();
+	if ((u = calloc(1, sizeof(MDB_uring))) == NULL) {
+		close(fd);
+		return ENOMEM;
+	}
+	u->mu_fd = fd;
+	u->mu_entries = p.sq_entries;
+	u->mu_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	u->mu_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->mu_cq_size > u->mu_sq_size)
+			u->mu_sq_size = u->mu_cq_size;
+		u->mu_cq_size = u->mu_sq_size;
+	}
+	u->mu_sq_map = mmap(NULL, u->mu_sq_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (u->mu_sq_map == MAP_FAILED) {
+		u->mu_sq_map = NULL;
+		goto fail;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		u->mu_cq_map = u->mu_sq_map;
+	} else {
+		u->mu_cq_map = mmap(NULL, u->mu_cq_size, PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (u->mu_cq_map == MAP_FAILED) {
+			u->mu_cq_map = NULL;
+			goto fail;
+		}
+	}
+	u->mu_sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+		PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (u->mu_sqes == MAP_FAILED) {
+		u->mu_sqes = NULL;
+		goto fail;
+	}
+	sq = u->mu_sq_map;
+	cq = u->mu_cq_map;
+	u->mu_sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	u->mu_sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	u->mu_sq_array = (unsigned *)(sq + p.sq_off.array);
+	u->mu_cq_head = (unsigned *)(cq + p.cq_off.head);
+	u->mu_cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	u->mu_cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	u->mu_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	env->me_uring = u;
+	return MDB_SUCCESS;
+
+fail:
+	rc = ErrCode();
+	mdb_uring_close(u);
+	return rc;
+}
+
+/** Fill in the next submission queue entry. The caller makes sure
+ *	there is room.
+ */
+static void
+mdb_uring_queue(MDB_uring *u, int op, HANDLE fd, void *addr, unsigned len,
+	off_t off, unsigned flags, unsigned fsync_flags, uint64_t data)
+{
+	unsigned tail = *u->mu_sq_tail, i = tail & *u->mu_sq_mask;
+	struct io_uring_sqe *sqe = &u->mu_sqes[i];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = op;
+	sqe->flags = flags;
+	sqe->fd = fd;
+	sqe->off = off;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	sqe->fsync_flags = fsync_flags;
+	sqe->user_data = data;
+	u->mu_sq_array[i] = i;
+	__atomic_store_n(u->mu_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	u->mu_queued++;
+}
+
+/** Submit the queued entries and reap completions.
+ *	The user_data of a write is its size, so short writes show up as EIO.
+ * @param[in] u the ring
+ * @param[in] wait wait until everything submitted has completed
+ * @return 0 on success, non-zero if the submission failed. Errors of
+ *	the operations themselves are kept in mu_rc.
+ */
+static int
+mdb_uring_submit(MDB_uring *u, int wait)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head, tail;
+	int rc;
+
+	do {
+		rc = syscall(__NR_io_uring_enter, u->mu_fd, u->mu_queued,
+			wait ? u->mu_queued + u->mu_pending : 0,
+			wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (rc < 0) {
+			if ((rc = ErrCode()) == EINTR)
+				continue;
+			return rc;
+		}
+		u->mu_queued -= rc;
+		u->mu_pending += rc;
+
+		head = *u->mu_cq_head;
+		tail = __atomic_load_n(u->mu_cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			cqe = &u->mu_cqes[head & *u->mu_cq_mask];
+			if (!u->mu_rc) {
+				if (cqe->res < 0)
+					u->mu_rc = -cqe->res;
+				else if ((uint64_t)cqe->res != cqe->user_data)
+					u->mu_rc = EIO;
+			}
+			u->mu_pending--;
+			__atomic_fetch_add(&u->mu_ops, 1, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(u->mu_cq_head, head, __ATOMIC_RELEASE);
+	} while (wait && (u->mu_queued || u->mu_pending));
+	return MDB_SUCCESS;
+}
+
+/** Queue a write of n iovecs, which the caller has filled in at *iov.
+ *	Makes room for another run of pages and an fdatasync, and points
+ *	*iov at the iovecs for the next run.
+ * @return size, or -1 with errno set, like pwritev().
+ */
+static ssize_t
+mdb_uring_writev(MDB_uring *u, HANDLE fd, struct iovec **iov, int n,
+	off_t pos, size_t size)
+{
+	int rc;
+
+	mdb_uring_queue(u, IORING_OP_WRITEV, fd, *iov, n, pos, 0, 0, size);
+	u->mu_iov_used += n;
+	if (u->mu_iov_used + MDB_COMMIT_PAGES > MDB_URING_IOVS ||
+		u->mu_queued + u->mu_pending + 2 > u->mu_entries) {
+		if ((rc = mdb_uring_submit(u, 1)) || (rc = u->mu_rc)) {
+			errno = rc;
+			return -1;
+		}
+		u->mu_iov_used = 0;
+	}
+	*iov = u->mu_iov + u->mu_iov_used;
+	return size;
+}
+
+/** Queue an fdatasync behind the writes if sync is set, submit
+ *	everything and wait for it to complete.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_uring_finish(MDB_uring *u, HANDLE fd, int sync)
+{
+	int rc;
+
+	if (sync)
+		mdb_uring_queue(u, IORING_OP_FSYNC, fd, NULL, 0, 0,
+			IOSQE_IO_DRAIN, IORING_FSYNC_DATASYNC, 0);
+	rc = mdb_uring_submit(u, 1);
+	if (!rc)
+		rc = u->mu_rc;
+	u->mu_rc = 0;
+	u->mu_iov_used = 0;
+	return rc;
+}
+/** @} */
+#endif	/* MDB_USE_IO_URING */
+
 /** Flush (some) dirty pages to the map, after clearing their dirty flag.
  * @param[in] txn the transaction that's being committed
  * @param[in] keep number of initial pages in dirty_list to keep dirty.
+ * @param[in] sync also sync the data file, as #mdb_env_sync() would.
  * @return 0 on success, non-zero on failure.
  */
 static int
-mdb_page_flush(MDB_txn *txn, int keep)
+mdb_page_flush(MDB_txn *txn, int keep, int sync)
 {
 	MDB_env		*env = txn->mt_env;
 	MDB_ID2L	dl = txn->mt_u.dirty_list;
 	unsigned	psize = env->me_psize, j;
-	int			i, pagecount = dl[0].mid, rc;
-	size_t		size = 0, pos = 0;
+	int			i, pagecount = dl[0].mid, rc, synced = 0;
+	size_t		size = 0, pos = 0, written = 0;
 	pgno_t		pgno = 0;
 	MDB_page	*dp = NULL;
 #ifdef _WIN32
 	OVERLAPPED	ov;
 #else
-	struct iovec iov[MDB_COMMIT_PAGES];
+	struct iovec iovs[MDB_COMMIT_PAGES], *iov = iovs;
 	ssize_t		wpos = 0, wsize = 0, wres;
 	size_t		next_pos = 1; /* impossible pos, so pos != next_pos */
 	int			n = 0;
 #endif
+#ifdef MDB_USE_IO_URING
+	MDB_uring	*ring = env->me_uring;
+
+	if (ring)
+		iov = ring->mu_iov;
+#endif
 
 	j = i = keep;
 
+	/* Write pages in order, and rebuild the hash table from what is left */
+	mdb_dlist_sort(txn);
+	mdb_dhash_clear(txn);
+
 	if (env->me_flags & MDB_WRITEMAP) {
+		/* Only sync the pages of this txn, unless earlier writes
+		 * are still unsynced or the sync is asynchronous anyway.
+		 * This process only knows about its own writes, so after
+		 * another process's commit the whole map is synced. Pages
+		 * spilled earlier in this txn are off the dirty list and
+		 * only counted in #me_flushed, so they need it too.
+		 */
+		size_t	ranges[MDB_MSYNC_RANGES][2], os_mask = env->me_os_psize - 1;
+		int		nranges = -1, r;
+
+		if (sync && !(env->me_flags & (MDB_NOSYNC|MDB_MAPASYNC))) {
+			LOCK_SYNC(env);
+			if (env->me_synced == env->me_written && !env->me_flushed &&
+				env->me_written_txnid == txn->mt_txnid - 1)
+				nranges = 0;
+			UNLOCK_SYNC(env);
+		}
 		/* Clear dirty flags */
 		while (++i <= pagecount) {
 			dp = dl[i].mptr;
@@ -2694,6 +4138,35 @@ mdb_page_flush(MDB_txn *txn, int keep)
 				continue;
 			}
 			dp->mp_flags &= ~P_DIRTY;
+			size = IS_OVERFLOW(dp) ? psize * dp->mp_pages : psize;
+			written += size;
+			if (nranges < 0)
+				continue;
+			/* The list is sorted, so ranges only grow upwards */
+			pos = (dl[i].mid * psize) & ~os_mask;
+			size = (dl[i].mid * psize + size + os_mask) & ~os_mask;
+			if (nranges && pos <= ranges[nranges-1][1] + MDB_MSYNC_GAP) {
+				if (size > ranges[nranges-1][1])
+					ranges[nranges-1][1] = size;
+			} else if (nranges < MDB_MSYNC_RANGES) {
+				ranges[nranges][0] = pos;
+				ranges[nranges++][1] = size;
+			} else {
+				ranges[0][1] = size;
+				nranges = 1;
+			}
+		}
+		if (nranges >= 0) {
+			for (r = 0; r < nranges; r++) {
+				if (MDB_MSYNC(env->me_map + ranges[r][0],
+					ranges[r][1] - ranges[r][0], MS_SYNC))
+					return ErrCode();
+			}
+#ifdef _WIN32
+			if (nranges && MDB_FDATASYNC(env->me_fd))
+				return ErrCode();
+#endif
+			synced = 1;
 		}
 		goto done;
 	}
@@ -2734,11 +4207,17 @@ mdb_page_flush(MDB_txn *txn, int keep)
 			DPRINTF(("WriteFile: %d", rc));
 			return rc;
 		}
+		written += size;
 #else
 		/* Write up to MDB_COMMIT_PAGES dirty pages at a time. */
 		if (pos!=next_pos || n==MDB_COMMIT_PAGES || wsize+size>MAX_WRITE) {
 			if (n) {
 				/* Write previous page(s) */
+#ifdef MDB_USE_IO_URING
+				if (ring)
+					wres = mdb_uring_writev(ring, env->me_fd, &iov, n, wpos, wsize);
+				else
+#endif
 #ifdef MDB_USE_PWRITEV
 				wres = pwritev(env->me_fd, iov, n, wpos);
 #else
@@ -2761,8 +4240,14 @@ mdb_page_flush(MDB_txn *txn, int keep)
 						rc = EIO; /* TODO: Use which error code? */
 						DPUTS("short write, filesystem full?");
 					}
+#ifdef MDB_USE_IO_URING
+					/* Don't let the kernel write from freed pages */
+					if (ring)
+						mdb_uring_finish(ring, env->me_fd, 0);
+#endif
 					return rc;
 				}
+				written += wsize;
 				n = 0;
 			}
 			if (i > pagecount)
@@ -2779,6 +4264,17 @@ mdb_page_flush(MDB_txn *txn, int keep)
 #endif	/* _WIN32 */
 	}
 
+#ifdef MDB_USE_IO_URING
+	if (ring) {
+		/* The fdatasync goes in the same submission as the writes */
+		synced = sync && !(env->me_flags & MDB_NOSYNC);
+		if ((rc = mdb_uring_finish(ring, env->me_fd, synced)) != MDB_SUCCESS) {
+			DPRINTF(("io_uring write error: %s", strerror(rc)));
+			return rc;
+		}
+	}
+#endif
+
 	for (i = keep; ++i <= pagecount; ) {
 		dp = dl[i].mptr;
 		/* This is a page we skipped above */
@@ -2791,22 +4287,43 @@ mdb_page_flush(MDB_txn *txn, int keep)
 	}
 
 done:
+	env->me_flushed += written;
+	if (synced) {
+		/* The data sync covered the commits counted so far */
+		LOCK_SYNC(env);
+		env->me_synced = env->me_written;
+		UNLOCK_SYNC(env);
+	}
 	i--;
 	txn->mt_dirty_room += i - j;
 	dl[0].mid = j;
+	txn->mt_dirty_sorted = j;
+	for (i = 1; i <= j; i++)
+		mdb_dhash_put(txn->mt_dirty_hash, &dl[i]);
+	if (sync && !synced)
+		return mdb_env_sync(env, 0);
 	return MDB_SUCCESS;
 }
 
-int
-mdb_txn_commit(MDB_txn *txn)
+/** Commit a transaction, leaving it pending in an #MDB_PIPELINE env.
+ * @param[in] txn the transaction to commit
+ * @param[out] txnid the commit to wait for with #mdb_env_sync_txn(),
+ *	or 0 if there is none
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_txn_commit0(MDB_txn *txn, txnid_t *txnid)
 {
 	int		rc;
 	unsigned int i;
 	MDB_env	*env;
+	MDB_meta	meta;
 
 	assert(txn != NULL);
 	assert(txn->mt_env != NULL);
 
+	*txnid = 0;
+
 	if (txn->mt_child) {
 		rc = mdb_txn_commit(txn->mt_child);
 		txn->mt_child = NULL;
@@ -2817,6 +4334,7 @@ mdb_txn_commit(MDB_txn *txn)
 	env = txn->mt_env;
 
 	if (F_ISSET(txn->mt_flags, MDB_TXN_RDONLY)) {
+		*txnid = txn->mt_txnid;
 		mdb_dbis_update(txn, 1);
 		txn->mt_numdbs = 2; /* so txn_abort() doesn't close any new handles */
 		mdb_txn_abort(txn);
@@ -2838,8 +4356,8 @@ mdb_txn_commit(MDB_txn *txn)
 		unsigned x, y, len, ps_len;
 
 		/* Append our free list to parent's */
-		rc = mdb_midl_append_list(&parent->mt_free_pgs, txn->mt_free_pgs);
-		if (rc)
+		if ((rc = mdb_dhash_need(parent, txn->mt_u.dirty_list[0].mid)) ||
+			(rc = mdb_midl_append_list(&parent->mt_free_pgs, txn->mt_free_pgs)))
 			goto fail;
 		mdb_midl_free(txn->mt_free_pgs);
 		/* Failures after this must either undo the changes
@@ -2863,6 +4381,8 @@ mdb_txn_commit(MDB_txn *txn)
 			parent->mt_dbflags[i] = txn->mt_dbflags[i] | x;
 		}
 
+		mdb_dlist_sort(parent);
+		mdb_dlist_sort(txn);
 		dst = parent->mt_u.dirty_list;
 		src = txn->mt_u.dirty_list;
 		/* Remove anything in our dirty list from parent's spill list */
@@ -2886,6 +4406,29 @@ mdb_txn_commit(MDB_txn *txn)
 			pspill[0] = y;
 		}
 
+		/* Remove anything in our spill list from parent's dirty list.
+		 * These are our copies of parent's dirty pages, so they never
+		 * took any of our dirty room.
+		 */
+		if (txn->mt_spill_pgs && txn->mt_spill_pgs[0]) {
+			for (i=1; i<=txn->mt_spill_pgs[0]; i++) {
+				MDB_ID pn = txn->mt_spill_pgs[i];
+				if (pn & 1)
+					continue;	/* deleted spillpg */
+				pn >>= 1;
+				y = mdb_mid2l_search(dst, pn);
+				if (y <= dst[0].mid && dst[y].mid == pn) {
+					mdb_dpage_free(env, dst[y].mptr);
+					mdb_dhash_del(parent->mt_dirty_hash, pn);
+					while (y < dst[0].mid) {
+						dst[y] = dst[y+1];
+						y++;
+					}
+					dst[0].mid--;
+				}
+			}
+		}
+
 		/* Find len = length of merging our dirty list with parent's */
 		x = dst[0].mid;
 		dst[0].mid = 0;		/* simplify loops */
@@ -2902,7 +4445,7 @@ mdb_txn_commit(MDB_txn *txn)
 				}
 			}
 		} else { /* Simplify the above for single-ancestor case */
-			len = MDB_IDL_UM_MAX - txn->mt_dirty_room;
+			len = env->me_maxdirty - txn->mt_dirty_room;
 		}
 		/* Merge our dirty list with parent's */
 		y = src[0].mid;
@@ -2911,11 +4454,15 @@ mdb_txn_commit(MDB_txn *txn)
 			while (yp < dst[x].mid)
 				dst[i--] = dst[x--];
 			if (yp == dst[x].mid)
-				free(dst[x--].mptr);
+				mdb_dpage_free(env, dst[x--].mptr);
 		}
 		assert(i == x);
 		dst[0].mid = len;
+		parent->mt_dirty_sorted = len;
+		for (y = src[0].mid; y; y--)
+			mdb_dhash_put(parent->mt_dirty_hash, &src[y]);
 		free(txn->mt_u.dirty_list);
+		free(txn->mt_dirty_hash);
 		parent->mt_dirty_room = txn->mt_dirty_room;
 		if (txn->mt_spill_pgs) {
 			if (parent->mt_spill_pgs) {
@@ -2944,6 +4491,8 @@ mdb_txn_commit(MDB_txn *txn)
 
 	mdb_cursors_close(txn, 0);
 
+	/* Nothing to write, but later commits are ordered after this one's base */
+	*txnid = txn->mt_txnid - 1;
 	if (!txn->mt_u.dirty_list[0].mid &&
 		!(txn->mt_flags & (MDB_TXN_DIRTY|MDB_TXN_SPILLS)))
 		goto done;
@@ -2975,6 +4524,7 @@ mdb_txn_commit(MDB_txn *txn)
 
 	mdb_midl_free(env->me_pghead);
 	env->me_pghead = NULL;
+	mdb_pgext_reset(env);
 	if (mdb_midl_shrink(&txn->mt_free_pgs))
 		env->me_free_pgs = txn->mt_free_pgs;
 
@@ -2982,19 +4532,35 @@ mdb_txn_commit(MDB_txn *txn)
 	mdb_audit(txn);
 #endif
 
-	if ((rc = mdb_page_flush(txn, 0)) ||
-		(rc = mdb_env_sync(env, 0)) ||
-		(rc = mdb_env_write_meta(txn)))
+	mdb_txn_meta(txn, &meta);
+	*txnid = txn->mt_txnid;
+#ifndef _WIN32
+	if (env->me_flags & MDB_PIPELINE) {
+		/* Sync and write the meta later, without the write lock */
+		if ((rc = mdb_page_flush(txn, 0, 0)) ||
+			(rc = mdb_env_pend(env, &meta)))
+			goto fail;
+		mdb_env_written(env, 0);
+		env->me_written_txnid = txn->mt_txnid;
+		goto done;
+	}
+#endif
+	if ((rc = mdb_page_flush(txn, 0, 1)) ||
+		(rc = mdb_env_write_meta(env, &meta)))
 		goto fail;
+	mdb_env_written(env, !(env->me_flags & (MDB_NOSYNC|MDB_NOMETASYNC)) &&
+		(env->me_flags & (MDB_WRITEMAP|MDB_MAPASYNC)) != (MDB_WRITEMAP|MDB_MAPASYNC));
+	env->me_written_txnid = txn->mt_txnid;
 
 done:
 	env->me_pglast = 0;
+	mdb_arena_reset(env);
 	env->me_txn = NULL;
 	mdb_dbis_update(txn, 1);
 
 	if (env->me_txns)
 		UNLOCK_MUTEX_W(env);
-	free(txn);
+	mdb_txn_free(txn);
 
 	return MDB_SUCCESS;
 
@@ -3003,6 +4569,35 @@ fail:
 	return rc;
 }
 
+int
+mdb_txn_commit(MDB_txn *txn)
+{
+	MDB_env	*env;
+	txnid_t	txnid;
+	int		rc;
+
+	assert(txn != NULL);
+	env = txn->mt_env;
+	rc = mdb_txn_commit0(txn, &txnid);
+	if (rc == MDB_SUCCESS && txnid)
+		rc = mdb_env_sync_txn(env, txnid);
+	return rc;
+}
+
+int
+mdb_txn_commit_async(MDB_txn *txn, size_t *txnid)
+{
+	txnid_t	id;
+	int		rc;
+
+	if (!txn || !txnid)
+		return EINVAL;
+	rc = mdb_txn_commit0(txn, &id);
+	if (rc == MDB_SUCCESS)
+		*txnid = id;
+	return rc;
+}
+
 /** Read the environment parameters of a DB environment before
  * mapping it into memory.
  * @param[in] env the environment handle
@@ -3055,7 +4650,7 @@ mdb_env_read_header(MDB_env *env, MDB_meta *meta)
 			return MDB_INVALID;
 		}
 
-		if (m->mm_version != MDB_DATA_VERSION) {
+		if (m->mm_version != MDB_DATA_VERSION && m->mm_version != MDB_DATA_VERSION_PREFIX) {
 			DPRINTF(("database is version %u, expected version %u",
 				m->mm_version, MDB_DATA_VERSION));
 			return MDB_VERSION_MISMATCH;
@@ -3127,14 +4722,29 @@ mdb_env_init_meta(MDB_env *env, MDB_meta *meta)
 	return rc;
 }
 
-/** Update the environment info to commit a transaction.
+/** Fill in the meta page fields that a commit of txn changes.
  * @param[in] txn the transaction that's being committed
+ * @param[out] meta the meta page to fill in
+ */
+static void
+mdb_txn_meta(MDB_txn *txn, MDB_meta *meta)
+{
+	meta->mm_version = (txn->mt_flags & MDB_TXN_PREFIXKEY) ?
+		MDB_DATA_VERSION_PREFIX : MDB_DATA_VERSION;
+	meta->mm_dbs[0] = txn->mt_dbs[0];
+	meta->mm_dbs[1] = txn->mt_dbs[1];
+	meta->mm_last_pg = txn->mt_next_pgno - 1;
+	meta->mm_txnid = txn->mt_txnid;
+}
+
+/** Update the environment info to commit a transaction.
+ * @param[in] env the environment handle
+ * @param[in] src the committed meta, filled in by #mdb_txn_meta()
  * @return 0 on success, non-zero on failure.
  */
 static int
-mdb_env_write_meta(MDB_txn *txn)
+mdb_env_write_meta(MDB_env *env, const MDB_meta *src)
 {
-	MDB_env *env;
 	MDB_meta	meta, metab, *mp;
 	off_t off;
 	int rc, len, toggle;
@@ -3146,24 +4756,24 @@ mdb_env_write_meta(MDB_txn *txn)
 	int r2;
 #endif
 
-	assert(txn != NULL);
-	assert(txn->mt_env != NULL);
+	assert(env != NULL);
+	assert(src != NULL);
 
-	toggle = txn->mt_txnid & 1;
+	toggle = src->mm_txnid & 1;
 	DPRINTF(("writing meta page %d for root page %"Z"u",
-		toggle, txn->mt_dbs[MAIN_DBI].md_root));
+		toggle, src->mm_dbs[MAIN_DBI].md_root));
 
-	env = txn->mt_env;
 	mp = env->me_metas[toggle];
 
 	if (env->me_flags & MDB_WRITEMAP) {
 		/* Persist any increases of mapsize config */
 		if (env->me_mapsize > mp->mm_mapsize)
 			mp->mm_mapsize = env->me_mapsize;
-		mp->mm_dbs[0] = txn->mt_dbs[0];
-		mp->mm_dbs[1] = txn->mt_dbs[1];
-		mp->mm_last_pg = txn->mt_next_pgno - 1;
-		mp->mm_txnid = txn->mt_txnid;
+		mp->mm_version = src->mm_version;
+		mp->mm_dbs[0] = src->mm_dbs[0];
+		mp->mm_dbs[1] = src->mm_dbs[1];
+		mp->mm_last_pg = src->mm_last_pg;
+		mp->mm_txnid = src->mm_txnid;
 		if (!(env->me_flags & (MDB_NOMETASYNC|MDB_NOSYNC))) {
 			unsigned meta_size = env->me_psize;
 			rc = (env->me_flags & MDB_MAPASYNC) ? MS_ASYNC : MS_SYNC;
@@ -3185,9 +4795,17 @@ mdb_env_write_meta(MDB_txn *txn)
 	}
 	metab.mm_txnid = env->me_metas[toggle]->mm_txnid;
 	metab.mm_last_pg = env->me_metas[toggle]->mm_last_pg;
+	metab.mm_version = mp->mm_version;
 
 	ptr = (char *)&meta;
-	if (env->me_mapsize > mp->mm_mapsize) {
+	if (src->mm_version != mp->mm_version) {
+		/* Record the new format version, see #MDB_DATA_VERSION_PREFIX */
+		meta.mm_version = src->mm_version;
+		meta.mm_address = mp->mm_address;
+		meta.mm_mapsize = env->me_mapsize > mp->mm_mapsize ?
+			env->me_mapsize : mp->mm_mapsize;
+		off = offsetof(MDB_meta, mm_version);
+	} else if (env->me_mapsize > mp->mm_mapsize) {
 		/* Persist any increases of mapsize config */
 		meta.mm_mapsize = env->me_mapsize;
 		off = offsetof(MDB_meta, mm_mapsize);
@@ -3197,10 +4815,10 @@ mdb_env_write_meta(MDB_txn *txn)
 	len = sizeof(MDB_meta) - off;
 
 	ptr += off;
-	meta.mm_dbs[0] = txn->mt_dbs[0];
-	meta.mm_dbs[1] = txn->mt_dbs[1];
-	meta.mm_last_pg = txn->mt_next_pgno - 1;
-	meta.mm_txnid = txn->mt_txnid;
+	meta.mm_dbs[0] = src->mm_dbs[0];
+	meta.mm_dbs[1] = src->mm_dbs[1];
+	meta.mm_last_pg = src->mm_last_pg;
+	meta.mm_txnid = src->mm_txnid;
 
 	if (toggle)
 		off += env->me_psize;
@@ -3226,6 +4844,7 @@ mdb_env_write_meta(MDB_txn *txn)
 		 * Write some old data back, to prevent it from being used.
 		 * Use the non-SYNC fd; we know it will fail anyway.
 		 */
+		meta.mm_version = metab.mm_version;
 		meta.mm_last_pg = metab.mm_last_pg;
 		meta.mm_txnid = metab.mm_txnid;
 #ifdef _WIN32
@@ -3242,13 +4861,13 @@ fail:
 	}
 done:
 	/* Memory ordering issues are irrelevant; since the entire writer
-	 * is wrapped by wmutex, all of these changes will become visible
-	 * after the wmutex is unlocked. Since the DB is multi-version,
-	 * readers will get consistent data regardless of how fresh or
-	 * how stale their view of these values is.
+	 * is wrapped by wmutex (or me_sync_mutex, for #MDB_PIPELINE), all
+	 * of these changes will become visible after it is unlocked. Since
+	 * the DB is multi-version, readers will get consistent data
+	 * regardless of how fresh or how stale their view of these values is.
 	 */
 	if (env->me_txns)
-		env->me_txns->mti_txnid = txn->mt_txnid;
+		env->me_txns->mti_txnid = src->mm_txnid;
 
 	return MDB_SUCCESS;
 }
@@ -3271,8 +4890,12 @@ mdb_env_create(MDB_env **env)
 	e = calloc(1, sizeof(MDB_env));
 	if (!e)
 		return ENOMEM;
+#ifdef MDB_USE_SIMD
+	pthread_once(&mdb_count_once, mdb_count_init);
+#endif
 
 	e->me_maxreaders = DEFAULT_READERS;
+	e->me_maxdirty = MDB_IDL_UM_MAX;
 	e->me_maxdbs = e->me_numdbs = 2;
 	e->me_fd = INVALID_HANDLE_VALUE;
 	e->me_lfd = INVALID_HANDLE_VALUE;
@@ -3280,6 +4903,11 @@ mdb_env_create(MDB_env **env)
 #ifdef MDB_USE_POSIX_SEM
 	e->me_rmutex = SEM_FAILED;
 	e->me_wmutex = SEM_FAILED;
+#endif
+#ifndef _WIN32
+	pthread_mutex_init(&e->me_sync_mutex, NULL);
+	pthread_cond_init(&e->me_sync_cond, NULL);
+	pthread_mutex_init(&e->me_txn_mutex, NULL);
 #endif
 	e->me_pid = getpid();
 	GET_PAGESIZE(e->me_os_psize);
@@ -3396,6 +5024,16 @@ mdb_env_set_mapsize(MDB_env *env, size_t size)
 	return MDB_SUCCESS;
 }
 
+int
+mdb_env_set_pagesize(MDB_env *env, unsigned int size)
+{
+	if (!env || env->me_map || size < MIN_PAGESIZE || size > MAX_PAGESIZE ||
+		(size & (size - 1)))
+		return EINVAL;
+	env->me_psize = size;
+	return MDB_SUCCESS;
+}
+
 int
 mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs)
 {
@@ -3423,6 +5061,48 @@ mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers)
 	return MDB_SUCCESS;
 }
 
+int
+mdb_env_set_maxdirty(MDB_env *env, unsigned int pages)
+{
+	if (env->me_map || pages < MDB_MINDIRTY || pages > MDB_MAXDIRTY)
+		return EINVAL;
+	env->me_maxdirty = pages;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_env_get_maxdirty(MDB_env *env, unsigned int *pages)
+{
+	if (!env || !pages)
+		return EINVAL;
+	*pages = env->me_maxdirty;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_env_get_unsynced(MDB_env *env, size_t *bytes)
+{
+	if (!env || !bytes)
+		return EINVAL;
+	LOCK_SYNC(env);
+	*bytes = env->me_written - env->me_synced;
+	UNLOCK_SYNC(env);
+	return MDB_SUCCESS;
+}
+
+int
+mdb_env_get_uring_ops(MDB_env *env, size_t *ops)
+{
+	if (!env || !ops)
+		return EINVAL;
+	*ops = 0;
+#ifdef MDB_USE_IO_URING
+	if (env->me_uring)
+		*ops = __atomic_load_n(&env->me_uring->mu_ops, __ATOMIC_RELAXED);
+#endif
+	return MDB_SUCCESS;
+}
+
 /** Further setup required for opening an MDB environment
  */
 static int
@@ -3448,9 +5128,12 @@ mdb_env_open2(MDB_env *env)
 			return i;
 		DPUTS("new mdbenv");
 		newenv = 1;
-		env->me_psize = env->me_os_psize;
-		if (env->me_psize > MAX_PAGESIZE)
-			env->me_psize = MAX_PAGESIZE;
+		/* Use the size from #mdb_env_set_pagesize(), if any */
+		if (!env->me_psize) {
+			env->me_psize = env->me_os_psize;
+			if (env->me_psize > MAX_PAGESIZE)
+				env->me_psize = MAX_PAGESIZE;
+		}
 	} else {
 		env->me_psize = meta.mm_psize;
 	}
@@ -3483,7 +5166,17 @@ mdb_env_open2(MDB_env *env)
 		}
 	}
 	env->me_maxfree_1pg = (env->me_psize - PAGEHDRSZ) / sizeof(pgno_t) - 1;
-	env->me_nodemax = (env->me_psize - PAGEHDRSZ) / MDB_MINKEYS;
+	/* Leave room for the index slot, so #MDB_MINKEYS nodes of this size fit */
+	env->me_nodemax = (((env->me_psize - PAGEHDRSZ) / MDB_MINKEYS) & -2) - sizeof(indx_t);
+	/* Nodes of this size go to overflow pages, which subDB records can't */
+	env->me_maxkey = env->me_nodemax - (NODESIZE + sizeof(MDB_db)) - 1;
+	i = ((env->me_psize - PAGEHDRSZ) / MDB_MINBRANCHKEYS & -2) - sizeof(indx_t) - NODESIZE - 1;
+	if (env->me_maxkey > (unsigned int)i)
+		env->me_maxkey = i;
+#if MDB_MAXKEYSIZE
+	if (env->me_maxkey > MDB_MAXKEYSIZE)
+		env->me_maxkey = MDB_MAXKEYSIZE;
+#endif
 
 	env->me_maxpg = env->me_mapsize / env->me_psize;
 #if MDB_DEBUG
@@ -3934,6 +5627,8 @@ mdb_env_setup_locks(MDB_env *env, char *lpath, int mode, int *excl)
 		env->me_txns->mti_format = MDB_LOCK_FORMAT;
 		env->me_txns->mti_txnid = 0;
 		env->me_txns->mti_numreaders = 0;
+		env->me_txns->mti_pending = 0;
+		env->me_txns->mti_pending_pid = 0;
 
 	} else {
 		if (env->me_txns->mti_magic != MDB_MAGIC) {
@@ -3983,7 +5678,7 @@ fail:
 	 */
 #define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC|MDB_NOMEMINIT)
 #define	CHANGELESS	(MDB_FIXEDMAP|MDB_NOSUBDIR|MDB_RDONLY|MDB_WRITEMAP| \
-	MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD)
+	MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD|MDB_PIPELINE|MDB_IO_URING)
 
 int
 mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode)
@@ -3993,6 +5688,12 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 
 	if (env->me_fd!=INVALID_HANDLE_VALUE || (flags & ~(CHANGEABLE|CHANGELESS)))
 		return EINVAL;
+#ifdef _WIN32
+	if (flags & MDB_PIPELINE)
+		return EINVAL;
+#endif
+	if ((flags & (MDB_PIPELINE|MDB_WRITEMAP)) == (MDB_PIPELINE|MDB_WRITEMAP))
+		return EINVAL;
 
 	len = strlen(path);
 	if (flags & MDB_NOSUBDIR) {
@@ -4016,12 +5717,17 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 	rc = MDB_SUCCESS;
 	flags |= env->me_flags;
 	if (flags & MDB_RDONLY) {
-		/* silently ignore WRITEMAP when we're only getting read access */
-		flags &= ~MDB_WRITEMAP;
+		/* silently ignore WRITEMAP and PIPELINE when we're only getting read access */
+		flags &= ~(MDB_WRITEMAP|MDB_PIPELINE);
 	} else {
 		if (!((env->me_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)) &&
-			  (env->me_dirty_list = calloc(MDB_IDL_UM_SIZE, sizeof(MDB_ID2)))))
+			  (env->me_dirty_list = calloc(env->me_maxdirty + 1, sizeof(MDB_ID2))) &&
+			  (env->me_dirty_hash = calloc(DHASH_START + 1, sizeof(MDB_ID2)))))
 			rc = ENOMEM;
+		else
+			env->me_dirty_hash[0].mid = DHASH_START;
+		if (!rc && env->me_arena_size && !(flags & MDB_WRITEMAP))
+			rc = mdb_arena_open(env);
 	}
 	env->me_flags = flags |= MDB_ENV_ACTIVE;
 	if (rc)
@@ -4093,6 +5799,13 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 				goto leave;
 			}
 		}
+#ifdef MDB_USE_IO_URING
+		if ((flags & MDB_IO_URING) && !(flags & (MDB_RDONLY|MDB_WRITEMAP)))
+			(void) mdb_uring_open(env);
+		if (!env->me_uring)
+#endif
+			/* Without a ring, pages are written as usual */
+			env->me_flags &= ~MDB_IO_URING;
 		DPRINTF(("opened dbenv %p", (void *) env));
 		if (excl > 0) {
 			rc = mdb_env_share_locks(env, &excl);
@@ -4100,7 +5813,8 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 				goto leave;
 		}
 		if (!((flags & MDB_RDONLY) ||
-			  (env->me_pbuf = calloc(1, env->me_psize))))
+			  ((env->me_pbuf = calloc(1, env->me_psize)) &&
+			   (env->me_kbuf = malloc(2 * ENV_MAXKEY(env))))))
 			rc = ENOMEM;
 	}
 
@@ -4116,20 +5830,42 @@ leave:
 static void
 mdb_env_close0(MDB_env *env, int excl)
 {
+#ifndef _WIN32
+	MDB_txn *txn;
+#endif
 	int i;
 
 	if (!(env->me_flags & MDB_ENV_ACTIVE))
 		return;
 
+#ifndef _WIN32
+	/* Make pending commits durable while the map is still there */
+	if (env->me_pending_txnid && !(env->me_flags & MDB_FATAL_ERROR))
+		(void) mdb_env_sync_txn(env, env->me_pending_txnid);
+	env->me_pending_txnid = 0;
+	env->me_pend_locked = 0;
+	env->me_sync_rc = 0;
+	while ((txn = env->me_txn_pool) != NULL) {
+		env->me_txn_pool = txn->mt_child;
+		free(txn);
+	}
+	env->me_txn_pooled = 0;
+#endif
+
 	/* Doing this here since me_dbxs may not exist during mdb_env_close */
 	for (i = env->me_maxdbs; --i > MAIN_DBI; )
 		free(env->me_dbxs[i].md_name.mv_data);
 
 	free(env->me_pbuf);
+	free(env->me_kbuf);
 	free(env->me_dbflags);
 	free(env->me_dbxs);
 	free(env->me_path);
 	free(env->me_dirty_list);
+	free(env->me_dirty_hash);
+	mdb_arena_close(env);
+	free(env->me_pgext[0]);
+	free(env->me_pgext[1]);
 	mdb_midl_free(env->me_free_pgs);
 
 	if (env->me_flags & MDB_ENV_TXKEY) {
@@ -4145,6 +5881,12 @@ mdb_env_close0(MDB_env *env, int excl)
 #endif
 	}
 
+#ifdef MDB_USE_IO_URING
+	if (env->me_uring) {
+		mdb_uring_close(env->me_uring);
+		env->me_uring = NULL;
+	}
+#endif
 	if (env->me_map) {
 		munmap(env->me_map, env->me_mapsize);
 	}
@@ -4363,6 +6105,11 @@ mdb_env_close(MDB_env *env)
 	}
 
 	mdb_env_close0(env, 0);
+#ifndef _WIN32
+	pthread_cond_destroy(&env->me_sync_cond);
+	pthread_mutex_destroy(&env->me_sync_mutex);
+	pthread_mutex_destroy(&env->me_txn_mutex);
+#endif
 	free(env);
 }
 
@@ -4440,13 +6187,525 @@ mdb_cmp_memnr(const MDB_val *a, const MDB_val *b)
 		len_diff = 1;
 	}
 
-	while (p1 > p1_lim) {
-		diff = *--p1 - *--p2;
-		if (diff)
-			return diff;
+	while (p1 > p1_lim) {
+		diff = *--p1 - *--p2;
+		if (diff)
+			return diff;
+	}
+	return len_diff<0 ? -1 : len_diff;
+}
+
+/** Compare a key with the key prefix of a #P_PREFIX page.
+ * Keys on these pages sort byte by byte, so a key that doesn't
+ * start with the prefix sorts before or after all of the page's nodes.
+ * @param[in] env The environment handle.
+ * @param[in] mp The page to compare with.
+ * @param[in] key The key to compare.
+ * @param[out] rest Set to the part of \b key after the prefix, if it matched.
+ * @return < 0 or > 0 if the key sorts before or after all nodes of
+ * the page, 0 if it starts with the prefix.
+ */
+static int
+mdb_prefix_cmp(MDB_env *env, MDB_page *mp, MDB_val *key, MDB_val *rest)
+{
+	unsigned int plen = mp->mp_pad;
+	int rc;
+
+	rc = memcmp(key->mv_data, PAGEPFX(env, mp),
+		key->mv_size < plen ? key->mv_size : plen);
+	if (rc)
+		return rc;
+	if (key->mv_size < plen)
+		return -1;
+	rest->mv_size = key->mv_size - plen;
+	rest->mv_data = (char *)key->mv_data + plen;
+	return 0;
+}
+
+/** Return how many bytes of a page's key prefix a key starts with.
+ * @param[in] env The environment handle.
+ * @param[in] mp A #P_PREFIX page.
+ * @param[in] key The key to match.
+ * @return The length of the longest prefix the key shares with the page.
+ */
+static unsigned int
+mdb_prefix_match(MDB_env *env, MDB_page *mp, MDB_val *key)
+{
+	unsigned int i, n = mp->mp_pad;
+	char *p = PAGEPFX(env, mp), *k = key->mv_data;
+
+	if (n > key->mv_size)
+		n = key->mv_size;
+	for (i = 0; i < n && p[i] == k[i]; i++) ;
+	return i;
+}
+
+/** Get the full key of a node.
+ * @param[in] env The environment handle.
+ * @param[in] mp The page holding the node.
+ * @param[in] node The node to read.
+ * @param[out] key Set to the node's key.
+ * @param[in] buf At least #ENV_MAXKEY() bytes to rebuild the key in,
+ * only used on a #P_PREFIX page.
+ */
+static void
+mdb_node_key(MDB_env *env, MDB_page *mp, MDB_node *node, MDB_val *key, char *buf)
+{
+	unsigned int plen = PAGEPFXSZ(mp);
+
+	key->mv_size = NODEKSZ(node);
+	key->mv_data = NODEKEY(node);
+	if (plen) {
+		assert(buf != NULL);
+		memcpy(buf, PAGEPFX(env, mp), plen);
+		memcpy(buf + plen, key->mv_data, key->mv_size);
+		key->mv_size += plen;
+		key->mv_data = buf;
+	}
+}
+
+/** Compare a key with the key of a leaf node.
+ * On a #P_PREFIX page the node's key is not rebuilt, the key
+ * is compared with the page's prefix first.
+ * @param[in] mc The cursor for the node's database.
+ * @param[in] mp The page holding the node.
+ * @param[in] node The node to compare with.
+ * @param[in] key The key to compare.
+ * @return < 0, 0 or > 0 if the key sorts before, equal to or after the node.
+ */
+static int
+mdb_node_cmp(MDB_cursor *mc, MDB_page *mp, MDB_node *node, MDB_val *key)
+{
+	MDB_val nodekey, rest;
+	int rc;
+
+	if (PAGEPFXSZ(mp)) {
+		if ((rc = mdb_prefix_cmp(mc->mc_txn->mt_env, mp, key, &rest)) != 0)
+			return rc;
+		key = &rest;
+	}
+	nodekey.mv_size = NODEKSZ(node);
+	nodekey.mv_data = NODEKEY(node);
+	return mc->mc_dbx->md_cmp(key, &nodekey);
+}
+
+/** Set the key prefix of an empty #P_PREFIX page.
+ * @param[in] env The environment handle.
+ * @param[in] mp The page, which must not have any nodes.
+ * @param[in] key A key starting with the prefix.
+ * @param[in] len The length of the prefix.
+ */
+static void
+mdb_prefix_init(MDB_env *env, MDB_page *mp, MDB_val *key, unsigned int len)
+{
+	mp->mp_pad = len;
+	mp->mp_upper = env->me_psize - EVEN(len);
+	memcpy(PAGEPFX(env, mp), key->mv_data, len);
+}
+
+/** Calculate how much a #P_PREFIX page grows if its key prefix is cut.
+ * The bytes cut from the prefix move into the key of every node.
+ * @param[in] env The environment handle.
+ * @param[in] mp The page to check.
+ * @param[in] len The new prefix length.
+ * @return The number of extra bytes needed, 0 if the page doesn't grow.
+ */
+static size_t
+mdb_prefix_grow(MDB_env *env, MDB_page *mp, unsigned int len)
+{
+	MDB_node *node;
+	unsigned int i, sz, nkeys = NUMKEYS(mp), cut;
+	ssize_t grow;
+
+	if (len >= mp->mp_pad)
+		return 0;
+	cut = mp->mp_pad - len;
+	grow = (ssize_t)EVEN(len) - (ssize_t)EVEN(mp->mp_pad);
+	for (i = 0; i < nkeys; i++) {
+		node = NODEPTR(mp, i);
+		sz = NODESIZE + NODEKSZ(node) +
+			(F_ISSET(node->mn_flags, F_BIGDATA) ? sizeof(pgno_t) : NODEDSZ(node));
+		grow += EVEN(sz + cut) - EVEN(sz);
+	}
+	return grow > 0 ? grow : 0;
+}
+
+/** Calculate the room a new node takes on a #P_PREFIX page.
+ * @param[in] env The environment handle.
+ * @param[in] mp The page to check.
+ * @param[in] key The key for the new node.
+ * @param[in] nsize The size of the node with the full key.
+ * @return The size of the node without the part of the key in the
+ * page's prefix, plus the growth from cutting the prefix.
+ */
+static size_t
+mdb_prefix_size(MDB_env *env, MDB_page *mp, MDB_val *key, size_t nsize)
+{
+	unsigned int len = mdb_prefix_match(env, mp, key);
+
+	return nsize - (len & ~1U) + mdb_prefix_grow(env, mp, len);
+}
+
+/** Cut the key prefix of the cursor's page to a shorter length.
+ * The nodes are rewritten with the bytes cut from the prefix in front
+ * of their keys. The caller must have checked that they fit, see
+ * #mdb_prefix_grow().
+ * @param[in] mc The cursor pointing to the #P_PREFIX page.
+ * @param[in] len The new prefix length.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_prefix_cut(MDB_cursor *mc, unsigned int len)
+{
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page *mp = mc->mc_pg[mc->mc_top], *copy;
+	MDB_node *node, *src;
+	unsigned int i, sz, nkeys = NUMKEYS(mp), cut = mp->mp_pad - len;
+	indx_t ofs;
+
+	if ((copy = mdb_page_malloc(mc->mc_txn, 1)) == NULL)
+		return ENOMEM;
+	memcpy(copy, mp, env->me_psize);
+
+	mp->mp_pad = len;
+	memcpy(PAGEPFX(env, mp), PAGEPFX(env, copy), len);
+	ofs = env->me_psize - EVEN(len);
+	for (i = 0; i < nkeys; i++) {
+		src = NODEPTR(copy, i);
+		sz = NODEKSZ(src) +
+			(F_ISSET(src->mn_flags, F_BIGDATA) ? sizeof(pgno_t) : NODEDSZ(src));
+		ofs -= EVEN(NODESIZE + cut + sz);
+		mp->mp_ptrs[i] = ofs;
+		node = NODEPTR(mp, i);
+		memcpy(node, src, NODESIZE);
+		node->mn_ksize += cut;
+		memcpy(NODEKEY(node), PAGEPFX(env, copy) + len, cut);
+		memcpy((char *)NODEKEY(node) + cut, NODEKEY(src), sz);
+	}
+	mp->mp_upper = ofs;
+
+	mdb_page_free(env, copy);
+	return MDB_SUCCESS;
+}
+
+/** @defgroup leaf2search	Integer LEAF2 search
+ *	Sorted integer duplicates on #P_LEAF2 pages are searched without the
+ *	comparison function: a branchless binary search narrows the range to
+ *	a few cache lines, and the keys left are compared with the search key
+ *	at once. The x86-64 versions using SSE or AVX2 are picked at runtime.
+ *	@{
+ */
+	/** Narrow a search to at most this many keys before counting them */
+#define LEAF2_SCAN	16
+
+	/** A function counting the keys on a LEAF2 page below a search key */
+typedef unsigned int (MDB_count_func)(const char *keys, unsigned int n, const void *key);
+
+/** Count the unsigned ints below a key. */
+static unsigned int
+mdb_count_int(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, k, x, cnt = 0;
+
+	memcpy(&k, key, sizeof(k));
+	for (i = 0; i < n; i++) {
+		memcpy(&x, keys + i * sizeof(x), sizeof(x));
+		cnt += x < k;
+	}
+	return cnt;
+}
+
+/** Count the size_t's below a key. */
+static unsigned int
+mdb_count_long(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, cnt = 0;
+	size_t k, x;
+
+	memcpy(&k, key, sizeof(k));
+	for (i = 0; i < n; i++) {
+		memcpy(&x, keys + i * sizeof(x), sizeof(x));
+		cnt += x < k;
+	}
+	return cnt;
+}
+
+#ifdef MDB_USE_SIMD
+	/* The SIMD compares are signed, so both sides get their sign bit
+	 * flipped to compare them unsigned.
+	 */
+static unsigned int
+mdb_count_int_sse2(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, k, cnt = 0;
+	__m128i sign = _mm_set1_epi32(INT_MIN), vk, v;
+
+	memcpy(&k, key, sizeof(k));
+	vk = _mm_xor_si128(_mm_set1_epi32(k), sign);
+	for (i = 0; i + 4 <= n; i += 4) {
+		v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i * 4)), sign);
+		cnt += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(vk, v))));
+	}
+	return cnt + mdb_count_int(keys + i * 4, n - i, key);
+}
+
+__attribute__((target("avx2")))
+static unsigned int
+mdb_count_int_avx2(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, k, cnt = 0;
+	__m256i sign = _mm256_set1_epi32(INT_MIN), vk, v;
+
+	memcpy(&k, key, sizeof(k));
+	vk = _mm256_xor_si256(_mm256_set1_epi32(k), sign);
+	for (i = 0; i + 8 <= n; i += 8) {
+		v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i * 4)), sign);
+		cnt += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vk, v))));
+	}
+	return cnt + mdb_count_int(keys + i * 4, n - i, key);
+}
+
+__attribute__((target("sse4.2")))
+static unsigned int
+mdb_count_long_sse42(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, cnt = 0;
+	long long k;
+	__m128i sign = _mm_set1_epi64x(LLONG_MIN), vk, v;
+
+	memcpy(&k, key, sizeof(k));
+	vk = _mm_xor_si128(_mm_set1_epi64x(k), sign);
+	for (i = 0; i + 2 <= n; i += 2) {
+		v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i * 8)), sign);
+		cnt += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vk, v))));
+	}
+	return cnt + mdb_count_long(keys + i * 8, n - i, key);
+}
+
+__attribute__((target("avx2")))
+static unsigned int
+mdb_count_long_avx2(const char *keys, unsigned int n, const void *key)
+{
+	unsigned int i, cnt = 0;
+	long long k;
+	__m256i sign = _mm256_set1_epi64x(LLONG_MIN), vk, v;
+
+	memcpy(&k, key, sizeof(k));
+	vk = _mm256_xor_si256(_mm256_set1_epi64x(k), sign);
+	for (i = 0; i + 4 <= n; i += 4) {
+		v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i * 8)), sign);
+		cnt += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vk, v))));
+	}
+	return cnt + mdb_count_long(keys + i * 8, n - i, key);
+}
+#endif
+
+	/** The functions counting unsigned ints and size_t's for this CPU */
+static MDB_count_func *mdb_count_funcs[2] = { mdb_count_int, mdb_count_long };
+
+#ifdef MDB_USE_SIMD
+/** Pick the fastest LEAF2 counting functions the CPU supports.
+ *	Runs once per process, see #mdb_count_once.
+ */
+static void
+mdb_count_init(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		mdb_count_funcs[0] = mdb_count_int_avx2;
+		mdb_count_funcs[1] = sizeof(size_t) == 8 ? mdb_count_long_avx2 : mdb_count_long;
+	} else {
+		mdb_count_funcs[0] = mdb_count_int_sse2;
+		if (sizeof(size_t) == 8 && __builtin_cpu_supports("sse4.2"))
+			mdb_count_funcs[1] = mdb_count_long_sse42;
+	}
+}
+#endif
+
+/** Find the first key on an integer LEAF2 page that is not below a key.
+ * @param[in] mp The #P_LEAF2 page, compared with #mdb_cmp_int() or #mdb_cmp_long().
+ * @param[in] key The key to search for, of the page's key size.
+ * @return The index of the key, or the number of keys if all are below it.
+ */
+static unsigned int
+mdb_leaf2_search(MDB_page *mp, MDB_val *key)
+{
+	const char *keys = (const char *)METADATA(mp), *base = keys;
+	unsigned int n = NUMKEYS(mp), half;
+
+	if (key->mv_size == sizeof(unsigned int)) {
+		unsigned int k, x;
+		memcpy(&k, key->mv_data, sizeof(k));
+		while (n > LEAF2_SCAN) {
+			half = n >> 1;
+			memcpy(&x, base + half * sizeof(x), sizeof(x));
+			base = x < k ? base + half * sizeof(x) : base;
+			n -= half;
+		}
+		return (base - keys) / sizeof(x) + mdb_count_funcs[0](base, n, &k);
+	} else {
+		size_t k, x;
+		memcpy(&k, key->mv_data, sizeof(k));
+		while (n > LEAF2_SCAN) {
+			half = n >> 1;
+			memcpy(&x, base + half * sizeof(x), sizeof(x));
+			base = x < k ? base + half * sizeof(x) : base;
+			n -= half;
+		}
+		return (base - keys) / sizeof(x) + mdb_count_funcs[1](base, n, &k);
+	}
+}
+/** @} */
+
+/** @defgroup nodesearch	Default comparison searches
+ *	Node searches for databases using the default comparison functions,
+ *	with the comparison inlined instead of called for every probe.
+ *	Each returns the result of comparing the key with the last node
+ *	probed and stores its index, like the loop in #mdb_node_search().
+ *	@{
+ */
+	/** Compare keys up to this long a word at a time instead of with memcmp() */
+#define MDB_SHORTKEY	32
+
+/** Compare two byte strings like #mdb_cmp_memn(). */
+static int
+mdb_memn(const unsigned char *a, unsigned int alen, const unsigned char *b, unsigned int blen)
+{
+	unsigned int len = alen < blen ? alen : blen;
+	size_t x, y;
+	int diff;
+
+	if (len > MDB_SHORTKEY) {
+		diff = memcmp(a, b, len);
+		if (diff)
+			return diff;
+	} else {
+		/* Skip the equal words, the byte loop finds the difference */
+		for (; len >= sizeof(size_t); len -= sizeof(size_t)) {
+			memcpy(&x, a, sizeof(x));
+			memcpy(&y, b, sizeof(y));
+			if (x != y)
+				break;
+			a += sizeof(size_t);
+			b += sizeof(size_t);
+		}
+		for (; len; len--, a++, b++)
+			if (*a != *b)
+				return *a - *b;
+	}
+	return alen < blen ? -1 : alen > blen;
+}
+
+/** Search the nodes of a page with #mdb_cmp_memn(). */
+static int
+mdb_search_memn(MDB_page *mp, MDB_val *key, int low, int high, unsigned int *ip)
+{
+	unsigned int i = 0;
+	MDB_node *node;
+	int rc = 0;
+
+	while (low <= high) {
+		i = (low + high) >> 1;
+		node = NODEPTR(mp, i);
+		rc = mdb_memn(key->mv_data, key->mv_size, NODEKEY(node), NODEKSZ(node));
+		if (rc == 0)
+			break;
+		if (rc > 0)
+			low = i + 1;
+		else
+			high = i - 1;
+	}
+	*ip = i;
+	return rc;
+}
+
+/** Read an unsigned int or size_t integer key of any alignment. */
+static size_t
+mdb_int_key(const void *p, size_t size)
+{
+	unsigned int u;
+	size_t z;
+
+	if (size == sizeof(size_t)) {
+		memcpy(&z, p, sizeof(z));
+		return z;
+	}
+	memcpy(&u, p, sizeof(u));
+	return u;
+}
+
+/** Search the nodes of an integer key page.
+ *	On a wide range the first node probed is guessed from where the key
+ *	falls between the first and last keys, and the key is then bracketed
+ *	by probing ever further from the guess, so evenly spread keys are
+ *	found in a few probes. Binary search finishes the bracket.
+ */
+static int
+mdb_search_int(MDB_page *mp, MDB_val *key, int low, int high, unsigned int *ip)
+{
+	size_t k, x, first, last, size = key->mv_size;
+	unsigned int i = 0, step;
+	int rc = 0;
+
+#define INTKEY(i)	mdb_int_key(NODEKEY(NODEPTR(mp, i)), size)
+	k = mdb_int_key(key->mv_data, size);
+	if (high - low > LEAF2_SCAN) {
+		first = INTKEY(low);
+		last = INTKEY(high);
+		if (k <= first)
+			i = low;
+		else if (k >= last)
+			i = high;
+		else
+			i = low + (unsigned int)((double)(k - first) / (last - first) * (high - low));
+		x = INTKEY(i);
+		if (k == x) {
+			*ip = i;
+			return 0;
+		}
+		if (k > x) {
+			low = i + 1;
+			for (step = 1; i + step <= (unsigned int)high; step <<= 1) {
+				x = INTKEY(i + step);
+				if (k <= x) {
+					high = i + step - (k < x);
+					break;
+				}
+				low = i + step + 1;
+			}
+		} else {
+			high = i - 1;
+			for (step = 1; i >= (unsigned int)low + step; step <<= 1) {
+				x = INTKEY(i - step);
+				if (k >= x) {
+					low = i - step + (k > x);
+					break;
+				}
+				high = i - step - 1;
+			}
+		}
+		if (low > high) {
+			/* Bracketed between two neighbours */
+			*ip = low;
+			return -1;
+		}
 	}
-	return len_diff<0 ? -1 : len_diff;
+	while (low <= high) {
+		i = (low + high) >> 1;
+		x = INTKEY(i);
+		rc = k < x ? -1 : k > x;
+		if (rc == 0)
+			break;
+		if (rc > 0)
+			low = i + 1;
+		else
+			high = i - 1;
+	}
+#undef INTKEY
+	*ip = i;
+	return rc;
 }
+/** @} */
 
 /** Search for key within a page, using binary search.
  * Returns the smallest entry larger or equal to the key.
@@ -4463,7 +6722,7 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 	int		 rc = 0;
 	MDB_page *mp = mc->mc_pg[mc->mc_top];
 	MDB_node	*node = NULL;
-	MDB_val	 nodekey;
+	MDB_val	 nodekey, rest;
 	MDB_cmp_func *cmp;
 	DKBUF;
 
@@ -4498,6 +6757,14 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 	if (IS_LEAF2(mp)) {
 		nodekey.mv_size = mc->mc_db->md_pad;
 		node = NODEPTR(mp, 0);	/* fake */
+		if ((cmp == mdb_cmp_int || cmp == mdb_cmp_long) &&
+			key->mv_size == nodekey.mv_size) {
+			i = mdb_leaf2_search(mp, key);
+			/* found entry is greater than the key, unless equal */
+			rc = i < nkeys && !memcmp(LEAF2KEY(mp, i, nodekey.mv_size),
+				key->mv_data, nodekey.mv_size) ? 0 : -1;
+			low = high + 1;
+		}
 		while (low <= high) {
 			i = (low + high) >> 1;
 			nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size);
@@ -4512,6 +6779,29 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 				high = i - 1;
 		}
 	} else {
+		if (PAGEPFXSZ(mp)) {
+			/* Only search the nodes if the key has the page's prefix */
+			rc = mdb_prefix_cmp(mc->mc_txn->mt_env, mp, key, &rest);
+			if (rc) {
+				i = rc < 0 ? 0 : high;
+				node = NODEPTR(mp, i);
+				low = high + 1;
+			} else {
+				key = &rest;
+			}
+		}
+		if (low <= high) {
+			if (cmp == mdb_cmp_memn) {
+				rc = mdb_search_memn(mp, key, low, high, &i);
+				node = NODEPTR(mp, i);
+				low = high + 1;
+			} else if ((cmp == mdb_cmp_cint || cmp == mdb_cmp_int || cmp == mdb_cmp_long) &&
+				(key->mv_size == sizeof(unsigned int) || key->mv_size == sizeof(size_t))) {
+				rc = mdb_search_int(mp, key, low, high, &i);
+				node = NODEPTR(mp, i);
+				low = high + 1;
+			}
+		}
 		while (low <= high) {
 			i = (low + high) >> 1;
 
@@ -4637,13 +6927,8 @@ mdb_page_get(MDB_txn *txn, pgno_t pgno, MDB_page **ret, int *lvl)
 					goto done;
 				}
 			}
-			if (dl[0].mid) {
-				unsigned x = mdb_mid2l_search(dl, pgno);
-				if (x <= dl[0].mid && dl[x].mid == pgno) {
-					p = dl[x].mptr;
-					goto done;
-				}
-			}
+			if (dl[0].mid && (p = mdb_dhash_get(tx2->mt_dirty_hash, pgno)))
+				goto done;
 			level++;
 		} while ((tx2 = tx2->mt_parent) != NULL);
 	}
@@ -4863,7 +7148,7 @@ mdb_ovpage_free(MDB_cursor *mc, MDB_page *mp)
 		 (sl && (x = mdb_midl_search(sl, pn)) <= sl[0] && sl[x] == pn)))
 	{
 		unsigned i, j;
-		pgno_t *mop;
+		pgno_t *mop, range[2];
 		MDB_ID2 *dl, ix, iy;
 		rc = mdb_midl_need(&env->me_pghead, ovpages);
 		if (rc)
@@ -4888,10 +7173,15 @@ mdb_ovpage_free(MDB_cursor *mc, MDB_page *mp)
 				assert(x > 1);
 				j = ++(dl[0].mid);
 				dl[j] = ix;		/* Unsorted. OK when MDB_TXN_ERROR. */
+				txn->mt_dirty_sorted = 0;
 				txn->mt_flags |= MDB_TXN_ERROR;
 				return MDB_CORRUPTED;
 			}
 		}
+		mdb_dhash_del(txn->mt_dirty_hash, pg);
+		if (x <= txn->mt_dirty_sorted)
+			txn->mt_dirty_sorted--;
+		txn->mt_dirty_room++;
 		if (!(env->me_flags & MDB_WRITEMAP))
 			mdb_dpage_free(env, mp);
 release:
@@ -4900,9 +7190,13 @@ release:
 		j = mop[0] + ovpages;
 		for (i = mop[0]; i && mop[i] < pg; i--)
 			mop[j--] = mop[i];
+		range[0] = 1;
+		range[1] = pg;
 		while (j>i)
 			mop[j--] = pg++;
 		mop[0] += ovpages;
+		if (env->me_pgext_ok && mdb_pgext_merge(env, range))
+			mdb_pgext_reset(env);
 	} else {
 		rc = mdb_midl_append_range(&txn->mt_free_pgs, pg, ovpages);
 		if (rc)
@@ -4963,7 +7257,7 @@ mdb_get(MDB_txn *txn, MDB_dbi dbi,
 	if (txn->mt_flags & MDB_TXN_ERROR)
 		return MDB_BAD_TXN;
 
-	if (key->mv_size > MDB_MAXKEYSIZE) {
+	if (key->mv_size > ENV_MAXKEY(txn->mt_env)) {
 		return MDB_BAD_VALSIZE;
 	}
 
@@ -5051,7 +7345,7 @@ mdb_cursor_next(MDB_cursor *mc, MDB_val *key, MDB_val *data, MDB_cursor_op op)
 				rc = mdb_cursor_next(&mc->mc_xcursor->mx_cursor, data, NULL, MDB_NEXT);
 				if (op != MDB_NEXT || rc != MDB_NOTFOUND) {
 					if (rc == MDB_SUCCESS)
-						MDB_GET_KEY(leaf, key);
+						MDB_GET_KEY(mc, leaf, key);
 					return rc;
 				}
 			}
@@ -5104,7 +7398,7 @@ skip:
 		}
 	}
 
-	MDB_GET_KEY(leaf, key);
+	MDB_GET_KEY(mc, leaf, key);
 	return MDB_SUCCESS;
 }
 
@@ -5127,7 +7421,7 @@ mdb_cursor_prev(MDB_cursor *mc, MDB_val *key, MDB_val *data, MDB_cursor_op op)
 				rc = mdb_cursor_prev(&mc->mc_xcursor->mx_cursor, data, NULL, MDB_PREV);
 				if (op != MDB_PREV || rc != MDB_NOTFOUND) {
 					if (rc == MDB_SUCCESS)
-						MDB_GET_KEY(leaf, key);
+						MDB_GET_KEY(mc, leaf, key);
 					return rc;
 				}
 			} else {
@@ -5179,10 +7473,39 @@ mdb_cursor_prev(MDB_cursor *mc, MDB_val *key, MDB_val *data, MDB_cursor_op op)
 		}
 	}
 
-	MDB_GET_KEY(leaf, key);
+	MDB_GET_KEY(mc, leaf, key);
 	return MDB_SUCCESS;
 }
 
+/** Move a cursor to the leaf page for a key, starting from its current
+ * position instead of the root. The cursor climbs its stack only until
+ * a page whose own keys bracket the key, and searches down from there.
+ * @param[in] mc The initialized cursor.
+ * @param[in] key The key to search for.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_cursor_climb(MDB_cursor *mc, MDB_val *key)
+{
+	MDB_page *mp;
+	unsigned int nkeys;
+
+	for (; mc->mc_top > 0; mc->mc_top--, mc->mc_snum--) {
+		mp = mc->mc_pg[mc->mc_top];
+		nkeys = NUMKEYS(mp);
+		if (IS_LEAF(mp)) {
+			if (nkeys && mdb_node_cmp(mc, mp, NODEPTR(mp, 0), key) >= 0 &&
+				mdb_node_cmp(mc, mp, NODEPTR(mp, nkeys-1), key) <= 0)
+				return MDB_SUCCESS;
+		} else if (nkeys > 2 && mdb_node_cmp(mc, mp, NODEPTR(mp, 1), key) >= 0 &&
+			mdb_node_cmp(mc, mp, NODEPTR(mp, nkeys-1), key) < 0) {
+			/* The key is past the first separator and before the last */
+			break;
+		}
+	}
+	return mdb_page_search_root(mc, key, 0);
+}
+
 /** Set the cursor on a specific data item. */
 static int
 mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
@@ -5201,6 +7524,17 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 	if (mc->mc_xcursor)
 		mc->mc_xcursor->mx_cursor.mc_flags &= ~(C_INITIALIZED|C_EOF);
 
+	if (op == MDB_SEEK_FORWARD) {
+		/* #mdb_cursor_put() asks for an exact match near the cursor */
+		op = exactp ? MDB_SET : MDB_SET_RANGE;
+		if ((mc->mc_flags & C_INITIALIZED) && mc->mc_snum) {
+			if ((rc = mdb_cursor_climb(mc, key)) != MDB_SUCCESS)
+				return rc;
+			mp = mc->mc_pg[mc->mc_top];
+			goto set2;
+		}
+	}
+
 	/* See if we're already on the right page */
 	if (mc->mc_flags & C_INITIALIZED) {
 		MDB_val nodekey;
@@ -5213,11 +7547,11 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		if (mp->mp_flags & P_LEAF2) {
 			nodekey.mv_size = mc->mc_db->md_pad;
 			nodekey.mv_data = LEAF2KEY(mp, 0, nodekey.mv_size);
+			rc = mc->mc_dbx->md_cmp(key, &nodekey);
 		} else {
 			leaf = NODEPTR(mp, 0);
-			MDB_GET_KEY2(leaf, nodekey);
+			rc = mdb_node_cmp(mc, mp, leaf, key);
 		}
-		rc = mc->mc_dbx->md_cmp(key, &nodekey);
 		if (rc == 0) {
 			/* Probably happens rarely, but first node on the page
 			 * was the one we wanted.
@@ -5234,11 +7568,11 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 				if (mp->mp_flags & P_LEAF2) {
 					nodekey.mv_data = LEAF2KEY(mp,
 						 nkeys-1, nodekey.mv_size);
+					rc = mc->mc_dbx->md_cmp(key, &nodekey);
 				} else {
 					leaf = NODEPTR(mp, nkeys-1);
-					MDB_GET_KEY2(leaf, nodekey);
+					rc = mdb_node_cmp(mc, mp, leaf, key);
 				}
-				rc = mc->mc_dbx->md_cmp(key, &nodekey);
 				if (rc == 0) {
 					/* last node was the one we wanted */
 					mc->mc_ki[mc->mc_top] = nkeys-1;
@@ -5252,11 +7586,11 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 						if (mp->mp_flags & P_LEAF2) {
 							nodekey.mv_data = LEAF2KEY(mp,
 								 mc->mc_ki[mc->mc_top], nodekey.mv_size);
+							rc = mc->mc_dbx->md_cmp(key, &nodekey);
 						} else {
 							leaf = NODEPTR(mp, mc->mc_ki[mc->mc_top]);
-							MDB_GET_KEY2(leaf, nodekey);
+							rc = mdb_node_cmp(mc, mp, leaf, key);
 						}
-						rc = mc->mc_dbx->md_cmp(key, &nodekey);
 						if (rc == 0) {
 							/* current node was the one we wanted */
 							if (exactp)
@@ -5284,7 +7618,7 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		if (!mc->mc_top) {
 			/* There are no other pages */
 			mc->mc_ki[mc->mc_top] = 0;
-			if (op == MDB_SET_RANGE) {
+			if (op == MDB_SET_RANGE && !exactp) {
 				rc = 0;
 				goto set1;
 			} else
@@ -5365,7 +7699,7 @@ set1:
 
 	/* The key already matches in all other cases */
 	if (op == MDB_SET_RANGE || op == MDB_SET_KEY)
-		MDB_GET_KEY(leaf, key);
+		MDB_GET_KEY(mc, leaf, key);
 	DPRINTF(("==> cursor placed on key [%s]", DKEY(key)));
 
 	return rc;
@@ -5411,7 +7745,7 @@ mdb_cursor_first(MDB_cursor *mc, MDB_val *key, MDB_val *data)
 				return rc;
 		}
 	}
-	MDB_GET_KEY(leaf, key);
+	MDB_GET_KEY(mc, leaf, key);
 	return MDB_SUCCESS;
 }
 
@@ -5457,7 +7791,7 @@ mdb_cursor_last(MDB_cursor *mc, MDB_val *key, MDB_val *data)
 		}
 	}
 
-	MDB_GET_KEY(leaf, key);
+	MDB_GET_KEY(mc, leaf, key);
 	return MDB_SUCCESS;
 }
 
@@ -5492,7 +7826,7 @@ mdb_cursor_get(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 				key->mv_data = LEAF2KEY(mp, mc->mc_ki[mc->mc_top], key->mv_size);
 			} else {
 				MDB_node *leaf = NODEPTR(mp, mc->mc_ki[mc->mc_top]);
-				MDB_GET_KEY(leaf, key);
+				MDB_GET_KEY(mc, leaf, key);
 				if (data) {
 					if (F_ISSET(leaf->mn_flags, F_DUPDATA)) {
 						if (mc->mc_flags & C_DEL)
@@ -5519,11 +7853,12 @@ mdb_cursor_get(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 	case MDB_SET:
 	case MDB_SET_KEY:
 	case MDB_SET_RANGE:
+	case MDB_SEEK_FORWARD:
 		if (key == NULL) {
 			rc = EINVAL;
-		} else if (key->mv_size > MDB_MAXKEYSIZE) {
+		} else if (key->mv_size > ENV_MAXKEY(mc->mc_txn->mt_env)) {
 			rc = MDB_BAD_VALSIZE;
-		} else if (op == MDB_SET_RANGE)
+		} else if (op == MDB_SET_RANGE || op == MDB_SEEK_FORWARD)
 			rc = mdb_cursor_set(mc, key, data, op, NULL);
 		else
 			rc = mdb_cursor_set(mc, key, data, op, &exact);
@@ -5668,10 +8003,9 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 	MDB_val	xdata, *rdata, dkey;
 	MDB_db dummy;
 	int do_sub = 0, insert = 0;
-	unsigned int mcount = 0, dcount = 0, nospill;
+	unsigned int mcount = 0, dcount = 0, nospill, nearby;
 	size_t nsize;
 	int rc, rc2;
-	char dbuf[MDB_MAXKEYSIZE+1];
 	unsigned int nflags;
 	DKBUF;
 
@@ -5686,15 +8020,16 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 	}
 
 	nospill = flags & MDB_NOSPILL;
-	flags &= ~MDB_NOSPILL;
+	nearby = flags & MDB_NEARBY;
+	flags &= ~(MDB_NOSPILL|MDB_NEARBY);
 
 	if (mc->mc_txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_ERROR))
 		return (mc->mc_txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
 
-	if (flags != MDB_CURRENT && (key->mv_size == 0 || key->mv_size > MDB_MAXKEYSIZE))
+	if (flags != MDB_CURRENT && (key->mv_size == 0 || key->mv_size > ENV_MAXKEY(env)))
 		return MDB_BAD_VALSIZE;
 
-	if (F_ISSET(mc->mc_db->md_flags, MDB_DUPSORT) && data->mv_size > MDB_MAXKEYSIZE)
+	if (F_ISSET(mc->mc_db->md_flags, MDB_DUPSORT) && data->mv_size > ENV_MAXKEY(env))
 		return MDB_BAD_VALSIZE;
 
 #if SIZE_MAX > MAXDATASIZE
@@ -5722,9 +8057,16 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		MDB_val d2;
 		if (flags & MDB_APPEND) {
 			MDB_val k2;
-			rc = mdb_cursor_last(mc, &k2, &d2);
+			rc = mdb_cursor_last(mc, NULL, &d2);
 			if (rc == 0) {
-				rc = mc->mc_dbx->md_cmp(key, &k2);
+				MDB_page *mp = mc->mc_pg[mc->mc_top];
+				if (IS_LEAF2(mp)) {
+					k2.mv_size = mc->mc_db->md_pad;
+					k2.mv_data = LEAF2KEY(mp, mc->mc_ki[mc->mc_top], k2.mv_size);
+					rc = mc->mc_dbx->md_cmp(key, &k2);
+				} else {
+					rc = mdb_node_cmp(mc, mp, NODEPTR(mp, mc->mc_ki[mc->mc_top]), key);
+				}
 				if (rc > 0) {
 					rc = MDB_NOTFOUND;
 					mc->mc_ki[mc->mc_top]++;
@@ -5734,7 +8076,7 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 				}
 			}
 		} else {
-			rc = mdb_cursor_set(mc, key, &d2, MDB_SET, &exact);
+			rc = mdb_cursor_set(mc, key, &d2, nearby ? MDB_SEEK_FORWARD : MDB_SET, &exact);
 		}
 		if ((flags & MDB_NOOVERWRITE) && rc == 0) {
 			DPRINTF(("duplicate key [%s]", DKEY(key)));
@@ -5771,6 +8113,8 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		mc->mc_db->md_root = np->mp_pgno;
 		mc->mc_db->md_depth++;
 		*mc->mc_dbflag |= DB_DIRTY;
+		if (IS_PREFIX(np))
+			mdb_prefix_init(env, np, key, key->mv_size);
 		if ((mc->mc_db->md_flags & (MDB_DUPSORT|MDB_DUPFIXED))
 			== MDB_DUPFIXED)
 			np->mp_flags |= P_LEAF2;
@@ -5806,6 +8150,10 @@ more:
 
 		/* DB has dups? */
 		if (F_ISSET(mc->mc_db->md_flags, MDB_DUPSORT)) {
+			unsigned int offset = 0;
+			unsigned int i;
+			uint16_t fp_flags;
+
 			mp = fp = xdata.mv_data = env->me_pbuf;
 			mp->mp_pgno = mc->mc_pg[mc->mc_top]->mp_pgno;
 
@@ -5835,9 +8183,11 @@ more:
 					return rc;
 				}
 
-				/* create a fake page for the dup items */
-				memcpy(dbuf, dkey.mv_data, dkey.mv_size);
-				dkey.mv_data = dbuf;
+				/* create a fake page for the dup items, keeping
+				 * the original item past its header until it is
+				 * written to the sub-page or subDB
+				 */
+				dkey.mv_data = memcpy(fp+1, dkey.mv_data, dkey.mv_size);
 				fp->mp_flags = P_LEAF|P_DIRTY|P_SUBP;
 				fp->mp_lower = PAGEHDRSZ;
 				xdata.mv_size = PAGEHDRSZ + dkey.mv_size + data->mv_size;
@@ -5850,16 +8200,13 @@ more:
 						(dkey.mv_size & 1) + (data->mv_size & 1);
 				}
 				fp->mp_upper = xdata.mv_size;
+				olddata.mv_size = xdata.mv_size; /* pretend olddata is fp */
 			} else if (leaf->mn_flags & F_SUBDATA) {
 				/* Data is on sub-DB, just store it */
 				flags |= F_DUPDATA|F_SUBDATA;
 				goto put_sub;
 			} else {
-				/* See if we need to convert from fake page to subDB */
-				unsigned int offset;
-				unsigned int i;
-				uint16_t fp_flags;
-
+				/* Data is on sub-page */
 				fp = olddata.mv_data;
 				switch (flags) {
 				default:
@@ -5881,46 +8228,54 @@ more:
 					flags |= F_DUPDATA;
 					goto put_sub;
 				}
-				fp_flags = fp->mp_flags;
 				xdata.mv_size = olddata.mv_size + offset;
-				if (NODESIZE + sizeof(indx_t) + NODEKSZ(leaf) + xdata.mv_size
-					>= env->me_nodemax) {
-					/* yes, convert it */
-					if (mc->mc_db->md_flags & MDB_DUPFIXED) {
-						dummy.md_pad = fp->mp_pad;
-						dummy.md_flags = MDB_DUPFIXED;
-						if (mc->mc_db->md_flags & MDB_INTEGERDUP)
-							dummy.md_flags |= MDB_INTEGERKEY;
-					} else {
-						dummy.md_pad = 0;
-						dummy.md_flags = 0;
-					}
-					dummy.md_depth = 1;
-					dummy.md_branch_pages = 0;
-					dummy.md_leaf_pages = 1;
-					dummy.md_overflow_pages = 0;
-					dummy.md_entries = NUMKEYS(fp);
-					xdata.mv_size = sizeof(MDB_db);
-					xdata.mv_data = &dummy;
+			}
+
+			fp_flags = fp->mp_flags;
+			if (NODESIZE + sizeof(indx_t) + NODEKSZ(leaf) + xdata.mv_size
+				>= env->me_nodemax) {
+				/* Too big for a sub-page, convert to subDB */
+				if (mc->mc_db->md_flags & MDB_DUPFIXED) {
+					dummy.md_pad = fp->mp_pad;
+					dummy.md_flags = MDB_DUPFIXED;
+					if (mc->mc_db->md_flags & MDB_INTEGERDUP)
+						dummy.md_flags |= MDB_INTEGERKEY;
+				} else {
+					dummy.md_pad = 0;
+					dummy.md_flags = 0;
+				}
+				dummy.md_branch_pages = 0;
+				dummy.md_overflow_pages = 0;
+				dummy.md_entries = NUMKEYS(fp);
+				xdata.mv_size = sizeof(MDB_db);
+				xdata.mv_data = &dummy;
+				if (NUMKEYS(fp)) {
 					if ((rc = mdb_page_alloc(mc, 1, &mp)))
 						return rc;
 					offset = env->me_psize - olddata.mv_size;
-					flags |= F_DUPDATA|F_SUBDATA;
+					dummy.md_depth = 1;
+					dummy.md_leaf_pages = 1;
 					dummy.md_root = mp->mp_pgno;
-					fp_flags &= ~P_SUBP;
-				}
-				mp->mp_flags = fp_flags | P_DIRTY;
-				mp->mp_pad   = fp->mp_pad;
-				mp->mp_lower = fp->mp_lower;
-				mp->mp_upper = fp->mp_upper + offset;
-				if (IS_LEAF2(fp)) {
-					memcpy(METADATA(mp), METADATA(fp), NUMKEYS(fp) * fp->mp_pad);
 				} else {
-					memcpy((char *)mp + mp->mp_upper, (char *)fp + fp->mp_upper,
-						olddata.mv_size - fp->mp_upper);
-					for (i=0; i<NUMKEYS(fp); i++)
-						mp->mp_ptrs[i] = fp->mp_ptrs[i] + offset;
+					/* Nothing to move, the first put creates the root */
+					dummy.md_depth = 0;
+					dummy.md_leaf_pages = 0;
+					dummy.md_root = P_INVALID;
 				}
+				flags |= F_DUPDATA|F_SUBDATA;
+				fp_flags &= ~P_SUBP;
+			}
+			mp->mp_flags = fp_flags | P_DIRTY;
+			mp->mp_pad   = fp->mp_pad;
+			mp->mp_lower = fp->mp_lower;
+			mp->mp_upper = fp->mp_upper + offset;
+			if (IS_LEAF2(fp)) {
+				memcpy(METADATA(mp), METADATA(fp), NUMKEYS(fp) * fp->mp_pad);
+			} else {
+				memcpy((char *)mp + mp->mp_upper, (char *)fp + fp->mp_upper,
+					olddata.mv_size - fp->mp_upper);
+				for (i=0; i<NUMKEYS(fp); i++)
+					mp->mp_ptrs[i] = fp->mp_ptrs[i] + offset;
 			}
 
 			rdata = &xdata;
@@ -5966,7 +8321,12 @@ current:
 						return ENOMEM;
 					id2.mid = pg;
 					id2.mptr = np;
-					mdb_mid2l_insert(mc->mc_txn->mt_u.dirty_list, &id2);
+					if ((rc2 = mdb_dlist_insert(mc->mc_txn, &id2)) != MDB_SUCCESS) {
+						np->mp_flags = P_OVERFLOW;
+						np->mp_pages = ovpages;
+						mdb_dpage_free(env, np);
+						return rc2;
+					}
 					if (!(flags & MDB_RESERVE)) {
 						/* Copy end of page, adjusting alignment so
 						 * compiler may copy words instead of bytes.
@@ -5998,7 +8358,7 @@ current:
 				data->mv_data = olddata.mv_data;
 			else if (data->mv_size)
 				memcpy(olddata.mv_data, data->mv_data, data->mv_size);
-			else
+			else if (!IS_PREFIX(mc->mc_pg[mc->mc_top]))
 				memcpy(NODEKEY(leaf), key->mv_data, key->mv_size);
 			goto done;
 		}
@@ -6014,6 +8374,8 @@ current:
 new_sub:
 	nflags = flags & NODE_ADD_FLAGS;
 	nsize = IS_LEAF2(mc->mc_pg[mc->mc_top]) ? key->mv_size : mdb_leaf_size(env, key, rdata);
+	if (IS_PREFIX(mc->mc_pg[mc->mc_top]))
+		nsize = mdb_prefix_size(env, mc->mc_pg[mc->mc_top], key, nsize);
 	if (SIZELEFT(mc->mc_pg[mc->mc_top]) < nsize) {
 		if (( flags & (F_DUPDATA|F_SUBDATA)) == F_DUPDATA )
 			nflags &= ~MDB_APPEND;
@@ -6178,15 +8540,17 @@ mdb_cursor_del(MDB_cursor *mc, unsigned int flags)
 				return rc;
 			}
 			/* otherwise fall thru and delete the sub-DB */
+		} else {
+			/* mdb_cursor_del0() subtracts the last one */
+			mc->mc_db->md_entries -=
+				mc->mc_xcursor->mx_db.md_entries - 1;
 		}
 
 		if (leaf->mn_flags & F_SUBDATA) {
 			/* add all the child DB's pages to the free list */
 			rc = mdb_drop0(&mc->mc_xcursor->mx_cursor, 0);
-			if (rc == MDB_SUCCESS) {
-				mc->mc_db->md_entries -=
-					mc->mc_xcursor->mx_db.md_entries;
-			}
+			if (rc)
+				return rc;
 		}
 	}
 
@@ -6214,6 +8578,11 @@ mdb_page_new(MDB_cursor *mc, uint32_t flags, int num, MDB_page **mp)
 	np->mp_flags = flags | P_DIRTY;
 	np->mp_lower = PAGEHDRSZ;
 	np->mp_upper = mc->mc_txn->mt_env->me_psize;
+	if ((flags & (P_LEAF|P_LEAF2)) == P_LEAF &&
+		(mc->mc_db->md_flags & MDB_PREFIXKEY)) {
+		np->mp_flags |= P_PREFIX;
+		np->mp_pad = 0;
+	}
 
 	if (IS_BRANCH(np))
 		mc->mc_db->md_branch_pages++;
@@ -6298,7 +8667,7 @@ static int
 mdb_node_add(MDB_cursor *mc, indx_t indx,
     MDB_val *key, MDB_val *data, pgno_t pgno, unsigned int flags)
 {
-	unsigned int	 i;
+	unsigned int	 i, plen = 0;
 	size_t		 node_size = NODESIZE;
 	ssize_t		 room;
 	indx_t		 ofs;
@@ -6336,16 +8705,23 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 		node_size += key->mv_size;
 	if (IS_LEAF(mp)) {
 		assert(data);
+		if (IS_PREFIX(mp)) {
+			/* Only the rest of the key after the page's prefix is
+			 * stored. A key without all of the prefix cuts it short.
+			 */
+			plen = mdb_prefix_match(mc->mc_txn->mt_env, mp, key);
+			room -= mdb_prefix_grow(mc->mc_txn->mt_env, mp, plen);
+		}
 		if (F_ISSET(flags, F_BIGDATA)) {
 			/* Data already on overflow page. */
-			node_size += sizeof(pgno_t);
+			node_size += sizeof(pgno_t) - plen;
 		} else if (node_size + data->mv_size >= mc->mc_txn->mt_env->me_nodemax) {
 			int ovpages = OVPAGES(data->mv_size, mc->mc_txn->mt_env->me_psize);
 			int rc;
 			/* Put data on overflow page. */
 			DPRINTF(("data size is %"Z"u, node would be %"Z"u, put data on overflow page",
 			    data->mv_size, node_size+data->mv_size));
-			node_size += sizeof(pgno_t) + (node_size & 1);
+			node_size = EVEN(node_size + sizeof(pgno_t) - plen);
 			if ((ssize_t)node_size > room)
 				goto full;
 			if ((rc = mdb_page_new(mc, P_OVERFLOW, ovpages, &ofp)))
@@ -6354,7 +8730,7 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 			flags |= F_BIGDATA;
 			goto update;
 		} else {
-			node_size += data->mv_size;
+			node_size += data->mv_size - plen;
 		}
 	}
 	node_size += node_size & 1;
@@ -6362,6 +8738,12 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 		goto full;
 
 update:
+	if (plen < PAGEPFXSZ(mp)) {
+		int rc;
+		if ((rc = mdb_prefix_cut(mc, plen)) != MDB_SUCCESS)
+			return rc;
+	}
+
 	/* Move higher pointers up one slot. */
 	for (i = NUMKEYS(mp); i > indx; i--)
 		mp->mp_ptrs[i] = mp->mp_ptrs[i - 1];
@@ -6375,7 +8757,7 @@ update:
 
 	/* Write the node data. */
 	node = NODEPTR(mp, indx);
-	node->mn_ksize = (key == NULL) ? 0 : key->mv_size;
+	node->mn_ksize = (key == NULL) ? 0 : key->mv_size - plen;
 	node->mn_flags = flags;
 	if (IS_LEAF(mp))
 		SETDSZ(node,data->mv_size);
@@ -6383,21 +8765,21 @@ update:
 		SETPGNO(node,pgno);
 
 	if (key)
-		memcpy(NODEKEY(node), key->mv_data, key->mv_size);
+		memcpy(NODEKEY(node), (char *)key->mv_data + plen, key->mv_size - plen);
 
 	if (IS_LEAF(mp)) {
 		assert(key);
 		if (ofp == NULL) {
 			if (F_ISSET(flags, F_BIGDATA))
-				memcpy(node->mn_data + key->mv_size, data->mv_data,
+				memcpy(NODEDATA(node), data->mv_data,
 				    sizeof(pgno_t));
 			else if (F_ISSET(flags, MDB_RESERVE))
-				data->mv_data = node->mn_data + key->mv_size;
+				data->mv_data = NODEDATA(node);
 			else
-				memcpy(node->mn_data + key->mv_size, data->mv_data,
+				memcpy(NODEDATA(node), data->mv_data,
 				    data->mv_size);
 		} else {
-			memcpy(node->mn_data + key->mv_size, &ofp->mp_pgno,
+			memcpy(NODEDATA(node), &ofp->mp_pgno,
 			    sizeof(pgno_t));
 			if (F_ISSET(flags, MDB_RESERVE))
 				data->mv_data = METADATA(ofp);
@@ -6550,6 +8932,7 @@ mdb_xcursor_init0(MDB_cursor *mc)
 	mx->mx_cursor.mc_dbx = &mx->mx_dbx;
 	mx->mx_cursor.mc_dbi = mc->mc_dbi;
 	mx->mx_cursor.mc_dbflag = &mx->mx_dbflag;
+	mx->mx_cursor.mc_kbuf = NULL;
 	mx->mx_cursor.mc_snum = 0;
 	mx->mx_cursor.mc_top = 0;
 	mx->mx_cursor.mc_flags = C_SUB;
@@ -6558,6 +8941,8 @@ mdb_xcursor_init0(MDB_cursor *mc)
 	mx->mx_dbx.md_cmp = mc->mc_dbx->md_dcmp;
 	mx->mx_dbx.md_dcmp = NULL;
 	mx->mx_dbx.md_rel = mc->mc_dbx->md_rel;
+	mx->mx_dbx.md_split = mc->mc_dbx->md_split;
+	mx->mx_dbx.md_merge = mc->mc_dbx->md_merge;
 }
 
 /** Final setup of a sorted-dups cursor.
@@ -6623,6 +9008,7 @@ mdb_cursor_init(MDB_cursor *mc, MDB_txn *txn, MDB_dbi dbi, MDB_xcursor *mx)
 	mc->mc_db = &txn->mt_dbs[dbi];
 	mc->mc_dbx = &txn->mt_dbxs[dbi];
 	mc->mc_dbflag = &txn->mt_dbflags[dbi];
+	mc->mc_kbuf = NULL;
 	mc->mc_snum = 0;
 	mc->mc_top = 0;
 	mc->mc_pg[0] = 0;
@@ -6657,9 +9043,13 @@ mdb_cursor_open(MDB_txn *txn, MDB_dbi dbi, MDB_cursor **ret)
 
 	if (txn->mt_dbs[dbi].md_flags & MDB_DUPSORT)
 		size += sizeof(MDB_xcursor);
+	else if (txn->mt_dbs[dbi].md_flags & MDB_PREFIXKEY)
+		size += ENV_MAXKEY(txn->mt_env);
 
 	if ((mc = malloc(size)) != NULL) {
 		mdb_cursor_init(mc, txn, dbi, (MDB_xcursor *)(mc + 1));
+		if (txn->mt_dbs[dbi].md_flags & MDB_PREFIXKEY)
+			mc->mc_kbuf = (char *)(mc + 1);
 		if (txn->mt_cursors) {
 			mc->mc_next = txn->mt_cursors[dbi];
 			txn->mt_cursors[dbi] = mc;
@@ -6677,13 +9067,17 @@ mdb_cursor_open(MDB_txn *txn, MDB_dbi dbi, MDB_cursor **ret)
 int
 mdb_cursor_renew(MDB_txn *txn, MDB_cursor *mc)
 {
+	char *kbuf;
+
 	if (txn == NULL || mc == NULL || mc->mc_dbi >= txn->mt_numdbs)
 		return EINVAL;
 
 	if ((mc->mc_flags & C_UNTRACK) || txn->mt_cursors)
 		return EINVAL;
 
+	kbuf = mc->mc_kbuf;
 	mdb_cursor_init(mc, txn, mc->mc_dbi, mc->mc_xcursor);
+	mc->mc_kbuf = kbuf;
 	return MDB_SUCCESS;
 }
 
@@ -6763,7 +9157,7 @@ mdb_update_key(MDB_cursor *mc, MDB_val *key)
 #if MDB_DEBUG
 	{
 		MDB_val	k2;
-		char kbuf2[(MDB_MAXKEYSIZE*2+1)];
+		char kbuf2[(DKBUF_MAXKEYSIZE*2+1)];
 		k2.mv_data = NODEKEY(node);
 		k2.mv_size = node->mn_ksize;
 		DPRINTF(("update key %u (ofs %u) [%s] to [%s] on page %"Z"u",
@@ -6822,6 +9216,7 @@ mdb_cursor_copy(const MDB_cursor *csrc, MDB_cursor *cdst);
 static int
 mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 {
+	MDB_env			*env = csrc->mc_txn->mt_env;
 	MDB_node		*srcnode;
 	MDB_val		 key, data;
 	pgno_t	srcpg;
@@ -6859,14 +9254,12 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 				key.mv_data = LEAF2KEY(csrc->mc_pg[csrc->mc_top], 0, key.mv_size);
 			} else {
 				s2 = NODEPTR(csrc->mc_pg[csrc->mc_top], 0);
-				key.mv_size = NODEKSZ(s2);
-				key.mv_data = NODEKEY(s2);
+				mdb_node_key(env, csrc->mc_pg[csrc->mc_top], s2, &key, env->me_kbuf);
 			}
 			csrc->mc_snum = snum--;
 			csrc->mc_top = snum;
 		} else {
-			key.mv_size = NODEKSZ(srcnode);
-			key.mv_data = NODEKEY(srcnode);
+			mdb_node_key(env, csrc->mc_pg[csrc->mc_top], srcnode, &key, env->me_kbuf);
 		}
 		data.mv_size = NODEDSZ(srcnode);
 		data.mv_data = NODEDATA(srcnode);
@@ -6882,8 +9275,8 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 			bkey.mv_data = LEAF2KEY(cdst->mc_pg[cdst->mc_top], 0, bkey.mv_size);
 		} else {
 			s2 = NODEPTR(cdst->mc_pg[cdst->mc_top], 0);
-			bkey.mv_size = NODEKSZ(s2);
-			bkey.mv_data = NODEKEY(s2);
+			mdb_node_key(env, cdst->mc_pg[cdst->mc_top], s2, &bkey,
+				env->me_kbuf + ENV_MAXKEY(env));
 		}
 		cdst->mc_snum = snum--;
 		cdst->mc_top = snum;
@@ -6939,8 +9332,7 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 				key.mv_data = LEAF2KEY(csrc->mc_pg[csrc->mc_top], 0, key.mv_size);
 			} else {
 				srcnode = NODEPTR(csrc->mc_pg[csrc->mc_top], 0);
-				key.mv_size = NODEKSZ(srcnode);
-				key.mv_data = NODEKEY(srcnode);
+				mdb_node_key(env, csrc->mc_pg[csrc->mc_top], srcnode, &key, env->me_kbuf);
 			}
 			DPRINTF(("update separator for source page %"Z"u to [%s]",
 				csrc->mc_pg[csrc->mc_top]->mp_pgno, DKEY(&key)));
@@ -6967,8 +9359,7 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 				key.mv_data = LEAF2KEY(cdst->mc_pg[cdst->mc_top], 0, key.mv_size);
 			} else {
 				srcnode = NODEPTR(cdst->mc_pg[cdst->mc_top], 0);
-				key.mv_size = NODEKSZ(srcnode);
-				key.mv_data = NODEKEY(srcnode);
+				mdb_node_key(env, cdst->mc_pg[cdst->mc_top], srcnode, &key, env->me_kbuf);
 			}
 			DPRINTF(("update separator for destination page %"Z"u to [%s]",
 				cdst->mc_pg[cdst->mc_top]->mp_pgno, DKEY(&key)));
@@ -6992,6 +9383,72 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 	return MDB_SUCCESS;
 }
 
+/** Check whether a node or a whole page fits onto another page.
+ * Keys close to #ENV_MAXKEY() may not fit after rebalancing: the first
+ * node of a branch page has no key, but gets one when it is moved or
+ * a node is inserted before it.
+ * @param[in] csrc Cursor pointing to the source node or page.
+ * @param[in] cdst Cursor pointing to the destination page and index.
+ * @param[in] merge Whether all of the source page is moved.
+ * @return Non-zero if the destination page has room.
+ */
+static int
+mdb_rebalance_fits(MDB_cursor *csrc, MDB_cursor *cdst, int merge)
+{
+	MDB_env		*env = csrc->mc_txn->mt_env;
+	MDB_page	*psrc = csrc->mc_pg[csrc->mc_top];
+	MDB_page	*pdst = cdst->mc_pg[cdst->mc_top];
+	MDB_node	*node;
+	size_t		 room = env->me_psize - PAGEHDRSZ;
+	size_t		 need = room - SIZELEFT(pdst);
+
+	if (IS_LEAF2(psrc))
+		return 1;
+	if (IS_PREFIX(psrc) || IS_PREFIX(pdst)) {
+		/* Keys are stored without the prefix of the page they are on,
+		 * and moving a key may cut the destination page's prefix.
+		 */
+		MDB_val key;
+		unsigned int i = merge ? 0 : csrc->mc_ki[csrc->mc_top];
+		unsigned int n = merge ? NUMKEYS(psrc) : i + 1;
+		unsigned int plen = PAGEPFXSZ(psrc), len = 0, len2;
+
+		if (IS_PREFIX(pdst)) {
+			mdb_node_key(env, psrc, NODEPTR(psrc, i), &key, env->me_kbuf);
+			len = mdb_prefix_match(env, pdst, &key);
+			mdb_node_key(env, psrc, NODEPTR(psrc, n - 1), &key, env->me_kbuf);
+			len2 = mdb_prefix_match(env, pdst, &key);
+			if (len > len2)
+				len = len2;
+			need += mdb_prefix_grow(env, pdst, len);
+		}
+		for (; i < n; i++) {
+			node = NODEPTR(psrc, i);
+			need += EVEN(NODESIZE + plen + NODEKSZ(node) - len +
+				(F_ISSET(node->mn_flags, F_BIGDATA) ? sizeof(pgno_t) : NODEDSZ(node)));
+			need += sizeof(indx_t);
+		}
+		return need <= room;
+	}
+	if (merge) {
+		need += room - SIZELEFT(psrc);
+		if (IS_BRANCH(psrc))
+			need += ENV_MAXKEY(env) + 1;
+	} else {
+		node = NODEPTR(psrc, csrc->mc_ki[csrc->mc_top]);
+		need += NODESIZE + sizeof(indx_t) + 1;
+		if (IS_BRANCH(psrc)) {
+			need += csrc->mc_ki[csrc->mc_top] ? NODEKSZ(node) : ENV_MAXKEY(env);
+			if (!cdst->mc_ki[cdst->mc_top])
+				need += ENV_MAXKEY(env) + 1;
+		} else {
+			need += NODEKSZ(node);
+			need += F_ISSET(node->mn_flags, F_BIGDATA) ? sizeof(pgno_t) : NODEDSZ(node);
+		}
+	}
+	return need <= room;
+}
+
 /** Merge one page into another.
  *  The nodes from the page pointed to by \b csrc will
  *	be copied to the page pointed to by \b cdst and then
@@ -7002,6 +9459,7 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst)
 static int
 mdb_page_merge(MDB_cursor *csrc, MDB_cursor *cdst)
 {
+	MDB_env			*env = csrc->mc_txn->mt_env;
 	int			 rc;
 	indx_t			 i, j;
 	MDB_node		*srcnode;
@@ -7021,6 +9479,19 @@ mdb_page_merge(MDB_cursor *csrc, MDB_cursor *cdst)
 	/* Move all nodes from src to dst.
 	 */
 	j = nkeys = NUMKEYS(cdst->mc_pg[cdst->mc_top]);
+	if (!nkeys && IS_PREFIX(cdst->mc_pg[cdst->mc_top]) &&
+		NUMKEYS(csrc->mc_pg[csrc->mc_top])) {
+		/* Give an empty dst the src keys' prefix, its own may be longer */
+		MDB_page *mp = csrc->mc_pg[csrc->mc_top];
+		MDB_val lkey;
+		unsigned int len;
+		mdb_node_key(env, mp, NODEPTR(mp, 0), &key, env->me_kbuf);
+		mdb_node_key(env, mp, NODEPTR(mp, NUMKEYS(mp) - 1), &lkey,
+			env->me_kbuf + ENV_MAXKEY(env));
+		for (len = 0; len < key.mv_size && len < lkey.mv_size &&
+			((char *)key.mv_data)[len] == ((char *)lkey.mv_data)[len]; len++) ;
+		mdb_prefix_init(env, cdst->mc_pg[cdst->mc_top], &key, len);
+	}
 	if (IS_LEAF2(csrc->mc_pg[csrc->mc_top])) {
 		key.mv_size = csrc->mc_db->md_pad;
 		key.mv_data = METADATA(csrc->mc_pg[csrc->mc_top]);
@@ -7043,14 +9514,12 @@ mdb_page_merge(MDB_cursor *csrc, MDB_cursor *cdst)
 					key.mv_data = LEAF2KEY(csrc->mc_pg[csrc->mc_top], 0, key.mv_size);
 				} else {
 					s2 = NODEPTR(csrc->mc_pg[csrc->mc_top], 0);
-					key.mv_size = NODEKSZ(s2);
-					key.mv_data = NODEKEY(s2);
+					mdb_node_key(env, csrc->mc_pg[csrc->mc_top], s2, &key, env->me_kbuf);
 				}
 				csrc->mc_snum = snum--;
 				csrc->mc_top = snum;
 			} else {
-				key.mv_size = srcnode->mn_ksize;
-				key.mv_data = NODEKEY(srcnode);
+				mdb_node_key(env, csrc->mc_pg[csrc->mc_top], srcnode, &key, env->me_kbuf);
 			}
 
 			data.mv_size = NODEDSZ(srcnode);
@@ -7122,6 +9591,7 @@ mdb_cursor_copy(const MDB_cursor *csrc, MDB_cursor *cdst)
 	cdst->mc_dbi = csrc->mc_dbi;
 	cdst->mc_db  = csrc->mc_db;
 	cdst->mc_dbx = csrc->mc_dbx;
+	cdst->mc_kbuf = csrc->mc_kbuf;
 	cdst->mc_snum = csrc->mc_snum;
 	cdst->mc_top = csrc->mc_top;
 	cdst->mc_flags = csrc->mc_flags;
@@ -7157,7 +9627,7 @@ mdb_rebalance(MDB_cursor *mc)
 	}
 #endif
 
-	if (PAGEFILL(mc->mc_txn->mt_env, mc->mc_pg[mc->mc_top]) >= FILL_THRESHOLD &&
+	if (PAGEFILL(mc->mc_txn->mt_env, mc->mc_pg[mc->mc_top]) >= MERGE_THRESHOLD(mc) &&
 		NUMKEYS(mc->mc_pg[mc->mc_top]) >= minkeys) {
 #if MDB_DEBUG
 		pgno_t pgno;
@@ -7291,9 +9761,18 @@ mdb_rebalance(MDB_cursor *mc)
 	 * (A branch page must never have less than 2 keys.)
 	 */
 	minkeys = 1 + (IS_BRANCH(mn.mc_pg[mn.mc_top]));
-	if (PAGEFILL(mc->mc_txn->mt_env, mn.mc_pg[mn.mc_top]) >= FILL_THRESHOLD && NUMKEYS(mn.mc_pg[mn.mc_top]) > minkeys)
+	if (PAGEFILL(mc->mc_txn->mt_env, mn.mc_pg[mn.mc_top]) >= MERGE_THRESHOLD(mc) && NUMKEYS(mn.mc_pg[mn.mc_top]) > minkeys &&
+		mdb_rebalance_fits(&mn, mc, 0))
 		return mdb_node_move(&mn, mc);
 	else {
+		/* An underfilled page that still has enough keys can stay
+		 * when merging would overflow the page.
+		 */
+		if (NUMKEYS(mc->mc_pg[mc->mc_top]) >= minkeys &&
+			!(mc->mc_ki[ptop] == 0 ? mdb_rebalance_fits(&mn, mc, 1) : mdb_rebalance_fits(mc, &mn, 1))) {
+			DPUTS("no room to rebalance, leaving page underfilled");
+			return MDB_SUCCESS;
+		}
 		if (mc->mc_ki[ptop] == 0)
 			rc = mdb_page_merge(&mn, mc);
 		else {
@@ -7362,67 +9841,363 @@ mdb_cursor_del0(MDB_cursor *mc, MDB_node *leaf)
 		}
 		mc->mc_flags |= C_DEL;
 	}
-
-	return rc;
+
+	return rc;
+}
+
+int
+mdb_del(MDB_txn *txn, MDB_dbi dbi,
+    MDB_val *key, MDB_val *data)
+{
+	MDB_cursor mc;
+	MDB_xcursor mx;
+	MDB_cursor_op op;
+	MDB_val rdata, *xdata;
+	int		 rc, exact;
+	DKBUF;
+
+	assert(key != NULL);
+
+	DPRINTF(("====> delete db %u key [%s]", dbi, DKEY(key)));
+
+	if (txn == NULL || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID))
+		return EINVAL;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_ERROR))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	if (key->mv_size > ENV_MAXKEY(txn->mt_env)) {
+		return MDB_BAD_VALSIZE;
+	}
+
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+
+	exact = 0;
+	if (!F_ISSET(txn->mt_dbs[dbi].md_flags, MDB_DUPSORT)) {
+		/* must ignore any data */
+		data = NULL;
+	}
+	if (data) {
+		op = MDB_GET_BOTH;
+		rdata = *data;
+		xdata = &rdata;
+	} else {
+		op = MDB_SET;
+		xdata = NULL;
+	}
+	rc = mdb_cursor_set(&mc, key, xdata, op, &exact);
+	if (rc == 0) {
+		/* let mdb_page_split know about this cursor if needed:
+		 * delete will trigger a rebalance; if it needs to move
+		 * a node from one page to another, it will have to
+		 * update the parent's separator key(s). If the new sepkey
+		 * is larger than the current one, the parent page may
+		 * run out of space, triggering a split. We need this
+		 * cursor to be consistent until the end of the rebalance.
+		 */
+		mc.mc_flags |= C_UNTRACK;
+		mc.mc_next = txn->mt_cursors[dbi];
+		txn->mt_cursors[dbi] = &mc;
+		rc = mdb_cursor_del(&mc, data ? 0 : MDB_NODUPDATA);
+		txn->mt_cursors[dbi] = mc.mc_next;
+	}
+	return rc;
+}
+
+/** Free a subtree that lies entirely inside a range being deleted.
+ *	As in #mdb_drop0() the pages are only read, never touched, and
+ *	are added to the free list as they are.
+ * @param[in] mc Cursor on the DB, whose sub-DB cursor is used to
+ * free sub-DBs.
+ * @param[in] pgno The root page of the subtree.
+ * @param[in,out] st Counts of the freed pages and entries are added here.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_drop_subtree(MDB_cursor *mc, pgno_t pgno, MDB_db *st)
+{
+	MDB_txn *txn = mc->mc_txn;
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	unsigned int i, n;
+	pgno_t pg;
+	int rc;
+
+	if ((rc = mdb_page_get(txn, pgno, &mp, NULL)) != 0)
+		return rc;
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		st->md_branch_pages++;
+		for (i=0; i<n; i++) {
+			rc = mdb_drop_subtree(mc, NODEPGNO(NODEPTR(mp, i)), st);
+			if (rc)
+				return rc;
+		}
+	} else {
+		st->md_leaf_pages++;
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				memcpy(&pg, NODEDATA(ni), sizeof(pg));
+				rc = mdb_page_get(txn, pg, &omp, NULL);
+				if (rc != 0)
+					return rc;
+				assert(IS_OVERFLOW(omp));
+				st->md_overflow_pages += omp->mp_pages;
+				rc = mdb_midl_append_range(&txn->mt_free_pgs,
+					pg, omp->mp_pages);
+				if (rc)
+					return rc;
+				st->md_entries++;
+			} else if (ni->mn_flags & F_SUBDATA) {
+				mdb_xcursor_init1(mc, ni);
+				rc = mdb_drop0(&mc->mc_xcursor->mx_cursor, 0);
+				if (rc)
+					return rc;
+				st->md_entries += mc->mc_xcursor->mx_db.md_entries;
+			} else if (ni->mn_flags & F_DUPDATA) {
+				st->md_entries += NUMKEYS((MDB_page *)NODEDATA(ni));
+			} else {
+				st->md_entries++;
+			}
+		}
+	}
+	return mdb_midl_append(&txn->mt_free_pgs, pgno);
+}
+
+/** Find the largest subtree that starts at the cursor and ends before a key.
+ *	The subtree rooted at level \b i starts at the cursor if the cursor
+ *	is on the first node of every page from there down. It ends before
+ *	the next separator key above it.
+ * @param[in] mc A cursor on the first key of the range.
+ * @param[in] to The end of the range, or NULL for the end of the DB.
+ * @return The level of the subtree's root, or mc_snum if not even
+ * the cursor's leaf lies inside the range.
+ */
+static unsigned int
+mdb_range_subtree(MDB_cursor *mc, MDB_val *to)
+{
+	unsigned int i, j;
+	MDB_node *node;
+	MDB_val sep;
+
+	for (i = mc->mc_snum; i > 0 && mc->mc_ki[i-1] == 0; i--) ;
+	for (; i < mc->mc_snum; i++) {
+		for (j = i; j > 0; j--) {
+			if (mc->mc_ki[j-1] + 1u < NUMKEYS(mc->mc_pg[j-1]))
+				break;
+		}
+		if (!j) {
+			if (!to)
+				return i;
+			continue;
+		}
+		if (!to)
+			continue;
+		node = NODEPTR(mc->mc_pg[j-1], mc->mc_ki[j-1] + 1);
+		sep.mv_size = NODEKSZ(node);
+		sep.mv_data = NODEKEY(node);
+		if (mc->mc_dbx->md_cmp(&sep, to) <= 0)
+			return i;
+	}
+	return i;
+}
+
+int
+mdb_del_range(MDB_txn *txn, MDB_dbi dbi,
+    MDB_val *from, MDB_val *to, size_t *count)
+{
+	MDB_cursor *mc, *m2;
+	MDB_val key, data;
+	MDB_db st;
+	size_t entries;
+	unsigned int i;
+	int rc, subtree;
+
+	if (txn == NULL || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID))
+		return EINVAL;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_ERROR))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	if ((from && from->mv_size > ENV_MAXKEY(txn->mt_env)) ||
+		(to && to->mv_size > ENV_MAXKEY(txn->mt_env)))
+		return MDB_BAD_VALSIZE;
+
+	if ((rc = mdb_cursor_open(txn, dbi, &mc)) != 0)
+		return rc;
+	entries = txn->mt_dbs[dbi].md_entries;
+	for (;;) {
+		if (from) {
+			key = *from;
+			rc = mdb_cursor_get(mc, &key, &data, MDB_SET_RANGE);
+		} else {
+			rc = mdb_cursor_get(mc, &key, &data, MDB_FIRST);
+		}
+		if (rc)
+			break;
+		if (to && mc->mc_dbx->md_cmp(&key, to) >= 0)
+			break;
+
+		i = mdb_range_subtree(mc, to);
+		if (i == 0) {
+			/* the range covers the whole DB */
+			rc = mdb_drop(txn, dbi, 0);
+			break;
+		}
+		if ((rc = mdb_page_spill(mc, NULL, NULL)) != 0)
+			break;
+		subtree = i < mc->mc_snum;
+		if (subtree) {
+			/* free the subtree, then unlink it from its parent */
+			memset(&st, 0, sizeof(st));
+			rc = mdb_drop_subtree(mc, mc->mc_pg[i]->mp_pgno, &st);
+			if (rc)
+				break;
+			mc->mc_db->md_branch_pages -= st.md_branch_pages;
+			mc->mc_db->md_leaf_pages -= st.md_leaf_pages;
+			mc->mc_db->md_overflow_pages -= st.md_overflow_pages;
+			mc->mc_db->md_entries -= st.md_entries;
+			mc->mc_snum = i;
+			mc->mc_top = i - 1;
+			if ((rc = mdb_cursor_touch(mc)) != 0)
+				break;
+			mdb_node_del(mc->mc_pg[mc->mc_top], mc->mc_ki[mc->mc_top], 0);
+			rc = mdb_rebalance(mc);
+			/* the stack now ends above the leaves */
+			mc->mc_flags &= ~C_INITIALIZED;
+		} else {
+			rc = mdb_cursor_del(mc, MDB_NODUPDATA|MDB_NOSPILL);
+		}
+		if (rc)
+			break;
+	}
+	if (rc == MDB_NOTFOUND)
+		rc = MDB_SUCCESS;
+	if (rc)
+		txn->mt_flags |= MDB_TXN_ERROR;
+	/* cursors may be left on freed pages */
+	for (m2 = txn->mt_cursors[dbi]; m2; m2 = m2->mc_next)
+		m2->mc_flags &= ~(C_INITIALIZED|C_EOF);
+	if (count)
+		*count = entries - txn->mt_dbs[dbi].md_entries;
+	mdb_cursor_close(mc);
+	return rc;
+}
+
+/** Choose the key prefix for one half of a leaf page being split.
+ * This is the prefix shared by the first and last keys of the half,
+ * unless the half doesn't fit on a page with it. Then the prefix of
+ * the page being split is kept.
+ * @param[in] mc Cursor pointing to the page being split.
+ * @param[in] copy The page holding the node offsets in their new order.
+ * @param[in] first The index of the first node of the half.
+ * @param[in] last The index of the last node of the half.
+ * @param[in] newindx The index of the new node.
+ * @param[in] newkey The key for the new node.
+ * @param[in] newdata The data for the new node.
+ * @param[out] key Set to the first key of the half.
+ * @return The length of the prefix.
+ */
+static unsigned int
+mdb_split_prefix(MDB_cursor *mc, MDB_page *copy, int first, int last,
+	int newindx, MDB_val *newkey, MDB_val *newdata, MDB_val *key)
+{
+	MDB_env		*env = mc->mc_txn->mt_env;
+	MDB_page	*mp = mc->mc_pg[mc->mc_top];
+	MDB_node	*node;
+	MDB_val		 lkey;
+	unsigned int	 plen = PAGEPFXSZ(mp), len, sz;
+	size_t		 size;
+	int		 i;
+
+	if (first == newindx)
+		*key = *newkey;
+	else
+		mdb_node_key(env, mp, (MDB_node *)((char *)mp + copy->mp_ptrs[first]),
+			key, env->me_kbuf);
+	if (last == newindx)
+		lkey = *newkey;
+	else
+		mdb_node_key(env, mp, (MDB_node *)((char *)mp + copy->mp_ptrs[last]),
+			&lkey, env->me_kbuf + ENV_MAXKEY(env));
+	sz = key->mv_size < lkey.mv_size ? key->mv_size : lkey.mv_size;
+	for (len = 0; len < sz &&
+		((char *)key->mv_data)[len] == ((char *)lkey.mv_data)[len]; len++) ;
+	if (len <= plen)
+		return len;
+
+	size = EVEN(len);
+	for (i = first; i <= last; i++) {
+		if (i == newindx) {
+			sz = NODESIZE + newkey->mv_size + newdata->mv_size >= env->me_nodemax ?
+				sizeof(pgno_t) : newdata->mv_size;
+			size += EVEN(NODESIZE + newkey->mv_size - len + sz);
+		} else {
+			node = (MDB_node *)((char *)mp + copy->mp_ptrs[i]);
+			sz = F_ISSET(node->mn_flags, F_BIGDATA) ? sizeof(pgno_t) : NODEDSZ(node);
+			size += EVEN(NODESIZE + plen + NODEKSZ(node) - len + sz);
+		}
+		size += sizeof(indx_t);
+	}
+	return size > env->me_psize - PAGEHDRSZ ? plen : len;
 }
 
-int
-mdb_del(MDB_txn *txn, MDB_dbi dbi,
-    MDB_val *key, MDB_val *data)
+/** Shorten a separator key for a branch page.
+ * With #mdb_cmp_memn() ordering a separator only needs to sort after
+ * the last key of the left page, so the first key of the right page
+ * is cut after the first byte where the two differ.
+ * @param[in] prev The last key of the left page.
+ * @param[in,out] sep The first key of the right page.
+ */
+static void
+mdb_sep_truncate(MDB_val *prev, MDB_val *sep)
 {
-	MDB_cursor mc;
-	MDB_xcursor mx;
-	MDB_cursor_op op;
-	MDB_val rdata, *xdata;
-	int		 rc, exact;
-	DKBUF;
-
-	assert(key != NULL);
-
-	DPRINTF(("====> delete db %u key [%s]", dbi, DKEY(key)));
-
-	if (txn == NULL || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID))
-		return EINVAL;
-
-	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_ERROR))
-		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
-
-	if (key->mv_size > MDB_MAXKEYSIZE) {
-		return MDB_BAD_VALSIZE;
-	}
+	size_t i, n = prev->mv_size < sep->mv_size ? prev->mv_size : sep->mv_size;
 
-	mdb_cursor_init(&mc, txn, dbi, &mx);
+	for (i = 0; i < n &&
+		((char *)prev->mv_data)[i] == ((char *)sep->mv_data)[i]; i++) ;
+	if (i < sep->mv_size)
+		sep->mv_size = i + 1;
+}
 
-	exact = 0;
-	if (!F_ISSET(txn->mt_dbs[dbi].md_flags, MDB_DUPSORT)) {
-		/* must ignore any data */
-		data = NULL;
-	}
-	if (data) {
-		op = MDB_GET_BOTH;
-		rdata = *data;
-		xdata = &rdata;
-	} else {
-		op = MDB_SET;
-		xdata = NULL;
+/** Find the split point of a leaf page for the database's split fill.
+ * @param[in] mc Cursor pointing to the page.
+ * @param[in] copy The node offsets of the page with a slot for the new node.
+ * @param[in] nkeys The number of nodes on the page.
+ * @param[in] newindx The index of the new node.
+ * @param[in] nsize The size of the new node.
+ * @param[in] pmax The room on an empty page.
+ * @return The index of the first node to move to the right page.
+ */
+static int
+mdb_split_point(MDB_cursor *mc, MDB_page *copy, int nkeys, int newindx,
+	int nsize, int pmax)
+{
+	MDB_page	*mp = mc->mc_pg[mc->mc_top];
+	MDB_node	*node;
+	int		 i, sz, lsize = 0, total = 0, target;
+
+#define SPLIT_SIZE(i)	((i) == newindx ? nsize : \
+	(node = (MDB_node *)((char *)mp + copy->mp_ptrs[i]), \
+	 (int)EVEN(NODESIZE + NODEKSZ(node) + (F_ISSET(node->mn_flags, F_BIGDATA) ? \
+		sizeof(pgno_t) : NODEDSZ(node))) + (int)sizeof(indx_t)))
+	for (i = 0; i <= nkeys; i++)
+		total += SPLIT_SIZE(i);
+	target = (long)total * mc->mc_dbx->md_split / 1000;
+	for (i = 0; i < nkeys; i++) {
+		sz = SPLIT_SIZE(i);
+		if (i && (lsize + sz > target || lsize + sz > pmax))
+			break;
+		lsize += sz;
 	}
-	rc = mdb_cursor_set(&mc, key, xdata, op, &exact);
-	if (rc == 0) {
-		/* let mdb_page_split know about this cursor if needed:
-		 * delete will trigger a rebalance; if it needs to move
-		 * a node from one page to another, it will have to
-		 * update the parent's separator key(s). If the new sepkey
-		 * is larger than the current one, the parent page may
-		 * run out of space, triggering a split. We need this
-		 * cursor to be consistent until the end of the rebalance.
-		 */
-		mc.mc_flags |= C_UNTRACK;
-		mc.mc_next = txn->mt_cursors[dbi];
-		txn->mt_cursors[dbi] = &mc;
-		rc = mdb_cursor_del(&mc, data ? 0 : MDB_NODUPDATA);
-		txn->mt_cursors[dbi] = mc.mc_next;
+	/* Both halves must fit */
+	while (total - lsize > pmax && i < nkeys) {
+		lsize += SPLIT_SIZE(i);
+		i++;
 	}
-	return rc;
+#undef SPLIT_SIZE
+	return i;
 }
 
 /** Split a page and insert a new node.
@@ -7506,6 +10281,12 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		sepkey = *newkey;
 		split_indx = newindx;
 		nkeys = 0;
+		if (IS_LEAF(mp) && !IS_LEAF2(mp) && NUMKEYS(mp) &&
+			mc->mc_dbx->md_cmp == mdb_cmp_memn) {
+			node = NODEPTR(mp, NUMKEYS(mp) - 1);
+			mdb_node_key(env, mp, node, &rkey, env->me_kbuf);
+			mdb_sep_truncate(&rkey, &sepkey);
+		}
 	} else {
 
 		split_indx = (nkeys+1) / 2;
@@ -7516,6 +10297,13 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			unsigned int lsize, rsize, ksize;
 			/* Move half of the keys to the right sibling */
 			copy = NULL;
+			if (mc->mc_dbx->md_split && nkeys > 1) {
+				split_indx = (nkeys + 1) * mc->mc_dbx->md_split / 1000;
+				if (split_indx < 1)
+					split_indx = 1;
+				else if (split_indx > nkeys - 1)
+					split_indx = nkeys - 1;
+			}
 			x = mc->mc_ki[mc->mc_top] - split_indx;
 			ksize = mc->mc_db->md_pad;
 			split = LEAF2KEY(mp, split_indx, ksize);
@@ -7553,7 +10341,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		} else {
 			int psize, nsize, k;
 			/* Maximum free space in an empty page */
-			pmax = env->me_psize - PAGEHDRSZ;
+			pmax = env->me_psize - PAGEHDRSZ - EVEN(PAGEPFXSZ(mp));
 			if (IS_LEAF(mp))
 				nsize = mdb_leaf_size(env, newkey, newdata);
 			else
@@ -7592,12 +10380,20 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			 * the split so the new page is emptier than the old page.
 			 * This yields better packing during sequential inserts.
 			 */
-			if (nkeys < 20 || nsize > pmax/16 || newindx >= nkeys) {
+			if (PAGEPFXSZ(mp) && mdb_prefix_match(env, mp, newkey) < mp->mp_pad) {
+				/* The new key sorts before or after all others. Give it
+				 * a page of its own instead of cutting the key prefix.
+				 */
+				assert(newindx == 0 || newindx == nkeys);
+				split_indx = newindx ? nkeys : 1;
+			} else if (IS_LEAF(mp) && mc->mc_dbx->md_split && newindx < nkeys) {
+				split_indx = mdb_split_point(mc, copy, nkeys, newindx, nsize, pmax);
+			} else if (nkeys < 32 || nsize > pmax/16 || newindx >= nkeys) {
 				/* Find split point */
 				psize = 0;
 				if (newindx <= split_indx || newindx >= nkeys) {
 					i = 0; j = 1;
-					k = newindx >= nkeys ? nkeys : split_indx+2;
+					k = newindx >= nkeys ? nkeys : split_indx+1+IS_LEAF(mp);
 				} else {
 					i = nkeys; j = -1;
 					k = split_indx-1;
@@ -7628,8 +10424,18 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 				sepkey.mv_data = newkey->mv_data;
 			} else {
 				node = (MDB_node *)((char *)mp + copy->mp_ptrs[split_indx]);
-				sepkey.mv_size = node->mn_ksize;
-				sepkey.mv_data = NODEKEY(node);
+				mdb_node_key(env, mp, node, &sepkey, env->me_kbuf);
+			}
+			if (IS_LEAF(mp) && split_indx > 0 &&
+				mc->mc_dbx->md_cmp == mdb_cmp_memn) {
+				if (split_indx - 1 == newindx) {
+					rkey = *newkey;
+				} else {
+					node = (MDB_node *)((char *)mp + copy->mp_ptrs[split_indx - 1]);
+					mdb_node_key(env, mp, node, &rkey,
+						env->me_kbuf + ENV_MAXKEY(env));
+				}
+				mdb_sep_truncate(&rkey, &sepkey);
 			}
 		}
 	}
@@ -7678,12 +10484,25 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 	if (nflags & MDB_APPEND) {
 		mc->mc_pg[mc->mc_top] = rp;
 		mc->mc_ki[mc->mc_top] = 0;
+		if (IS_PREFIX(rp))
+			mdb_prefix_init(env, rp, newkey, newkey->mv_size);
 		rc = mdb_node_add(mc, 0, newkey, newdata, newpgno, nflags);
 		if (rc)
 			return rc;
 		for (i=0; i<mc->mc_top; i++)
 			mc->mc_ki[i] = mn.mc_ki[i];
 	} else if (!IS_LEAF2(mp)) {
+		/* Give both halves the longest key prefix they share */
+		if (IS_PREFIX(rp)) {
+			j = mdb_split_prefix(mc, copy, split_indx, nkeys, newindx,
+				newkey, newdata, &rkey);
+			mdb_prefix_init(env, rp, &rkey, j);
+		}
+		if (IS_PREFIX(copy)) {
+			j = mdb_split_prefix(mc, copy, 0, split_indx - 1, newindx,
+				newkey, newdata, &rkey);
+			mdb_prefix_init(env, copy, &rkey, j);
+		}
 		/* Move nodes */
 		mc->mc_pg[mc->mc_top] = rp;
 		i = split_indx;
@@ -7701,8 +10520,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 				mc->mc_ki[mc->mc_top] = j;
 			} else {
 				node = (MDB_node *)((char *)mp + copy->mp_ptrs[i]);
-				rkey.mv_data = NODEKEY(node);
-				rkey.mv_size = node->mn_ksize;
+				mdb_node_key(env, mp, node, &rkey, env->me_kbuf);
 				if (IS_LEAF(mp)) {
 					xdata.mv_data = NODEDATA(node);
 					xdata.mv_size = NODEDSZ(node);
@@ -7738,6 +10556,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			mp->mp_ptrs[i] = copy->mp_ptrs[i];
 		mp->mp_lower = copy->mp_lower;
 		mp->mp_upper = copy->mp_upper;
+		mp->mp_pad = copy->mp_pad;
 		memcpy(NODEPTR(mp, nkeys-1), NODEPTR(copy, nkeys-1),
 			env->me_psize - copy->mp_upper);
 
@@ -7815,6 +10634,19 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			}
 		}
 	}
+	if (did_split && IS_LEAF(mc->mc_pg[mc->mc_top])) {
+		/* The split went up past the parent, and the fixups above only
+		 * keep the separator's path right. Look the new key up again
+		 * so the levels above the leaf lead back to it.
+		 */
+		MDB_page *lp = mc->mc_pg[mc->mc_top];
+		indx_t li = mc->mc_ki[mc->mc_top];
+		rc = mdb_page_search(mc, newkey, 0);
+		if (rc == MDB_SUCCESS) {
+			assert(mc->mc_pg[mc->mc_top] == lp);
+			mc->mc_ki[mc->mc_top] = li;
+		}
+	}
 	DPRINTF(("mp left: %d, rp left: %d", SIZELEFT(mp), SIZELEFT(rp)));
 	return rc;
 }
@@ -7973,18 +10805,27 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 
 	if ((flags & VALID_FLAGS) != flags)
 		return EINVAL;
+	if ((flags & MDB_PREFIXKEY) && (flags & (MDB_DUPSORT|MDB_INTEGERKEY|MDB_REVERSEKEY)))
+		return EINVAL;
 	if (txn->mt_flags & MDB_TXN_ERROR)
 		return MDB_BAD_TXN;
 
 	/* main DB? */
 	if (!name) {
 		*dbi = MAIN_DBI;
+		if (txn->mt_dbs[MAIN_DBI].md_flags & ~KNOWN_FLAGS)
+			return MDB_INCOMPATIBLE;
+		if ((flags & MDB_PREFIXKEY) && (txn->mt_dbs[MAIN_DBI].md_flags &
+			(MDB_DUPSORT|MDB_INTEGERKEY|MDB_REVERSEKEY)))
+			return MDB_INCOMPATIBLE;
 		if (flags & PERSISTENT_FLAGS) {
 			uint16_t f2 = flags & PERSISTENT_FLAGS;
 			/* make sure flag changes get committed */
 			if ((txn->mt_dbs[MAIN_DBI].md_flags | f2) != txn->mt_dbs[MAIN_DBI].md_flags) {
 				txn->mt_dbs[MAIN_DBI].md_flags |= f2;
 				txn->mt_flags |= MDB_TXN_DIRTY;
+				if (f2 & MDB_PREFIXKEY)
+					txn->mt_flags |= MDB_TXN_PREFIXKEY;
 			}
 		}
 		mdb_default_cmp(txn, MAIN_DBI);
@@ -8028,8 +10869,13 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 	if (rc == MDB_SUCCESS) {
 		/* make sure this is actually a DB */
 		MDB_node *node = NODEPTR(mc.mc_pg[mc.mc_top], mc.mc_ki[mc.mc_top]);
+		uint16_t f2;
 		if (!(node->mn_flags & F_SUBDATA))
 			return MDB_INCOMPATIBLE;
+		/* refuse DBs written with flags we don't understand */
+		memcpy(&f2, (char *)data.mv_data + offsetof(MDB_db, md_flags), sizeof(f2));
+		if (f2 & ~KNOWN_FLAGS)
+			return MDB_INCOMPATIBLE;
 	} else if (rc == MDB_NOTFOUND && (flags & MDB_CREATE)) {
 		/* Create if requested */
 		MDB_db dummy;
@@ -8040,6 +10886,8 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 		dummy.md_flags = flags & PERSISTENT_FLAGS;
 		rc = mdb_cursor_put(&mc, &key, &data, F_SUBDATA);
 		dbflag |= DB_DIRTY;
+		if (flags & MDB_PREFIXKEY)
+			txn->mt_flags |= MDB_TXN_PREFIXKEY;
 	}
 
 	/* OK, got info, add to table */
@@ -8048,6 +10896,8 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 		txn->mt_dbxs[slot].md_name.mv_data = strdup(name);
 		txn->mt_dbxs[slot].md_name.mv_size = len;
 		txn->mt_dbxs[slot].md_rel = NULL;
+		txn->mt_dbxs[slot].md_split = 0;
+		txn->mt_dbxs[slot].md_merge = 0;
 		txn->mt_dbflags[slot] = dbflag;
 		memcpy(&txn->mt_dbs[slot], data.mv_data, sizeof(MDB_db));
 		*dbi = slot;
@@ -8074,6 +10924,134 @@ int mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *arg)
 	return mdb_stat0(txn->mt_env, &txn->mt_dbs[dbi], arg);
 }
 
+/** Add the pages of a subtree to a fill histogram.
+ * @param[in] txn The transaction to read the pages in.
+ * @param[in] pgno The root page of the subtree.
+ * @param[in] buckets The number of fill ranges.
+ * @param[in,out] leaf The counters for leaf pages.
+ * @param[in,out] branch The counters for branch pages.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_fill0(MDB_txn *txn, pgno_t pgno, unsigned int buckets, size_t *leaf, size_t *branch)
+{
+	MDB_page *mp;
+	unsigned int i, b;
+	int rc;
+
+	if ((rc = mdb_page_get(txn, pgno, &mp, NULL)))
+		return rc;
+	b = PAGEFILL(txn->mt_env, mp) * buckets / 1000;
+	if (b >= buckets)
+		b = buckets - 1;
+	if (IS_LEAF(mp)) {
+		leaf[b]++;
+		return MDB_SUCCESS;
+	}
+	branch[b]++;
+	for (i = 0; i < NUMKEYS(mp); i++) {
+		if ((rc = mdb_page_fill0(txn, NODEPGNO(NODEPTR(mp, i)), buckets, leaf, branch)))
+			return rc;
+	}
+	return MDB_SUCCESS;
+}
+
+int mdb_page_fill(MDB_txn *txn, MDB_dbi dbi, unsigned int buckets, size_t *leaf, size_t *branch)
+{
+	if (txn == NULL || leaf == NULL || branch == NULL || dbi >= txn->mt_numdbs ||
+		!buckets || buckets > 1000)
+		return EINVAL;
+
+	if (txn->mt_dbflags[dbi] & DB_STALE) {
+		MDB_cursor mc;
+		MDB_xcursor mx;
+		mdb_cursor_init(&mc, txn, dbi, &mx);
+	}
+	memset(leaf, 0, buckets * sizeof(size_t));
+	memset(branch, 0, buckets * sizeof(size_t));
+	if (txn->mt_dbs[dbi].md_root == P_INVALID)
+		return MDB_SUCCESS;
+	return mdb_page_fill0(txn, txn->mt_dbs[dbi].md_root, buckets, leaf, branch);
+}
+
+/** Estimate the share of a DB's entries that sort before a key.
+ *	Each level of the tree narrows the key down to its child's share
+ *	of the page, taking all the children of a page to be the same size.
+ * @param[in] mc A cursor on the DB.
+ * @param[in] key The key to look up.
+ * @param[out] pos The share of the entries before the key, from 0 to 1.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_range_pos(MDB_cursor *mc, MDB_val *key, double *pos)
+{
+	double share = 1.0;
+	unsigned int i, n;
+	int rc;
+
+	*pos = 0;
+	if ((rc = mdb_page_search(mc, key, 0)) != MDB_SUCCESS)
+		return rc;
+	mdb_node_search(mc, key, NULL);
+	for (i = 0; i < mc->mc_snum; i++) {
+		n = NUMKEYS(mc->mc_pg[i]);
+		share /= n;
+		*pos += share * mc->mc_ki[i];
+	}
+	return MDB_SUCCESS;
+}
+
+int mdb_estimate_range(MDB_txn *txn, MDB_dbi dbi, MDB_val *from, MDB_val *to, MDB_stat *stat)
+{
+	MDB_cursor mc;
+	MDB_xcursor mx;
+	MDB_db *db;
+	MDB_page *leaf = NULL;
+	indx_t ki = 0;
+	double lo = 0, hi = 1, share;
+	int rc;
+
+	if (txn == NULL || stat == NULL || !dbi || dbi >= txn->mt_numdbs ||
+		!(txn->mt_dbflags[dbi] & DB_VALID))
+		return EINVAL;
+
+	if ((from && from->mv_size > ENV_MAXKEY(txn->mt_env)) ||
+		(to && to->mv_size > ENV_MAXKEY(txn->mt_env)))
+		return MDB_BAD_VALSIZE;
+
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+	db = mc.mc_db;
+	memset(stat, 0, sizeof(*stat));
+	stat->ms_psize = txn->mt_env->me_psize;
+	stat->ms_depth = db->md_depth;
+	if (db->md_root == P_INVALID)
+		return MDB_SUCCESS;
+
+	if (from) {
+		if ((rc = mdb_range_pos(&mc, from, &lo)) != MDB_SUCCESS)
+			return rc;
+		leaf = mc.mc_pg[mc.mc_top];
+		ki = mc.mc_ki[mc.mc_top];
+	}
+	if (to && (rc = mdb_range_pos(&mc, to, &hi)) != MDB_SUCCESS)
+		return rc;
+	share = hi > lo ? hi - lo : 0;
+
+	stat->ms_branch_pages = share * db->md_branch_pages + 0.5;
+	stat->ms_leaf_pages = share * db->md_leaf_pages + 0.5;
+	stat->ms_overflow_pages = share * db->md_overflow_pages + 0.5;
+	if (leaf == mc.mc_pg[mc.mc_top] && to && !(db->md_flags & MDB_DUPSORT)) {
+		/* both ends are on one leaf, whose keys can just be counted */
+		stat->ms_entries = mc.mc_ki[mc.mc_top] > ki ? mc.mc_ki[mc.mc_top] - ki : 0;
+		stat->ms_leaf_pages = stat->ms_entries != 0;
+		return MDB_SUCCESS;
+	}
+	stat->ms_entries = share * db->md_entries + 0.5;
+	if (stat->ms_entries && !stat->ms_leaf_pages)
+		stat->ms_leaf_pages = 1;
+	return MDB_SUCCESS;
+}
+
 void mdb_dbi_close(MDB_env *env, MDB_dbi dbi)
 {
 	char *ptr;
@@ -8223,10 +11201,247 @@ leave:
 	return rc;
 }
 
+/** State for a bottom-up bulk load into an empty database.
+ *	The cursor holds the rightmost page of every level of the tree
+ *	being built, root at index 0 and the current leaf on top. Pages
+ *	to the left of the cursor are complete and are never touched
+ *	again, so they may be spilled to disk as the load proceeds.
+ */
+struct MDB_loader {
+	MDB_cursor	ml_cursor;	/**< rightmost page of each level */
+	MDB_db		ml_db;		/**< the tree under construction */
+	unsigned int	ml_fill;	/**< page fill target, in tenths of a percent */
+	unsigned int	ml_dirty;	/**< spill completed pages beyond this many dirty pages */
+};
+
+/** Add a root branch page above the current tree.
+ * @param[in] ml The loader to operate on.
+ * @param[in] pgno The page number of the old root.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_loader_grow(MDB_loader *ml, pgno_t pgno)
+{
+	MDB_cursor *mc = &ml->ml_cursor;
+	MDB_page *np;
+	int rc;
+
+	if (mc->mc_snum >= CURSOR_STACK)
+		return MDB_CURSOR_FULL;
+	if ((rc = mdb_page_new(mc, P_BRANCH, 1, &np)))
+		return rc;
+	memmove(mc->mc_pg + 1, mc->mc_pg, mc->mc_snum * sizeof(MDB_page *));
+	memmove(mc->mc_ki + 1, mc->mc_ki, mc->mc_snum * sizeof(indx_t));
+	mc->mc_pg[0] = np;
+	mc->mc_ki[0] = 0;
+	mc->mc_snum++;
+	mc->mc_top = 0;
+	ml->ml_db.md_depth++;
+	return mdb_node_add(mc, 0, NULL, NULL, pgno, 0);
+}
+
+/** Append a node to the rightmost page of one level of a loader's tree.
+ *	When that page has reached the fill target a new right sibling
+ *	is started and linked into the level above. A new branch page
+ *	takes over the last child of its left neighbour so that no
+ *	branch page is ever left with a single key.
+ * @param[in] ml The loader to operate on.
+ * @param[in] level The level to append to, 0 for the leaves.
+ * @param[in] key The key for the new node.
+ * @param[in] data The data for a leaf node, NULL for a branch node.
+ * @param[in] pgno The child page number for a branch node.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_loader_add(MDB_loader *ml, unsigned int level, MDB_val *key, MDB_val *data, pgno_t pgno)
+{
+	MDB_cursor *mc = &ml->ml_cursor;
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page *mp, *np;
+	MDB_node *node;
+	MDB_val lkey;
+	pgno_t lpgno = P_INVALID;
+	size_t nsize, room = env->me_psize - PAGEHDRSZ;
+	char *kbuf = NULL;
+	int rc;
+
+	if (level < mc->mc_snum) {
+		mp = mc->mc_pg[mc->mc_snum - 1 - level];
+		nsize = level ? mdb_branch_size(env, key) : mdb_leaf_size(env, key, data);
+		if (IS_PREFIX(mp))
+			nsize = mdb_prefix_size(env, mp, key, nsize);
+		if (NUMKEYS(mp) < (level ? 3 : 1) || (nsize <= SIZELEFT(mp) &&
+			(room - SIZELEFT(mp) + nsize) * 1000 <= ml->ml_fill * room)) {
+			mc->mc_top = mc->mc_snum - 1 - level;
+			mc->mc_ki[mc->mc_top] = NUMKEYS(mp);
+			return mdb_node_add(mc, NUMKEYS(mp), key, data, pgno, 0);
+		}
+	} else {
+		mp = NULL;
+	}
+
+	if ((rc = mdb_page_new(mc, level ? P_BRANCH : P_LEAF, 1, &np)))
+		return rc;
+
+	if (!mp) {
+		/* very first leaf page */
+		mdb_cursor_push(mc, np);
+		ml->ml_db.md_depth = 1;
+	} else {
+		if (level) {
+			/* move the last child of mp to the new page */
+			node = NODEPTR(mp, NUMKEYS(mp) - 1);
+			lkey.mv_size = NODEKSZ(node);
+			if ((kbuf = malloc(lkey.mv_size)) == NULL)
+				return ENOMEM;
+			lkey.mv_data = memcpy(kbuf, NODEKEY(node), lkey.mv_size);
+			lpgno = NODEPGNO(node);
+			mdb_node_del(mp, NUMKEYS(mp) - 1, 0);
+		} else {
+			lkey = *key;
+			if (mc->mc_dbx->md_cmp == mdb_cmp_memn) {
+				MDB_val pkey;
+				node = NODEPTR(mp, NUMKEYS(mp) - 1);
+				mdb_node_key(env, mp, node, &pkey, env->me_kbuf);
+				mdb_sep_truncate(&pkey, &lkey);
+			}
+		}
+		rc = MDB_SUCCESS;
+		if (level + 1 == mc->mc_snum)
+			rc = mdb_loader_grow(ml, mp->mp_pgno);
+		if (rc == MDB_SUCCESS)
+			rc = mdb_loader_add(ml, level + 1, &lkey, NULL, np->mp_pgno);
+		free(kbuf);
+		if (rc)
+			return rc;
+		mc->mc_pg[mc->mc_snum - 1 - level] = np;
+	}
+	mc->mc_top = mc->mc_snum - 1 - level;
+	mc->mc_ki[mc->mc_top] = 0;
+
+	if (!level) {
+		/* Keys arrive in order, so the prefix only gets shorter */
+		if (IS_PREFIX(np))
+			mdb_prefix_init(env, np, key, key->mv_size);
+		return mdb_node_add(mc, 0, key, data, 0, 0);
+	}
+	if ((rc = mdb_node_add(mc, 0, NULL, NULL, lpgno, 0)))
+		return rc;
+	mc->mc_ki[mc->mc_top] = 1;
+	return mdb_node_add(mc, 1, key, NULL, pgno, 0);
+}
+
+int
+mdb_loader_open(MDB_txn *txn, MDB_dbi dbi, unsigned int fill, MDB_loader **ret)
+{
+	MDB_loader *ml;
+
+	if (!txn || !ret || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID) ||
+		!fill || fill > 1000)
+		return EINVAL;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_ERROR))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	if (txn->mt_dbs[dbi].md_flags & MDB_DUPSORT)
+		return MDB_INCOMPATIBLE;
+
+	if (txn->mt_dbs[dbi].md_root != P_INVALID)
+		return EINVAL;
+
+	if ((ml = malloc(sizeof(MDB_loader))) == NULL)
+		return ENOMEM;
+
+	mdb_cursor_init(&ml->ml_cursor, txn, dbi, NULL);
+	ml->ml_db = txn->mt_dbs[dbi];
+	ml->ml_cursor.mc_db = &ml->ml_db;
+	/* Let mdb_page_spill() see the pages we are still filling */
+	ml->ml_cursor.mc_flags |= C_INITIALIZED;
+	ml->ml_fill = fill;
+	ml->ml_dirty = 0;
+
+	*ret = ml;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_loader_set_dirty(MDB_loader *ml, unsigned int pages)
+{
+	if (!ml || pages > ml->ml_cursor.mc_txn->mt_env->me_maxdirty)
+		return EINVAL;
+
+	ml->ml_dirty = pages;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_loader_put(MDB_loader *ml, MDB_val *key, MDB_val *data)
+{
+	MDB_cursor *mc = &ml->ml_cursor;
+	MDB_page *mp;
+	MDB_node *leaf;
+	int rc;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_ERROR)
+		return MDB_BAD_TXN;
+
+	if (key->mv_size == 0 || key->mv_size > ENV_MAXKEY(mc->mc_txn->mt_env))
+		return MDB_BAD_VALSIZE;
+
+#if SIZE_MAX > MAXDATASIZE
+	if (data->mv_size > MAXDATASIZE)
+		return MDB_BAD_VALSIZE;
+#endif
+
+	/* Keys must arrive in strictly ascending order */
+	if (mc->mc_snum) {
+		mp = mc->mc_pg[mc->mc_snum - 1];
+		leaf = NODEPTR(mp, NUMKEYS(mp) - 1);
+		if (mdb_node_cmp(mc, mp, leaf, key) <= 0)
+			return MDB_KEYEXIST;
+	}
+
+	if (ml->ml_dirty && mc->mc_txn->mt_u.dirty_list[0].mid >= ml->ml_dirty)
+		rc = mdb_pages_spill(mc, mc->mc_txn->mt_env->me_maxdirty);
+	else
+		rc = mdb_page_spill(mc, key, data);
+	if (rc || (rc = mdb_loader_add(ml, 0, key, data, 0))) {
+		mc->mc_txn->mt_flags |= MDB_TXN_ERROR;
+		return rc;
+	}
+	ml->ml_db.md_entries++;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_loader_close(MDB_loader *ml, int commit)
+{
+	MDB_cursor *mc = &ml->ml_cursor;
+	MDB_txn *txn = mc->mc_txn;
+	int rc = MDB_SUCCESS;
+
+	if (txn->mt_flags & MDB_TXN_ERROR) {
+		rc = MDB_BAD_TXN;
+	} else if (mc->mc_snum) {
+		if (commit) {
+			ml->ml_db.md_root = mc->mc_pg[0]->mp_pgno;
+			txn->mt_dbs[mc->mc_dbi] = ml->ml_db;
+			txn->mt_dbflags[mc->mc_dbi] |= DB_DIRTY;
+		} else {
+			/* The pages we built are unreachable now */
+			txn->mt_flags |= MDB_TXN_ERROR;
+		}
+	}
+	free(ml);
+	return rc;
+}
+
 int mdb_set_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp)
 {
 	if (txn == NULL || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID))
 		return EINVAL;
+	if (txn->mt_dbs[dbi].md_flags & MDB_PREFIXKEY)
+		return MDB_INCOMPATIBLE;
 
 	txn->mt_dbxs[dbi].md_cmp = cmp;
 	return MDB_SUCCESS;
@@ -8259,9 +11474,25 @@ int mdb_set_relctx(MDB_txn *txn, MDB_dbi dbi, void *ctx)
 	return MDB_SUCCESS;
 }
 
+int mdb_set_fill(MDB_txn *txn, MDB_dbi dbi, unsigned int split, unsigned int merge)
+{
+	if (txn == NULL || !dbi || dbi >= txn->mt_numdbs || !(txn->mt_dbflags[dbi] & DB_VALID))
+		return EINVAL;
+	if (split >= 1000 || merge > 500)
+		return EINVAL;
+	/* Both halves of a split must start out above the merge threshold */
+	if (split && (split < (merge ? merge : FILL_THRESHOLD) ||
+		1000 - split < (merge ? merge : FILL_THRESHOLD)))
+		return EINVAL;
+
+	txn->mt_dbxs[dbi].md_split = split;
+	txn->mt_dbxs[dbi].md_merge = merge;
+	return MDB_SUCCESS;
+}
+
 int mdb_env_get_maxkeysize(MDB_env *env)
 {
-	return MDB_MAXKEYSIZE;
+	return ENV_MAXKEY(env);
 }
 
 int mdb_reader_list(MDB_env *env, MDB_msg_func *func, void *ctx)
@@ -129,6 +129,12 @@ static void transaction_finish(VALUE self, int commit) {
 static VALUE call_with_transaction_helper(VALUE arg) {
         #error "Not implemented"
 }
+#elif defined(HAVE_RB_FUNCALL_PASSING_BLOCK_KW)
+// Ruby 3 does not treat a trailing hash as keywords unless told so
+static VALUE call_with_transaction_helper(VALUE arg) {
+        HelperArgs* a = (HelperArgs*)arg;
+        return rb_funcall_passing_block_kw(a->self, rb_intern(a->name), a->argc, a->argv, RB_PASS_CALLED_KEYWORDS);
+}
 #else
 static VALUE call_with_transaction_helper(VALUE arg) {
         HelperArgs* a = (HelperArgs*)arg;
@@ -144,14 +150,24 @@ static VALUE call_with_transaction(VALUE venv, VALUE self, const char* name, int
 static VALUE with_transaction(VALUE venv, VALUE(*fn)(VALUE), VALUE arg, int flags) {
         ENVIRONMENT(venv, environment);
 
+        MDB_txn* parent = active_txn(venv);
+        if (environment->group_commit && !parent && !(flags & MDB_RDONLY))
+                return group_transaction(venv, fn, arg);
+        return run_transaction(venv, parent, fn, arg, flags);
+}
+
+static VALUE run_transaction(VALUE venv, MDB_txn* parent, VALUE(*fn)(VALUE), VALUE arg, int flags) {
+        ENVIRONMENT(venv, environment);
+
         MDB_txn* txn;
-        check(mdb_txn_begin(environment->env, active_txn(venv), flags, &txn));
+        check(mdb_txn_begin(environment->env, parent, flags, &txn));
 
         Transaction* transaction;
         VALUE vtxn = Data_Make_Struct(cTransaction, Transaction, transaction_mark, transaction_free, transaction);
         transaction->parent = environment_active_txn(venv);
         transaction->env = venv;
         transaction->txn = txn;
+        transaction->flags = flags;
         transaction->thread = rb_thread_current();
         environment_set_active_txn(venv, transaction->thread, vtxn);
 
@@ -168,6 +184,191 @@ static VALUE with_transaction(VALUE venv, VALUE(*fn)(VALUE), VALUE arg, int flag
         return ret;
 }
 
+/*
+ * Group commit
+ *
+ * Top-level write transactions of an environment opened with
+ * :group_commit join a batch. The first caller to arrive leads the
+ * batch: it begins one LMDB write transaction, and every member runs
+ * its block in a nested transaction of it, one at a time, each in its
+ * own thread. A block that raises only aborts its own nested
+ * transaction. Once all members are through, the leader commits, and
+ * every member returns when that commit is durable.
+ *
+ * The leader begins and commits without the GVL, so callers arriving
+ * while a batch is being written out gather in the next one. Batch
+ * state is only touched with the GVL held, which is all the locking
+ * it needs; waiting threads sleep until the state changes.
+ */
+
+static VALUE group_sleep(VALUE unused) {
+        rb_thread_sleep_forever();
+        return Qnil;
+}
+
+static VALUE group_unwait(VALUE venv) {
+        ENVIRONMENT(venv, environment);
+        VALUE waiters = environment->group_waiters, thread = rb_thread_current();
+        long i;
+        // Not rb_ary_delete, which yields to our caller's block if the
+        // thread was already woken
+        for (i = 0; i < RARRAY_LEN(waiters); ++i) {
+                if (rb_ary_entry(waiters, i) == thread) {
+                        rb_ary_delete_at(waiters, i);
+                        break;
+                }
+        }
+        return Qnil;
+}
+
+static VALUE group_wait(VALUE venv) {
+        ENVIRONMENT(venv, environment);
+        rb_ary_push(environment->group_waiters, rb_thread_current());
+        return rb_ensure(group_sleep, Qnil, group_unwait, venv);
+}
+
+static void group_broadcast(Environment* environment) {
+        VALUE waiters = environment->group_waiters;
+        long i;
+        for (i = 0; i < RARRAY_LEN(waiters); ++i)
+                rb_thread_wakeup_alive(rb_ary_entry(waiters, i));
+        rb_ary_clear(waiters);
+}
+
+static void* group_txn_begin(void* arg) {
+        GroupCall* call = (GroupCall*)arg;
+        call->rc = mdb_txn_begin(call->env, 0, 0, &call->txn);
+        return 0;
+}
+
+static void* group_txn_commit(void* arg) {
+        GroupCall* call = (GroupCall*)arg;
+        call->rc = mdb_txn_commit(call->txn);
+        return 0;
+}
+
+// Interrupts are checked when the GVL comes back, after the call
+// has already happened, so they must not cost us its result
+static VALUE group_begin(VALUE arg) {
+        rb_thread_call_without_gvl(group_txn_begin, (void*)arg, 0, 0);
+        return Qnil;
+}
+
+static VALUE group_commit(VALUE arg) {
+        rb_thread_call_without_gvl(group_txn_commit, (void*)arg, 0, 0);
+        return Qnil;
+}
+
+static VALUE group_block(VALUE arg) {
+        GroupArgs* args = (GroupArgs*)arg;
+        return run_transaction(args->env, args->batch->txn, args->fn, args->arg, 0);
+}
+
+static VALUE group_run(VALUE arg) {
+        GroupArgs* args = (GroupArgs*)arg;
+        ENVIRONMENT(args->env, environment);
+        GroupBatch* batch = args->batch;
+
+        if (args->leader) {
+                GroupCall call = { batch->env, 0, 0 };
+                rb_protect(group_begin, (VALUE)&call, &args->interrupt);
+                batch->txn = call.txn;
+                batch->rc = call.rc;
+                batch->started = 1;
+                if (call.rc) {
+                        if (environment->group_batch == batch)
+                                environment->group_batch = 0;
+                        batch->done = 1;
+                }
+                group_broadcast(environment);
+                if (args->interrupt)
+                        return Qnil;
+        }
+
+        while (!batch->done && (!batch->started || batch->busy))
+                group_wait(args->env);
+        if (batch->done)
+                return Qnil;
+
+        batch->busy = 1;
+        args->ret = rb_protect(group_block, arg, &args->exception);
+        batch->busy = 0;
+        batch->finished++;
+        args->ran = 1;
+        group_broadcast(environment);
+
+        if (!args->leader) {
+                while (!batch->done)
+                        group_wait(args->env);
+        }
+        return Qnil;
+}
+
+static VALUE group_leave(VALUE arg) {
+        GroupArgs* args = (GroupArgs*)arg;
+        ENVIRONMENT(args->env, environment);
+        GroupBatch* batch = args->batch;
+        int state = args->interrupt;
+
+        if (!args->ran && !batch->done) {
+                batch->members--;
+                group_broadcast(environment);
+        }
+
+        // The members' blocks are part of the txn, so the leader has to
+        // see the batch through even when it is interrupted
+        if (args->leader && !batch->done) {
+                while (batch->finished < batch->members) {
+                        int interrupt;
+                        rb_protect(group_wait, args->env, &interrupt);
+                        if (interrupt)
+                                state = interrupt;
+                }
+                if (environment->group_batch == batch)
+                        environment->group_batch = 0;
+
+                GroupCall call = { batch->env, batch->txn, 0 };
+                int interrupt;
+                rb_protect(group_commit, (VALUE)&call, &interrupt);
+                if (interrupt)
+                        state = interrupt;
+                batch->txn = 0;
+                batch->rc = call.rc;
+                batch->done = 1;
+                group_broadcast(environment);
+        }
+
+        args->rc = batch->rc;
+        if (--batch->refs == 0)
+                xfree(batch);
+
+        if (state)
+                rb_jump_tag(state);
+        return Qnil;
+}
+
+static VALUE group_transaction(VALUE venv, VALUE(*fn)(VALUE), VALUE arg) {
+        ENVIRONMENT(venv, environment);
+        GroupArgs args = { venv, fn, arg, environment->group_batch, 0, 0, 0, 0, 0, Qnil };
+
+        if (!args.batch) {
+                args.batch = ALLOC(GroupBatch);
+                MEMZERO(args.batch, GroupBatch, 1);
+                args.batch->env = environment->env;
+                environment->group_batch = args.batch;
+                args.leader = 1;
+        }
+        args.batch->members++;
+        args.batch->refs++;
+
+        rb_ensure(group_run, (VALUE)&args, group_leave, (VALUE)&args);
+
+        if (args.exception)
+                rb_jump_tag(args.exception);
+        check(args.rc);
+        return args.ret;
+}
+
 static void environment_check(Environment* environment) {
         if (!environment->env)
                 rb_raise(cError, "Environment is closed");
@@ -185,6 +386,8 @@ static void environment_free(Environment *environment) {
 static void environment_mark(Environment* environment) {
         rb_gc_mark(environment->thread_txn_hash);
         rb_gc_mark(environment->txn_thread_hash);
+        rb_gc_mark(environment->group_waiters);
+        rb_gc_mark(environment->writers);
 }
 
 /**
@@ -198,8 +401,12 @@ static void environment_mark(Environment* environment) {
  */
 static VALUE environment_close(VALUE self) {
         ENVIRONMENT(self, environment);
+        if (RARRAY_LEN(environment->writers))
+                rb_raise(cError, "Environment has open writers");
+        int rc = auto_sync_stop(environment);
         mdb_env_close(environment->env);
         environment->env = 0;
+        check(rc);
         return Qnil;
 }
 
@@ -246,6 +453,9 @@ static VALUE environment_stat(VALUE self) {
  *   * +:last_txnid+ ID of the last committed transaction
  *   * +:maxreaders+ Max reader slots in the environment
  *   * +:numreaders+ Max readers slots in the environment
+ *   * +:maxdirty+ Max dirty pages in a write transaction
+ *   * +:io_uring_ops+ Page writes and syncs this process completed
+ *     through io_uring, 0 unless the +:io_uring+ flag is in effect
  */
 static VALUE environment_info(VALUE self) {
         MDB_envinfo info;
@@ -264,9 +474,29 @@ static VALUE environment_info(VALUE self) {
         INFO_SET(numreaders);
 #undef INFO_SET
 
+        unsigned int maxdirty;
+        check(mdb_env_get_maxdirty(environment->env, &maxdirty));
+        rb_hash_aset(ret, ID2SYM(rb_intern("maxdirty")), INT2NUM(maxdirty));
+
+        size_t uring_ops;
+        check(mdb_env_get_uring_ops(environment->env, &uring_ops));
+        rb_hash_aset(ret, ID2SYM(rb_intern("io_uring_ops")), SIZET2NUM(uring_ops));
+
         return ret;
 }
 
+/**
+ * @overload max_key_size
+ *   Return the maximum size of a key in this environment, which
+ *   depends on its page size. Values in +:dupsort+ databases are
+ *   limited to the same size.
+ *   @return [Number] the maximum key size in bytes
+ */
+static VALUE environment_max_key_size(VALUE self) {
+        ENVIRONMENT(self, environment);
+        return INT2NUM(mdb_env_get_maxkeysize(environment->env));
+}
+
 /**
  * @overload copy(path)
  *   Create a copy (snapshot) of an environment.  The copy can be used
@@ -292,7 +522,8 @@ static VALUE environment_copy(VALUE self, VALUE path) {
  *   Data is always written to disk when {Transaction#commit} is called, but
  *   the operating system may keep it buffered. MDB always flushes the
  *   OS buffers upon commit as well, unless the environment was opened
- *   with +:nosync+ or in part +:nometasync+.
+ *   with +:nosync+ or in part +:nometasync+.  Other threads keep
+ *   running while the data is flushed.
  *   @param [Boolean] force If true, force a synchronous
  *     flush. Otherwise if the environment has the +:nosync+ flag set
  *     the flushes will be omitted, and with +:mapasync+ they will be
@@ -304,10 +535,167 @@ static VALUE environment_sync(int argc, VALUE *argv, VALUE self) {
         VALUE force;
         rb_scan_args(argc, argv, "01", &force);
 
-        check(mdb_env_sync(environment->env, RTEST(force)));
+        SyncArgs args = { environment->env, 0, RTEST(force), 0 };
+        rb_thread_call_without_gvl(sync_env, &args, 0, 0);
+        check(args.rc);
         return Qnil;
 }
 
+static void* sync_env(void* arg) {
+        SyncArgs* args = (SyncArgs*)arg;
+        args->rc = mdb_env_sync(args->env, args->force);
+        return 0;
+}
+
+static void* sync_stop(void* arg) {
+        SyncArgs* args = (SyncArgs*)arg;
+        args->rc = syncer_stop(args->syncer);
+        syncer_free(args->syncer);
+        return 0;
+}
+
+// Stop the auto_sync thread, if any, after its last sync
+static int auto_sync_stop(Environment* environment) {
+        SyncArgs args = { environment->env, environment->syncer, 1, 0 };
+        if (!args.syncer)
+                return 0;
+        environment->syncer = 0;
+        rb_thread_call_without_gvl(sync_stop, &args, 0, 0);
+        return args.rc;
+}
+
+static int auto_sync_options(VALUE key, VALUE value, AutoSyncOptions* options) {
+        ID id = rb_to_id(key);
+
+        if (id == rb_intern("interval"))
+                options->interval = NUM2DBL(value);
+        else if (id == rb_intern("max_dirty_bytes"))
+                options->max_dirty_bytes = NUM2SSIZET(value);
+        else {
+                VALUE s = rb_inspect(key);
+                rb_raise(cError, "Invalid option %s", StringValueCStr(s));
+        }
+
+        return 0;
+}
+
+/**
+ * @overload auto_sync(options)
+ *   Sync the environment from a background thread, for environments
+ *   opened with +:nosync+ or +:mapasync+.  Every +:interval+ seconds
+ *   the thread syncs if anything was committed since the last sync,
+ *   so a system crash loses at most that interval plus the time a
+ *   sync takes.  Syncs run outside the global interpreter lock.
+ *   Calling it again replaces the settings; {#close} stops the thread
+ *   after a last sync.
+ *   @option options [Float] :interval (1.0) Seconds between syncs.
+ *   @option options [Integer] :max_dirty_bytes Also sync as soon as
+ *       this many bytes have been committed since the last sync.
+ *       Checked every 10 ms.
+ *   @see #sync_stat
+ *   @example
+ *      env = LMDB.new "databasedir", :nosync => true
+ *      env.auto_sync :interval => 0.5, :max_dirty_bytes => 64 << 20
+ * @overload auto_sync(false)
+ *   Stop syncing in the background, after a last sync.
+ */
+static VALUE environment_auto_sync(int argc, VALUE *argv, VALUE self) {
+        ENVIRONMENT(self, environment);
+
+        VALUE enable, option_hash;
+        rb_scan_args(argc, argv, "01:", &enable, &option_hash);
+
+        AutoSyncOptions options = {
+                .interval = 1.0,
+                .max_dirty_bytes = 0,
+        };
+        if (!NIL_P(option_hash))
+                rb_hash_foreach(option_hash, auto_sync_options, (VALUE)&options);
+        if (options.interval <= 0)
+                rb_raise(cError, "Interval must be positive");
+
+        check(auto_sync_stop(environment));
+        if (enable == Qfalse)
+                return Qnil;
+
+        Syncer* syncer;
+        check(syncer_new(environment->env, options.interval, options.max_dirty_bytes, &syncer));
+        environment->syncer = syncer;
+        return Qnil;
+}
+
+/**
+ * @overload sync_stat
+ *   Return statistics about the background syncs started by
+ *   {#auto_sync}.
+ *   @return [Hash, nil] the statistics, or nil if not syncing in the
+ *       background
+ *   * +:syncs+ Number of syncs completed
+ *   * +:errors+ Number of syncs that failed
+ *   * +:last_latency+ Seconds taken by the last sync
+ *   * +:max_latency+ Seconds taken by the slowest sync
+ *   * +:mean_latency+ Average seconds per sync
+ *   * +:unsynced_bytes+ Bytes committed but not synced yet
+ *   * +:lag+ Seconds since the last sync began if anything is waiting
+ *     to be synced, otherwise 0
+ */
+static VALUE environment_sync_stat(VALUE self) {
+        ENVIRONMENT(self, environment);
+        if (!environment->syncer)
+                return Qnil;
+
+        SyncerStat stat;
+        syncer_stat(environment->syncer, &stat);
+
+        VALUE ret = rb_hash_new();
+
+#define STAT_SET(name, value) rb_hash_aset(ret, ID2SYM(rb_intern(#name)), value);
+        STAT_SET(syncs, SIZET2NUM(stat.syncs));
+        STAT_SET(errors, SIZET2NUM(stat.errors));
+        STAT_SET(last_latency, rb_float_new(stat.last_latency));
+        STAT_SET(max_latency, rb_float_new(stat.max_latency));
+        STAT_SET(mean_latency, rb_float_new(stat.syncs ? stat.total_latency / stat.syncs : 0));
+        STAT_SET(unsynced_bytes, SIZET2NUM(stat.unsynced));
+        STAT_SET(lag, rb_float_new(stat.lag));
+#undef STAT_SET
+
+        return ret;
+}
+
+/**
+ * @overload arena_stat
+ *   Return statistics about the dirty page arena set up with the
+ *   +:arena+ option.
+ *   @return [Hash, nil] the statistics, or nil if there is no arena
+ *   * +:size+ Bytes reserved for the arena
+ *   * +:resident+ Bytes of the arena backed by memory
+ *   * +:pages+ Pages handed out by the arena
+ *   * +:reused+ Pages that reused memory from earlier pages
+ *   * +:fallbacks+ Pages that did not fit and were allocated separately
+ *   * +:hugetlb+ Whether the arena is backed by the hugetlb pool
+ */
+static VALUE environment_arena_stat(VALUE self) {
+        ENVIRONMENT(self, environment);
+
+        MDB_arenainfo info;
+        check(mdb_env_arena_info(environment->env, &info));
+        if (!info.ma_size)
+                return Qnil;
+
+        VALUE ret = rb_hash_new();
+
+#define STAT_SET(name, value) rb_hash_aset(ret, ID2SYM(rb_intern(#name)), value);
+        STAT_SET(size, SIZET2NUM(info.ma_size));
+        STAT_SET(resident, SIZET2NUM(info.ma_resident));
+        STAT_SET(pages, SIZET2NUM(info.ma_pages));
+        STAT_SET(reused, SIZET2NUM(info.ma_reused));
+        STAT_SET(fallbacks, SIZET2NUM(info.ma_fallbacks));
+        STAT_SET(hugetlb, (info.ma_flags & MDB_ARENA_HUGETLB) ? Qtrue : Qfalse);
+#undef STAT_SET
+
+        return ret;
+}
+
 static int environment_options(VALUE key, VALUE value, EnvironmentOptions* options) {
         ID id = rb_to_id(key);
 
@@ -317,8 +705,26 @@ static int environment_options(VALUE key, VALUE value, EnvironmentOptions* optio
                 options->maxreaders = NUM2INT(value);
         else if (id == rb_intern("maxdbs"))
                 options->maxdbs = NUM2INT(value);
+        else if (id == rb_intern("maxdirty"))
+                options->maxdirty = NUM2INT(value);
+        else if (id == rb_intern("group_commit"))
+                options->group_commit = RTEST(value);
         else if (id == rb_intern("mapsize"))
                 options->mapsize = NUM2SSIZET(value);
+        else if (id == rb_intern("pagesize"))
+                options->pagesize = NUM2UINT(value);
+        else if (id == rb_intern("arena"))
+                options->arena = NUM2SSIZET(value);
+        else if (id == rb_intern("arena_retain"))
+                options->arena_retain = NUM2SSIZET(value);
+        else if (id == rb_intern("hugepages")) {
+                if (value == ID2SYM(rb_intern("hugetlb")))
+                        options->arena_flags = MDB_ARENA_HUGETLB;
+                else if (value == ID2SYM(rb_intern("thp")) || value == Qtrue)
+                        options->arena_flags = MDB_ARENA_THP;
+                else if (RTEST(value))
+                        rb_raise(cError, "Invalid hugepages option, use :hugetlb or :thp");
+        }
 
 #define FLAG(const, name) else if (id == rb_intern(#name)) { if (RTEST(value)) { options->flags |= MDB_##const; } }
 #include "env_flags.h"
@@ -350,11 +756,35 @@ static int environment_options(VALUE key, VALUE value, EnvironmentOptions* optio
  *       that can be executing transactions at once.  Default is 126.
  *   @option opts [Number] :maxdbs The maximum number of named databases in the
  *       environment.  Not needed if only one database is being used.
+ *   @option opts [Number] :maxdirty The maximum number of dirty pages a write
+ *       transaction keeps in memory before it spills pages to disk.
+ *       Default is 131071.
+ *   @option opts [Boolean] :group_commit Let concurrent threads share write
+ *       transactions. Each top-level write transaction runs as a nested
+ *       transaction of a shared one, and returns once the shared
+ *       transaction has been committed together with the others in it.
+ *       Not available with +:writemap+, which rules out nested
+ *       transactions.
  *   @option opts [Number] :mapsize The size of the memory map to be allocated
  *       for this environment, in bytes.  The memory map size is the
  *       maximum total size of the database.  The size should be a
  *       multiple of the OS page size.  The default size is about
  *       10MiB.
+ *   @option opts [Number] :pagesize The page size of a new environment,
+ *       a power of two from 4096 to 32768. Larger pages keep bigger
+ *       values out of overflow pages and make trees shallower. An
+ *       existing environment keeps the page size it was created with.
+ *       The default is the OS page size.
+ *   @option opts [Number] :arena Reserve this many bytes of address space
+ *       for the dirty pages of write transactions, which are then
+ *       carved from it instead of allocated one by one, and released
+ *       together at commit or abort. Not used with +:writemap+.
+ *       See {#arena_stat}.
+ *   @option opts [Number] :arena_retain How many bytes of the arena stay
+ *       in memory between transactions. Default is the whole arena.
+ *   @option opts [Symbol] :hugepages Back the arena with huge pages,
+ *       either from the kernel's hugetlb pool (+:hugetlb+, if it has
+ *       enough) or transparent huge pages (+:thp+).
  *   @yield [env] The block to be executed with the environment. The environment is closed afterwards.
  *   @yieldparam env [Environment] The environment
  *   @see #close
@@ -374,11 +804,17 @@ static VALUE environment_new(int argc, VALUE *argv, VALUE klass) {
                 .flags = MDB_NOTLS,
                 .maxreaders = -1,
                 .maxdbs = 128,
+                .maxdirty = -1,
                 .mapsize = 0,
                 .mode = 0755,
+                .arena_retain = (size_t)-1,
         };
         if (!NIL_P(option_hash))
                 rb_hash_foreach(option_hash, environment_options, (VALUE)&options);
+        if (options.group_commit && (options.flags & MDB_WRITEMAP))
+                rb_raise(cError, "Group commit needs nested transactions, which writemap does not support");
+        if ((options.flags & MDB_PIPELINE) && (options.flags & MDB_WRITEMAP))
+                rb_raise(cError, "Pipelined commits are not supported with writemap");
 
         MDB_env* env;
         check(mdb_env_create(&env));
@@ -388,11 +824,22 @@ static VALUE environment_new(int argc, VALUE *argv, VALUE klass) {
         environment->env = env;
         environment->thread_txn_hash = rb_hash_new();
         environment->txn_thread_hash = rb_hash_new();
+        environment->writers = rb_ary_new();
+        if (options.group_commit) {
+                environment->group_commit = 1;
+                environment->group_waiters = rb_ary_new();
+        }
 
         if (options.maxreaders > 0)
                 check(mdb_env_set_maxreaders(env, options.maxreaders));
+        if (options.maxdirty > 0)
+                check(mdb_env_set_maxdirty(env, options.maxdirty));
         if (options.mapsize > 0)
                 check(mdb_env_set_mapsize(env, options.mapsize));
+        if (options.pagesize > 0)
+                check(mdb_env_set_pagesize(env, options.pagesize));
+        if (options.arena > 0)
+                check(mdb_env_set_arena(env, options.arena, options.arena_retain, options.arena_flags));
 
         check(mdb_env_set_maxdbs(env, options.maxdbs <= 0 ? 1 : options.maxdbs));
         check(mdb_env_open(env, StringValueCStr(path), options.flags, options.mode));
@@ -416,6 +863,8 @@ static VALUE environment_new(int argc, VALUE *argv, VALUE klass) {
  *   * +:writemap+ Use a writeable memory map unless +:rdonly+ is set. This is faster and uses fewer mallocs, but loses protection from application bugs like wild pointer writes and other bad updates into the database. Incompatible with nested transactions.
  *   * +:mapasync+ When using +:writemap+, use asynchronous flushes to disk. As with +:nosync+, a system crash can then corrupt the database or lose the last transactions. Calling {Environment#sync} ensures on-disk database integrity until next commit.
  *   * +:notls+ Don't use thread-local storage.
+ *   * +:io_uring+ Write a transaction's pages through io_uring and submit them together with the flush to disk, saving system calls on large commits. Linux only; if io_uring is unavailable the flag is dropped and pages are written as usual, so {#flags} shows whether it is in use.
+ *   * +:pipeline+ Release the write lock as soon as a transaction's pages are written, and sync and write the metadata afterwards. Another thread, such as the next +:group_commit+ batch, can then build its transaction while the previous one is being flushed to disk. Commits still return only once they are durable, and read-only transactions only see durable data. Writers in other processes wait until this process's commits are durable. Incompatible with +:writemap+.
  *   @example
  *       env = LMDB.new "abc", :writemap => true, :nometasync => true
  *       env.flags           #=> [:writemap, :nometasync]
@@ -541,6 +990,15 @@ static MDB_txn* need_txn(VALUE self) {
         return txn;
 }
 
+// Convert a key and reject it if it is too long, before any transaction is started for it
+static VALUE need_key(VALUE self, VALUE vkey) {
+        ENVIRONMENT(self, environment);
+        vkey = StringValue(vkey);
+        if (RSTRING_LEN(vkey) > mdb_env_get_maxkeysize(environment->env))
+                check(MDB_BAD_VALSIZE);
+        return vkey;
+}
+
 /**
  * @overload transaction(readonly)
  *   Begin a transaction.  Takes a block to run the body of the
@@ -589,6 +1047,19 @@ static void database_mark(Database* database) {
 #undef METHOD
 #undef FILE
 
+static int database_options(VALUE key, VALUE value, DatabaseOptions* options) {
+        ID id = rb_to_id(key);
+
+        if (id == rb_intern("split_ratio"))
+                options->split_ratio = NUM2DBL(value);
+        else if (id == rb_intern("merge_threshold"))
+                options->merge_threshold = NUM2DBL(value);
+        else
+                database_flags(key, value, &options->flags);
+
+        return 0;
+}
+
 /**
  * @overload database(name, options)
  *   Opens a database within the environment.
@@ -622,9 +1093,30 @@ static void database_mark(Database* database) {
  *   @option options [Boolean] :reversedup This option specifies that
  *       duplicate data items should be compared as strings in reverse
  *       order.
+ *   @option options [Boolean] :prefixkey Store the prefix shared by
+ *       the keys of a leaf page once per page, so that keys with long
+ *       common prefixes take less space.  May not be combined with
+ *       +:reversekey+, +:integerkey+ or +:dupsort+.  Once such a
+ *       database is created the environment's data file is marked as a
+ *       newer format, which library versions without this option
+ *       refuse to open.
  *   @option options [Boolean] :create Create the named database if it
  *       doesn't exist. This option is not allowed in a read-only
  *       transaction or a read-only environment.
+ *   @option options [Float] :split_ratio How full to leave the left
+ *       page when a leaf page splits, between 0 and 1.  By default
+ *       pages split in the middle, unless the new key goes at the end.
+ *       A database filled in mostly ascending order packs better with
+ *       0.9, together with a +:merge_threshold+ of 0.1.  Neither page
+ *       of a split may be left below the merge threshold.
+ *   @option options [Float] :merge_threshold How empty a page gets
+ *       before it is merged with a neighbor, at most 0.5.  Defaults to
+ *       0.25.  A lower threshold keeps a database with a lot of churn
+ *       from merging and splitting the same pages over and over.
+ *   @note +:split_ratio+ and +:merge_threshold+ are not stored in the
+ *       database.  They apply to the database until the environment
+ *       is closed, and are set again each time the database is opened
+ *       with them.
  */
 static VALUE environment_database(int argc, VALUE *argv, VALUE self) {
         ENVIRONMENT(self, environment);
@@ -634,12 +1126,30 @@ static VALUE environment_database(int argc, VALUE *argv, VALUE self) {
         VALUE name, option_hash;
         rb_scan_args(argc, argv, "01:", &name, &option_hash);
 
-        int flags = 0;
+        DatabaseOptions options = {
+                .flags = 0,
+                .split_ratio = 0,
+                .merge_threshold = 0,
+        };
         if (!NIL_P(option_hash))
-                rb_hash_foreach(option_hash, database_flags, (VALUE)&flags);
+                rb_hash_foreach(option_hash, database_options, (VALUE)&options);
+        if (!(options.split_ratio >= 0 && options.split_ratio < 1))
+                rb_raise(cError, "Split ratio must be between 0 and 1");
+        if (!(options.merge_threshold >= 0 && options.merge_threshold <= 0.5))
+                rb_raise(cError, "Merge threshold must be between 0 and 0.5");
+        unsigned int split = options.split_ratio * 1000, merge = options.merge_threshold * 1000;
 
         MDB_dbi dbi;
-        check(mdb_dbi_open(need_txn(self), NIL_P(name) ? 0 : StringValueCStr(name), flags, &dbi));
+        MDB_txn* txn = need_txn(self);
+        check(mdb_dbi_open(txn, NIL_P(name) ? 0 : StringValueCStr(name), options.flags, &dbi));
+        if (split || merge) {
+                // The handle is valid and the ranges were checked above,
+                // so only a split below the merge threshold is refused
+                int rc = mdb_set_fill(txn, dbi, split, merge);
+                if (rc == EINVAL)
+                        rb_raise(cError, "Split ratio leaves a page below the merge threshold");
+                check(rc);
+        }
 
         Database* database;
         VALUE vdb = Data_Make_Struct(cDatabase, Database, database_mark, free, database);
@@ -670,6 +1180,96 @@ static VALUE database_stat(VALUE self) {
         return stat2hash(&stat);
 }
 
+/**
+ * @overload fill_histogram(buckets = 10)
+ *   Count the pages of the database by how full they are.  Each page
+ *   is counted in one of +buckets+ equal ranges of fill, the first
+ *   for pages that are less than 1/buckets full.  Overflow pages and
+ *   the pages of sorted duplicates are not counted.
+ *   @param [Integer] buckets The number of fill ranges.
+ *   @return [Hash] the counts
+ *   * +:leaf+ Array of leaf page counts, emptiest pages first
+ *   * +:branch+ Array of branch page counts, emptiest pages first
+ *   @example
+ *      db.fill_histogram(4) #=> {:leaf=>[0, 2, 31, 967], :branch=>[0, 0, 1, 7]}
+ */
+static VALUE database_fill_histogram(int argc, VALUE *argv, VALUE self) {
+        DATABASE(self, database);
+        if (!active_txn(database->env))
+                return call_with_transaction(database->env, self, "fill_histogram", argc, argv, MDB_RDONLY);
+
+        VALUE vbuckets;
+        rb_scan_args(argc, argv, "01", &vbuckets);
+        unsigned int buckets = NIL_P(vbuckets) ? 10 : NUM2UINT(vbuckets);
+        if (buckets < 1 || buckets > 1000)
+                rb_raise(cError, "Buckets must be between 1 and 1000");
+
+        size_t* leaf = ALLOCA_N(size_t, buckets);
+        size_t* branch = ALLOCA_N(size_t, buckets);
+        check(mdb_page_fill(need_txn(database->env), database->dbi, buckets, leaf, branch));
+
+        VALUE vleaf = rb_ary_new2(buckets), vbranch = rb_ary_new2(buckets);
+        for (unsigned int i = 0; i < buckets; i++) {
+                rb_ary_push(vleaf, SIZET2NUM(leaf[i]));
+                rb_ary_push(vbranch, SIZET2NUM(branch[i]));
+        }
+
+        VALUE ret = rb_hash_new();
+        rb_hash_aset(ret, ID2SYM(rb_intern("leaf")), vleaf);
+        rb_hash_aset(ret, ID2SYM(rb_intern("branch")), vbranch);
+        return ret;
+}
+
+/**
+ * @overload estimate_range(from, to)
+ *   Estimate the size of the records with a key from +from+ up to but
+ *   not including +to+.  Only the two ends are looked up, so the cost
+ *   does not grow with the size of the range.  The estimate assumes the
+ *   pages along the way hold the same number of records each, and is
+ *   usually within a few percent of the database's total entries.
+ *   @param from The first key of the range, or +nil+ to start at the
+ *     first key of the database.
+ *   @param to The key to stop at, or +nil+ to run to the end of the
+ *     database.
+ *   @return [Hash] the estimate, in the form of {#stat}
+ *   * +:psize+ Size of a database page
+ *   * +:depth+ Depth (height) of the B-tree
+ *   * +:branch_pages+ Number of internal (non-leaf) pages in the range
+ *   * +:leaf_pages+ Number of leaf pages in the range
+ *   * +:overflow_pages+ Number of overflow pages in the range
+ *   * +:entries+ Number of data items in the range
+ *   @example
+ *      db.estimate_range('a', 'b') #=> {:psize=>4096, :depth=>3, :branch_pages=>1, :leaf_pages=>52, :overflow_pages=>0, :entries=>3120}
+ */
+static VALUE database_estimate_range(VALUE self, VALUE vfrom, VALUE vto) {
+        DATABASE(self, database);
+
+        if (!NIL_P(vfrom))
+                vfrom = need_key(database->env, vfrom);
+        if (!NIL_P(vto))
+                vto = need_key(database->env, vto);
+
+        if (!active_txn(database->env)) {
+                VALUE args[2] = { vfrom, vto };
+                return call_with_transaction(database->env, self, "estimate_range", 2, args, MDB_RDONLY);
+        }
+
+        MDB_val from, to;
+        MDB_stat stat;
+        if (!NIL_P(vfrom)) {
+                from.mv_size = RSTRING_LEN(vfrom);
+                from.mv_data = RSTRING_PTR(vfrom);
+        }
+        if (!NIL_P(vto)) {
+                to.mv_size = RSTRING_LEN(vto);
+                to.mv_data = RSTRING_PTR(vto);
+        }
+
+        check(mdb_estimate_range(need_txn(database->env), database->dbi,
+                                 NIL_P(vfrom) ? 0 : &from, NIL_P(vto) ? 0 : &to, &stat));
+        return stat2hash(&stat);
+}
+
 /**
  * @overload drop
  *   Remove a database from the environment.
@@ -709,10 +1309,10 @@ static VALUE database_clear(VALUE self) {
  */
 static VALUE database_get(VALUE self, VALUE vkey) {
         DATABASE(self, database);
+        vkey = need_key(database->env, vkey);
         if (!active_txn(database->env))
                 return call_with_transaction(database->env, self, "get", 1, &vkey, MDB_RDONLY);
 
-        vkey = StringValue(vkey);
         MDB_val key, value;
         key.mv_size = RSTRING_LEN(vkey);
         key.mv_data = RSTRING_PTR(vkey);
@@ -759,17 +1359,18 @@ static VALUE database_get(VALUE self, VALUE vkey) {
  */
 static VALUE database_put(int argc, VALUE *argv, VALUE self) {
         DATABASE(self, database);
-        if (!active_txn(database->env))
-                return call_with_transaction(database->env, self, "put", argc, argv, 0);
 
         VALUE vkey, vval, option_hash;
         rb_scan_args(argc, argv, "2:", &vkey, &vval, &option_hash);
+        vkey = need_key(database->env, vkey);
+
+        if (!active_txn(database->env))
+                return call_with_transaction(database->env, self, "put", argc, argv, 0);
 
         int flags = 0;
         if (!NIL_P(option_hash))
                 rb_hash_foreach(option_hash, database_put_flags, (VALUE)&flags);
 
-        vkey = StringValue(vkey);
         vval = StringValue(vval);
 
         MDB_val key, value;
@@ -799,13 +1400,13 @@ static VALUE database_put(int argc, VALUE *argv, VALUE self) {
  */
 static VALUE database_delete(int argc, VALUE *argv, VALUE self) {
         DATABASE(self, database);
-        if (!active_txn(database->env))
-                return call_with_transaction(database->env, self, "delete", argc, argv, 0);
 
         VALUE vkey, vval;
         rb_scan_args(argc, argv, "11", &vkey, &vval);
+        vkey = need_key(database->env, vkey);
 
-        vkey = StringValue(vkey);
+        if (!active_txn(database->env))
+                return call_with_transaction(database->env, self, "delete", argc, argv, 0);
 
         MDB_val key;
         key.mv_size = RSTRING_LEN(vkey);
@@ -814,7 +1415,7 @@ static VALUE database_delete(int argc, VALUE *argv, VALUE self) {
         if (NIL_P(vval)) {
                 check(mdb_del(need_txn(database->env), database->dbi, &key, 0));
         } else {
-                VALUE vval = StringValue(vval);
+                vval = StringValue(vval);
                 MDB_val value;
                 value.mv_size = RSTRING_LEN(vval);
                 value.mv_data = RSTRING_PTR(vval);
@@ -824,6 +1425,354 @@ static VALUE database_delete(int argc, VALUE *argv, VALUE self) {
         return Qnil;
 }
 
+/**
+ * @overload delete_range(from, to)
+ *
+ * Deletes every record with a key from +from+ up to but not including
+ * +to+. Parts of the database that lie entirely inside the range are
+ * freed without being copied into the transaction first, so expiring
+ * a large range is much cheaper than deleting its records one by one.
+ * Cursors on the database have to be positioned again afterwards.
+ *
+ * @param from The first key to delete, or +nil+ to start at the first
+ *   key of the database.
+ * @param to The key to stop at, or +nil+ to delete to the end of the
+ *   database.
+ * @return [Integer] the number of records deleted, counting each
+ *   duplicate of a +:dupsort+ database.
+ */
+static VALUE database_delete_range(VALUE self, VALUE vfrom, VALUE vto) {
+        DATABASE(self, database);
+
+        if (!NIL_P(vfrom))
+                vfrom = need_key(database->env, vfrom);
+        if (!NIL_P(vto))
+                vto = need_key(database->env, vto);
+
+        if (!active_txn(database->env)) {
+                VALUE args[2] = { vfrom, vto };
+                return call_with_transaction(database->env, self, "delete_range", 2, args, 0);
+        }
+
+        MDB_val from, to;
+        size_t count;
+        if (!NIL_P(vfrom)) {
+                from.mv_size = RSTRING_LEN(vfrom);
+                from.mv_data = RSTRING_PTR(vfrom);
+        }
+        if (!NIL_P(vto)) {
+                to.mv_size = RSTRING_LEN(vto);
+                to.mv_data = RSTRING_PTR(vto);
+        }
+
+        check(mdb_del_range(need_txn(database->env), database->dbi,
+                            NIL_P(vfrom) ? 0 : &from, NIL_P(vto) ? 0 : &to, &count));
+        return SIZET2NUM(count);
+}
+
+static int bulk_load_options(VALUE key, VALUE value, BulkLoadOptions* options) {
+        ID id = rb_to_id(key);
+
+        if (id == rb_intern("fill"))
+                options->fill = NUM2DBL(value);
+        else {
+                VALUE s = rb_inspect(key);
+                rb_raise(cError, "Invalid option %s", StringValueCStr(s));
+        }
+
+        return 0;
+}
+
+static void bulk_load_values(VALUE pair, int argc, const VALUE* argv, MDB_val* key, MDB_val* value) {
+        VALUE vkey, vval;
+        if (argc == 2) {
+                vkey = argv[0];
+                vval = argv[1];
+        } else {
+                pair = rb_check_array_type(pair);
+                if (NIL_P(pair) || RARRAY_LEN(pair) != 2)
+                        rb_raise(cError, "Expected [key, value] pairs");
+                vkey = RARRAY_PTR(pair)[0];
+                vval = RARRAY_PTR(pair)[1];
+        }
+
+        vkey = StringValue(vkey);
+        vval = StringValue(vval);
+
+        key->mv_size = RSTRING_LEN(vkey);
+        key->mv_data = RSTRING_PTR(vkey);
+        value->mv_size = RSTRING_LEN(vval);
+        value->mv_data = RSTRING_PTR(vval);
+}
+
+static VALUE bulk_load_pair(RB_BLOCK_CALL_FUNC_ARGLIST(pair, arg)) {
+        BulkLoadArgs* args = (BulkLoadArgs*)arg;
+
+        MDB_val key, value;
+        bulk_load_values(pair, argc, argv, &key, &value);
+        check(mdb_loader_put(args->loader, &key, &value));
+        return Qnil;
+}
+
+// Check that a bulk load can start, and return the fill in tenths of a percent
+static unsigned int bulk_load_check(MDB_txn* txn, MDB_dbi dbi, double fill) {
+        if (!(fill > 0 && fill <= 1))
+                rb_raise(cError, "Fill must be greater than 0 and at most 1");
+
+        MDB_stat stat;
+        check(mdb_stat(txn, dbi, &stat));
+        if (stat.ms_entries)
+                rb_raise(cError, "Database is not empty");
+
+        unsigned int permille = fill * 1000;
+        return permille ? permille : 1;
+}
+
+static VALUE bulk_load_each(VALUE arg) {
+        BulkLoadArgs* args = (BulkLoadArgs*)arg;
+        rb_block_call(args->enumerable, rb_intern("each"), 0, 0, bulk_load_pair, arg);
+
+        MDB_loader* loader = args->loader;
+        args->loader = 0;
+        check(mdb_loader_close(loader, 1));
+        return Qnil;
+}
+
+static VALUE bulk_load_abort(VALUE arg) {
+        BulkLoadArgs* args = (BulkLoadArgs*)arg;
+        if (args->loader)
+                mdb_loader_close(args->loader, 0);
+        return Qnil;
+}
+
+/**
+ * @overload bulk_load(pairs, options)
+ *   Load an empty database from key/value pairs supplied in sorted
+ *   order.  Instead of inserting the records one by one, the B-tree
+ *   is built bottom-up: every page is filled once and written once,
+ *   and the finished tree is linked into the database in a single
+ *   step when the enumeration is done.
+ *
+ *   The keys must be unique and must arrive in the order of the
+ *   database's comparison function.  The database must be empty and
+ *   must not have been opened with +:dupsort+.
+ *   @param pairs An object responding to +each+ that yields
+ *       [key, value] pairs, such as an Array, Hash or Enumerator.
+ *   @option options [Float] :fill (1.0) How full to pack each page,
+ *       between 0 and 1.  Leaving some room makes later inserts into
+ *       the loaded range cheaper.
+ *   @return nil
+ *   @raise [Error] if the database is not empty, or if a key is not
+ *       greater than the key before it.  If the load fails after
+ *       data was written, the enclosing transaction can no longer be
+ *       committed.
+ *   @example
+ *      db = env.database "index", :create => true
+ *      db.bulk_load(File.foreach("sorted.tsv").lazy.map { |l| l.chomp.split("\t", 2) })
+ */
+static VALUE database_bulk_load(int argc, VALUE *argv, VALUE self) {
+        DATABASE(self, database);
+        if (!active_txn(database->env))
+                return call_with_transaction(database->env, self, "bulk_load", argc, argv, 0);
+
+        VALUE venum, option_hash;
+        rb_scan_args(argc, argv, "1:", &venum, &option_hash);
+
+        BulkLoadOptions options = {
+                .fill = 1.0,
+        };
+        if (!NIL_P(option_hash))
+                rb_hash_foreach(option_hash, bulk_load_options, (VALUE)&options);
+
+        MDB_txn* txn = need_txn(database->env);
+        unsigned int fill = bulk_load_check(txn, database->dbi, options.fill);
+        BulkLoadArgs args = { venum, 0 };
+        check(mdb_loader_open(txn, database->dbi, fill, &args.loader));
+        rb_ensure(bulk_load_each, (VALUE)&args, bulk_load_abort, (VALUE)&args);
+        return Qnil;
+}
+
+static int ingest_options(VALUE key, VALUE value, IngestOptions* options) {
+        ID id = rb_to_id(key);
+
+        if (id == rb_intern("memory"))
+                options->memory = NUM2SSIZET(value);
+        else if (id == rb_intern("tmpdir"))
+                options->tmpdir = value;
+        else if (id == rb_intern("fill"))
+                options->fill = NUM2DBL(value);
+        else {
+                VALUE s = rb_inspect(key);
+                rb_raise(cError, "Invalid option %s", StringValueCStr(s));
+        }
+
+        return 0;
+}
+
+static void* ingest_spill(void* arg) {
+        IngestArgs* args = (IngestArgs*)arg;
+        args->rc = sorter_spill(args->sorter);
+        return 0;
+}
+
+static void* ingest_load(void* arg) {
+        IngestArgs* args = (IngestArgs*)arg;
+        args->rc = sorter_load(args->sorter, args->loader, &args->entries);
+        return 0;
+}
+
+static void ingest_interrupt(void* arg) {
+        IngestArgs* args = (IngestArgs*)arg;
+        sorter_interrupt(args->sorter);
+}
+
+// Run a sort phase without the GVL, and raise whatever stopped it
+static void ingest_call(IngestArgs* args, void* (*fn)(void*)) {
+        rb_thread_call_without_gvl(fn, args, ingest_interrupt, args);
+        if (args->rc == EINTR)
+                rb_thread_check_ints();
+        check(args->rc);
+}
+
+static VALUE ingest_pair(RB_BLOCK_CALL_FUNC_ARGLIST(pair, arg)) {
+        IngestArgs* args = (IngestArgs*)arg;
+
+        MDB_val key, value;
+        bulk_load_values(pair, argc, argv, &key, &value);
+        check(sorter_add(args->sorter, &key, &value));
+        if (sorter_full(args->sorter))
+                ingest_call(args, ingest_spill);
+        return Qnil;
+}
+
+static VALUE ingest_each(VALUE arg) {
+        IngestArgs* args = (IngestArgs*)arg;
+        rb_block_call(args->enumerable, rb_intern("each"), 0, 0, ingest_pair, arg);
+
+        // Completed pages get the quarter of the budget the sorter leaves
+        MDB_stat stat;
+        unsigned int maxdirty;
+        check(mdb_env_stat(mdb_txn_env(args->txn), &stat));
+        check(mdb_env_get_maxdirty(mdb_txn_env(args->txn), &maxdirty));
+        size_t dirty = args->memory / stat.ms_psize;
+        check(mdb_loader_open(args->txn, args->dbi, args->fill, &args->loader));
+        check(mdb_loader_set_dirty(args->loader, dirty < maxdirty ? dirty : maxdirty));
+        ingest_call(args, ingest_load);
+
+        MDB_loader* loader = args->loader;
+        args->loader = 0;
+        check(mdb_loader_close(loader, 1));
+        return Qnil;
+}
+
+static VALUE ingest_free(VALUE arg) {
+        IngestArgs* args = (IngestArgs*)arg;
+        if (args->loader)
+                mdb_loader_close(args->loader, 0);
+        sorter_stat(args->sorter, &args->stat);
+        sorter_free(args->sorter);
+        return Qnil;
+}
+
+static double monotonic_time() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t peak_rss() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage))
+                return 0;
+#ifdef __APPLE__
+        return usage.ru_maxrss;
+#else
+        return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+/**
+ * @overload ingest(pairs, options)
+ *   Load an empty database from key/value pairs in any order.  The
+ *   pairs are sorted within a bounded amount of memory: whenever the
+ *   buffer fills up it is sorted and written to a temporary file, and
+ *   at the end the sorted runs are merged straight into a bottom-up
+ *   load as done by {#bulk_load}.  When a key occurs more than once,
+ *   the last value wins.
+ *
+ *   Sorting and merging release the global interpreter lock, so other
+ *   threads can run while the data is written.
+ *   @param pairs An object responding to +each+ that yields
+ *       [key, value] pairs.
+ *   @option options [Integer] :memory (64 MiB) Memory budget in
+ *       bytes, at least 1 MiB, shared by the sort buffer (half), the
+ *       merge buffers (a quarter) and the dirty pages of the load (a
+ *       quarter).  Ruby's own copies of the pairs are not included.
+ *   @option options [String] :tmpdir Directory for the sorted runs.
+ *       Defaults to +ENV['TMPDIR']+ or +/tmp+.
+ *   @option options [Float] :fill (1.0) How full to pack each page.
+ *   @return [Hash] Statistics: +:records+ read, +:entries+ loaded,
+ *       +:runs+ and bytes +:spilled+ to disk, elapsed +:time+ in
+ *       seconds, +:throughput+ in records per second, and the
+ *       +:peak_rss+ of the process in bytes.
+ *   @raise [Error] if the database is not empty.  If the load fails
+ *       after data was written, the enclosing transaction can no
+ *       longer be committed.
+ *   @example
+ *      db = env.database "index", :create => true
+ *      db.ingest(File.foreach("unsorted.tsv").lazy.map { |l| l.chomp.split("\t", 2) }, :memory => 256 << 20)
+ */
+static VALUE database_ingest(int argc, VALUE *argv, VALUE self) {
+        DATABASE(self, database);
+        if (!active_txn(database->env))
+                return call_with_transaction(database->env, self, "ingest", argc, argv, 0);
+
+        VALUE venum, option_hash;
+        rb_scan_args(argc, argv, "1:", &venum, &option_hash);
+
+        IngestOptions options = {
+                .memory = 64 << 20,
+                .tmpdir = Qnil,
+                .fill = 1.0,
+        };
+        if (!NIL_P(option_hash))
+                rb_hash_foreach(option_hash, ingest_options, (VALUE)&options);
+        if (options.memory < (1 << 20))
+                rb_raise(cError, "Memory must be at least 1 MiB");
+        if (NIL_P(options.tmpdir)) {
+                const char* dir = getenv("TMPDIR");
+                options.tmpdir = rb_str_new2(dir && *dir ? dir : "/tmp");
+        }
+
+        MDB_txn* txn = need_txn(database->env);
+        IngestArgs args = {
+                .enumerable = venum,
+                .txn = txn,
+                .dbi = database->dbi,
+                .fill = bulk_load_check(txn, database->dbi, options.fill),
+                .memory = options.memory / 4,
+        };
+
+        double start = monotonic_time();
+        check(sorter_new(txn, database->dbi, options.memory - args.memory, StringValueCStr(options.tmpdir), &args.sorter));
+        rb_ensure(ingest_each, (VALUE)&args, ingest_free, (VALUE)&args);
+        double time = monotonic_time() - start;
+
+        VALUE ret = rb_hash_new();
+
+#define STAT_SET(name, value) rb_hash_aset(ret, ID2SYM(rb_intern(#name)), value);
+        STAT_SET(records, SIZET2NUM(args.stat.records));
+        STAT_SET(entries, SIZET2NUM(args.entries));
+        STAT_SET(runs, SIZET2NUM(args.stat.runs));
+        STAT_SET(spilled, SIZET2NUM(args.stat.spilled));
+        STAT_SET(time, rb_float_new(time));
+        STAT_SET(throughput, rb_float_new(time > 0 ? args.stat.records / time : 0));
+        STAT_SET(peak_rss, SIZET2NUM(peak_rss()));
+#undef STAT_SET
+
+        return ret;
+}
+
 static void cursor_free(Cursor* cursor) {
         if (cursor->cur) {
                 rb_warn("Memory leak - Garbage collecting open cursor");
@@ -994,6 +1943,27 @@ static VALUE cursor_set_range(VALUE self, VALUE vkey) {
         return rb_assoc_new(rb_str_new(key.mv_data, key.mv_size), rb_str_new(value.mv_data, value.mv_size));
 }
 
+/**
+ * @overload seek_forward(key)
+ *   Set the cursor at the first key greater than or equal to a specified key,
+ *   like {#set_range}, but search from the current position rather than from
+ *   the root. Only the pages between the current key and the target are
+ *   searched, which makes repeated short seeks ahead (as in a merge join)
+ *   cheaper than {#set_range}.
+ *   @param key The key to which the cursor should be positioned
+ *   @return [Array] The [key, value] pair to which the cursor now points.
+ */
+static VALUE cursor_seek_forward(VALUE self, VALUE vkey) {
+        CURSOR(self, cursor);
+        MDB_val key, value;
+
+        key.mv_size = RSTRING_LEN(vkey);
+        key.mv_data = StringValuePtr(vkey);
+
+        check(mdb_cursor_get(cursor->cur, &key, &value, MDB_SEEK_FORWARD));
+        return rb_assoc_new(rb_str_new(key.mv_data, key.mv_size), rb_str_new(value.mv_data, value.mv_size));
+}
+
 /**
  * @overload get
  *    Return the value of the record to which the cursor points.
@@ -1047,6 +2017,10 @@ static VALUE cursor_get(VALUE self) {
  *       keys with this flag will cause data corruption.
  *   @option options [Boolean] :appenddup As above, but for sorted dup
  *       data.
+ *   @option options [Boolean] :nearby The key is at or shortly after
+ *       the cursor's current position. The key is searched for from
+ *       there instead of from the root, as by {#seek_forward}, which
+ *       saves most of the descent when inserting clustered keys.
  */
 static VALUE cursor_put(int argc, VALUE* argv, VALUE self) {
         CURSOR(self, cursor);
@@ -1113,6 +2087,315 @@ static VALUE cursor_count(VALUE self) {
         return SIZET2NUM(count);
 }
 
+static void writer_check(Writer* writer) {
+        if (writer->closed)
+                rb_raise(cError, "Writer is closed");
+}
+
+// The writer thread needs the write lock to commit, so waiting for it
+// while this thread holds a write transaction would never return.
+static void writer_check_wait(Writer* writer) {
+        VALUE vtxn = environment_active_txn(writer->env);
+        if (NIL_P(vtxn))
+                return;
+        TRANSACTION(vtxn, transaction);
+        if (transaction->txn && !(transaction->flags & MDB_RDONLY))
+                rb_raise(cError, "Cannot wait for the writer in a write transaction");
+}
+
+// The environment keeps its open writers alive, so an open writer is
+// only collected along with it. Its MDB_env is never closed then, and
+// the writer thread can still finish and be joined.
+static void writer_free(Writer* writer) {
+        if (!writer->closed) {
+                rb_warn("Garbage collecting open writer");
+                write_queue_close(writer->queue);
+        }
+        write_queue_free(writer->queue);
+        free(writer);
+}
+
+static void writer_mark(Writer* writer) {
+        rb_gc_mark(writer->env);
+}
+
+static int writer_options(VALUE key, VALUE value, WriterOptions* options) {
+        ID id = rb_to_id(key);
+
+        if (id == rb_intern("max_batch"))
+                options->max_batch = NUM2SSIZET(value);
+        else if (id == rb_intern("max_delay"))
+                options->max_delay = NUM2DBL(value);
+        else {
+                VALUE s = rb_inspect(key);
+                rb_raise(cError, "Invalid option %s", StringValueCStr(s));
+        }
+
+        return 0;
+}
+
+/**
+ * @overload writer(options)
+ *   Start a {Writer}, a background thread which applies puts and
+ *   deletes submitted by any number of threads in batched write
+ *   transactions.  If a block is given, the writer is passed to it
+ *   and closed when the block exits.
+ *   @option options [Integer] :max_batch (1000) The most operations
+ *       to apply in one transaction.
+ *   @option options [Float] :max_delay (0) How many seconds to hold a
+ *       transaction open for more operations before committing it.
+ *       By default the writer commits as soon as it has applied
+ *       everything submitted, and operations arriving meanwhile go
+ *       into the next batch.
+ *   @yield [writer] A block to run with the writer
+ *   @return [Writer] the writer, or the value of the block
+ *   @example
+ *      env.writer(:max_batch => 500) do |writer|
+ *        futures = records.map { |k, v| writer.put(db, k, v) }
+ *        futures.each(&:value)
+ *      end
+ */
+static VALUE environment_writer(int argc, VALUE *argv, VALUE self) {
+        ENVIRONMENT(self, environment);
+
+        VALUE option_hash;
+        rb_scan_args(argc, argv, ":", &option_hash);
+
+        WriterOptions options = {
+                .max_batch = 1000,
+                .max_delay = 0,
+        };
+        if (!NIL_P(option_hash))
+                rb_hash_foreach(option_hash, writer_options, (VALUE)&options);
+        if (options.max_batch < 1)
+                rb_raise(cError, "Batch size must be positive");
+        if (options.max_delay < 0)
+                rb_raise(cError, "Delay must not be negative");
+
+        WriteQueue* queue;
+        check(write_queue_new(environment->env, options.max_batch, options.max_delay, &queue));
+
+        Writer* writer;
+        VALUE vwriter = Data_Make_Struct(cWriter, Writer, writer_mark, writer_free, writer);
+        writer->env = self;
+        writer->queue = queue;
+        rb_ary_push(environment->writers, vwriter);
+
+        if (rb_block_given_p())
+                return rb_ensure(rb_yield, vwriter, writer_close, vwriter);
+
+        return vwriter;
+}
+
+static VALUE writer_future(VALUE self) {
+        WRITER(self, writer);
+        Future* future;
+        VALUE vfuture = Data_Make_Struct(cFuture, Future, future_mark, future_free, future);
+        future->writer = self;
+        future->queue = writer->queue;
+        return vfuture;
+}
+
+static Database* writer_database(Writer* writer, VALUE vdb) {
+        if (!rb_obj_is_kind_of(vdb, cDatabase))
+                rb_raise(rb_eTypeError, "Expected LMDB::Database");
+        DATABASE(vdb, database);
+        if (database->env != writer->env)
+                rb_raise(cError, "Database belongs to another environment");
+        return database;
+}
+
+/**
+ * @overload put(db, key, value, options)
+ *   Submit a put to the writer.  Takes the same options as
+ *   {Database#put}.
+ *   @return [Future] the outcome of the put
+ */
+static VALUE writer_put(int argc, VALUE *argv, VALUE self) {
+        WRITER(self, writer);
+
+        VALUE vdb, vkey, vval, option_hash;
+        rb_scan_args(argc, argv, "3:", &vdb, &vkey, &vval, &option_hash);
+        Database* database = writer_database(writer, vdb);
+
+        int flags = 0;
+        if (!NIL_P(option_hash))
+                rb_hash_foreach(option_hash, database_put_flags, (VALUE)&flags);
+
+        vkey = StringValue(vkey);
+        vval = StringValue(vval);
+
+        MDB_val key, value;
+        key.mv_size = RSTRING_LEN(vkey);
+        key.mv_data = RSTRING_PTR(vkey);
+        value.mv_size = RSTRING_LEN(vval);
+        value.mv_data = RSTRING_PTR(vval);
+
+        // Allocate the future first, so the op cannot leak
+        VALUE vfuture = writer_future(self);
+        FUTURE(vfuture, future);
+        check(write_queue_put(writer->queue, database->dbi, &key, &value, flags, &future->op));
+        return vfuture;
+}
+
+/**
+ * @overload delete(db, key, value=nil)
+ *   Submit a delete to the writer, as done by {Database#delete}.
+ *   @return [Future] the outcome of the delete
+ */
+static VALUE writer_delete(int argc, VALUE *argv, VALUE self) {
+        WRITER(self, writer);
+
+        VALUE vdb, vkey, vval;
+        rb_scan_args(argc, argv, "21", &vdb, &vkey, &vval);
+        Database* database = writer_database(writer, vdb);
+
+        vkey = StringValue(vkey);
+
+        MDB_val key, value;
+        key.mv_size = RSTRING_LEN(vkey);
+        key.mv_data = RSTRING_PTR(vkey);
+        if (!NIL_P(vval)) {
+                vval = StringValue(vval);
+                value.mv_size = RSTRING_LEN(vval);
+                value.mv_data = RSTRING_PTR(vval);
+        }
+
+        VALUE vfuture = writer_future(self);
+        FUTURE(vfuture, future);
+        check(write_queue_del(writer->queue, database->dbi, &key, NIL_P(vval) ? 0 : &value, &future->op));
+        return vfuture;
+}
+
+/**
+ * @overload flush
+ *   Wait until everything submitted so far has been committed.
+ *   @raise [Error] if the calling thread is in a write transaction of
+ *       the environment, which the writer would wait for forever.
+ */
+static VALUE writer_flush(VALUE self) {
+        WRITER(self, writer);
+        VALUE vfuture = writer_future(self);
+        FUTURE(vfuture, future);
+        check(write_queue_barrier(writer->queue, &future->op));
+        future_wait(vfuture);
+        return Qnil;
+}
+
+static void* writer_join(void* arg) {
+        Writer* writer = (Writer*)arg;
+        write_queue_close(writer->queue);
+        return 0;
+}
+
+/**
+ * @overload close
+ *   Apply and commit everything submitted so far, and stop the
+ *   writer thread.
+ *   @raise [Error] if the calling thread is in a write transaction of
+ *       the environment.
+ */
+static VALUE writer_close(VALUE self) {
+        Writer* writer;
+        Data_Get_Struct(self, Writer, writer);
+        if (writer->closed)
+                return Qnil;
+        writer_check_wait(writer);
+
+        writer->closed = 1;
+        rb_thread_call_without_gvl(writer_join, writer, 0, 0);
+
+        Environment* environment;
+        Data_Get_Struct(writer->env, Environment, environment);
+        rb_ary_delete(environment->writers, self);
+        return Qnil;
+}
+
+/**
+ * @overload stat
+ *   Return statistics about the writer.
+ *   @return [Hash]
+ *   * +:ops+ Number of operations applied
+ *   * +:batches+ Number of transactions committed
+ *   * +:sleeps+ Number of times the writer thread ran out of work
+ */
+static VALUE writer_stat(VALUE self) {
+        Writer* writer;
+        Data_Get_Struct(self, Writer, writer);
+        WriteQueueStat stat;
+        write_queue_stat(writer->queue, &stat);
+
+        VALUE ret = rb_hash_new();
+
+#define STAT_SET(name) rb_hash_aset(ret, ID2SYM(rb_intern(#name)), SIZET2NUM(stat.name))
+        STAT_SET(ops);
+        STAT_SET(batches);
+        STAT_SET(sleeps);
+#undef STAT_SET
+
+        return ret;
+}
+
+static void future_free(Future* future) {
+        if (future->op)
+                write_op_release(future->op);
+        free(future);
+}
+
+static void future_mark(Future* future) {
+        rb_gc_mark(future->writer);
+}
+
+static void* future_block(void* arg) {
+        Future* future = (Future*)arg;
+        write_queue_wait(future->queue, future->op);
+        return 0;
+}
+
+static void future_interrupt(void* arg) {
+        Future* future = (Future*)arg;
+        write_queue_interrupt(future->queue, future->op);
+}
+
+static void future_wait(VALUE self) {
+        FUTURE(self, future);
+        if (!write_op_done(future->op)) {
+                Writer* writer;
+                Data_Get_Struct(future->writer, Writer, writer);
+                writer_check_wait(writer);
+        }
+        while (!write_op_done(future->op))
+                rb_thread_call_without_gvl(future_block, future, future_interrupt, future);
+}
+
+/**
+ * @overload value
+ *   Wait until the operation has been committed.  A thread in a write
+ *   transaction of the environment cannot wait, since the writer needs
+ *   the write lock to commit.
+ *   @return nil
+ *   @raise [Error] if the operation failed.  Errors other than
+ *       {Error::NOTFOUND} and {Error::KEYEXIST} fail every operation
+ *       of the transaction they were applied in.  Also raised if the
+ *       operation is still pending and the calling thread is in a
+ *       write transaction.
+ */
+static VALUE future_value(VALUE self) {
+        FUTURE(self, future);
+        future_wait(self);
+        check(write_op_result(future->op));
+        return Qnil;
+}
+
+/**
+ * @overload done?
+ *   @return [Boolean] whether the operation has completed
+ */
+static VALUE future_done_p(VALUE self) {
+        FUTURE(self, future);
+        return write_op_done(future->op) ? Qtrue : Qfalse;
+}
+
 void Init_lmdb_ext() {
         VALUE mLMDB;
 
@@ -1173,13 +2456,18 @@ void Init_lmdb_ext() {
         rb_define_method(cEnvironment, "close", environment_close, 0);
         rb_define_method(cEnvironment, "stat", environment_stat, 0);
         rb_define_method(cEnvironment, "info", environment_info, 0);
+        rb_define_method(cEnvironment, "max_key_size", environment_max_key_size, 0);
         rb_define_method(cEnvironment, "copy", environment_copy, 1);
         rb_define_method(cEnvironment, "sync", environment_sync, -1);
+        rb_define_method(cEnvironment, "auto_sync", environment_auto_sync, -1);
+        rb_define_method(cEnvironment, "sync_stat", environment_sync_stat, 0);
+        rb_define_method(cEnvironment, "arena_stat", environment_arena_stat, 0);
         rb_define_method(cEnvironment, "set_flags", environment_set_flags, -1);
         rb_define_method(cEnvironment, "clear_flags", environment_clear_flags, -1);
         rb_define_method(cEnvironment, "flags", environment_flags, 0);
         rb_define_method(cEnvironment, "path", environment_path, 0);
         rb_define_method(cEnvironment, "transaction", environment_transaction, -1);
+        rb_define_method(cEnvironment, "writer", environment_writer, -1);
 
         /**
          * Document-class: LMDB::Database
@@ -1209,12 +2497,17 @@ void Init_lmdb_ext() {
         cDatabase = rb_define_class_under(mLMDB, "Database", rb_cObject);
         rb_undef_method(rb_singleton_class(cDatabase), "new");
         rb_define_method(cDatabase, "stat", database_stat, 0);
+        rb_define_method(cDatabase, "fill_histogram", database_fill_histogram, -1);
+        rb_define_method(cDatabase, "estimate_range", database_estimate_range, 2);
         rb_define_method(cDatabase, "drop", database_drop, 0);
         rb_define_method(cDatabase, "clear", database_clear, 0);
         rb_define_method(cDatabase, "get", database_get, 1);
         rb_define_method(cDatabase, "put", database_put, -1);
         rb_define_method(cDatabase, "delete", database_delete, -1);
+        rb_define_method(cDatabase, "delete_range", database_delete_range, 2);
         rb_define_method(cDatabase, "cursor", database_cursor, 0);
+        rb_define_method(cDatabase, "bulk_load", database_bulk_load, -1);
+        rb_define_method(cDatabase, "ingest", database_ingest, -1);
 
         /**
          * Document-class: LMDB::Transaction
@@ -1314,7 +2607,55 @@ void Init_lmdb_ext() {
         rb_define_method(cCursor, "prev", cursor_prev, 0);
         rb_define_method(cCursor, "set", cursor_set, 1);
         rb_define_method(cCursor, "set_range", cursor_set_range, 1);
+        rb_define_method(cCursor, "seek_forward", cursor_seek_forward, 1);
         rb_define_method(cCursor, "put", cursor_put, -1);
         rb_define_method(cCursor, "count", cursor_count, 0);
         rb_define_method(cCursor, "delete", cursor_delete, -1);
+
+        /**
+         * Document-class: LMDB::Writer
+         *
+         * A Writer owns the write transactions of an {Environment} on a
+         * background thread.  Any number of threads can submit puts and
+         * deletes, which return at once with a {Writer::Future}.  The
+         * writer thread applies whatever has been submitted in batches,
+         * one transaction per batch, so the submitting threads neither
+         * take turns on the environment's write lock nor pay for a
+         * commit each.
+         *
+         * Submitted operations are applied in order.  Do not wait for a
+         * future while holding a write transaction on the same
+         * environment, as the writer needs that lock to make progress.
+         *
+         * To create a writer, call {Environment#writer}.
+         *
+         * @example Typical usage
+         *    env = LMDB.new "databasedir"
+         *    db = env.database
+         *    writer = env.writer
+         *    threads = 8.times.map do |t|
+         *      Thread.new do
+         *        1000.times.map { |i| writer.put(db, "#{t}-#{i}", "value") }.each(&:value)
+         *      end
+         *    end
+         *    threads.each(&:join)
+         *    writer.close
+         */
+        cWriter = rb_define_class_under(mLMDB, "Writer", rb_cObject);
+        rb_undef_method(rb_singleton_class(cWriter), "new");
+        rb_define_method(cWriter, "put", writer_put, -1);
+        rb_define_method(cWriter, "delete", writer_delete, -1);
+        rb_define_method(cWriter, "flush", writer_flush, 0);
+        rb_define_method(cWriter, "close", writer_close, 0);
+        rb_define_method(cWriter, "stat", writer_stat, 0);
+
+        /**
+         * Document-class: LMDB::Writer::Future
+         *
+         * The outcome of an operation submitted to a {Writer}.
+         */
+        cFuture = rb_define_class_under(cWriter, "Future", rb_cObject);
+        rb_undef_method(rb_singleton_class(cFuture), "new");
+        rb_define_method(cFuture, "value", future_value, 0);
+        rb_define_method(cFuture, "done?", future_done_p, 0);
 }
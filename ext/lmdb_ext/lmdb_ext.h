@@ -3,6 +3,15 @@
 
 #include "ruby.h"
 #include "lmdb.h"
+#include "sorter.h"
+#include "write_queue.h"
+#include "syncer.h"
+#include <time.h>
+#include <sys/resource.h>
+
+#ifdef HAVE_RUBY_THREAD_H
+#  include "ruby/thread.h"
+#endif
 
 // Ruby 1.8 compatibility
 #ifndef SIZET2NUM
@@ -24,6 +33,16 @@
 #  endif
 #endif
 
+// Ruby 1.9 compatibility
+#ifndef RB_BLOCK_CALL_FUNC_ARGLIST
+#  define RB_BLOCK_CALL_FUNC_ARGLIST(yielded_arg, callback_arg) VALUE yielded_arg, VALUE callback_arg, int argc, VALUE* argv
+#endif
+
+// Ruby 1.9 compatibility
+#ifndef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+#  define rb_thread_call_without_gvl(fn, arg, ubf, arg2) (fn)(arg)
+#endif
+
 #define ENVIRONMENT(var, var_env)                       \
         Environment* var_env;                           \
         Data_Get_Struct(var, Environment, var_env);     \
@@ -42,17 +61,44 @@
         Data_Get_Struct(var, Cursor, var_cur);  \
         cursor_check(var_cur)
 
+#define WRITER(var, var_writer)                         \
+        Writer* var_writer;                             \
+        Data_Get_Struct(var, Writer, var_writer);       \
+        writer_check(var_writer)
+
+#define FUTURE(var, var_future)                         \
+        Future* var_future;                             \
+        Data_Get_Struct(var, Future, var_future)
+
 typedef struct {
         VALUE    env;
         VALUE    parent;
         VALUE    thread;
         MDB_txn* txn;
+        int      flags;         /* flags the txn was begun with */
 } Transaction;
 
 typedef struct {
         MDB_env* env;
-        VALUE    thread_txn_hash;
-        VALUE    txn_thread_hash;
+        MDB_txn* txn;           /* shared write transaction, owned by the leader */
+        int      rc;            /* result of beginning, then of committing txn */
+        int      started;       /* txn has been begun */
+        int      done;          /* txn has been committed or aborted */
+        int      busy;          /* a member is running its block */
+        int      members;       /* members which have joined */
+        int      finished;      /* members whose block has run */
+        int      refs;          /* members still using the batch */
+} GroupBatch;
+
+typedef struct {
+        MDB_env*    env;
+        VALUE       thread_txn_hash;
+        VALUE       txn_thread_hash;
+        int         group_commit;
+        VALUE       group_waiters;      /* threads waiting on a batch */
+        GroupBatch* group_batch;        /* batch still accepting members */
+        VALUE       writers;            /* open writers, kept alive until closed */
+        Syncer*     syncer;             /* auto_sync thread, if running */
 } Environment;
 
 typedef struct {
@@ -65,6 +111,18 @@ typedef struct {
         MDB_cursor* cur;
 } Cursor;
 
+typedef struct {
+        VALUE       env;
+        WriteQueue* queue;
+        int         closed;
+} Writer;
+
+typedef struct {
+        VALUE       writer;
+        WriteQueue* queue;
+        WriteOp*    op;
+} Future;
+
 typedef struct {
         VALUE self;
         const char* name;
@@ -72,15 +130,91 @@ typedef struct {
         const VALUE* argv;
 } HelperArgs;
 
+typedef struct {
+        VALUE       env;
+        VALUE       (*fn)(VALUE);
+        VALUE       arg;
+        GroupBatch* batch;
+        int         leader;
+        int         ran;
+        int         exception;
+        int         interrupt;
+        int         rc;
+        VALUE       ret;
+} GroupArgs;
+
+typedef struct {
+        MDB_env* env;
+        MDB_txn* txn;
+        int      rc;
+} GroupCall;
+
 typedef struct {
         mode_t mode;
         int    flags;
         int    maxreaders;
         int    maxdbs;
+        int    maxdirty;
+        int    group_commit;
         size_t mapsize;
+        unsigned int pagesize;
+        size_t arena;
+        size_t arena_retain;
+        int    arena_flags;
 } EnvironmentOptions;
 
-static VALUE cEnvironment, cDatabase, cTransaction, cCursor, cError;
+typedef struct {
+        int    flags;
+        double split_ratio;
+        double merge_threshold;
+} DatabaseOptions;
+
+typedef struct {
+        double interval;
+        size_t max_dirty_bytes;
+} AutoSyncOptions;
+
+typedef struct {
+        MDB_env* env;
+        Syncer*  syncer;
+        int      force;
+        int      rc;
+} SyncArgs;
+
+typedef struct {
+        double fill;
+} BulkLoadOptions;
+
+typedef struct {
+        VALUE       enumerable;
+        MDB_loader* loader;
+} BulkLoadArgs;
+
+typedef struct {
+        ssize_t memory;
+        VALUE   tmpdir;
+        double  fill;
+} IngestOptions;
+
+typedef struct {
+        VALUE        enumerable;
+        MDB_txn*     txn;
+        MDB_dbi      dbi;
+        unsigned int fill;
+        size_t       memory;
+        Sorter*      sorter;
+        MDB_loader*  loader;
+        size_t       entries;
+        SorterStat   stat;
+        int          rc;
+} IngestArgs;
+
+typedef struct {
+        size_t max_batch;
+        double max_delay;
+} WriterOptions;
+
+static VALUE cEnvironment, cDatabase, cTransaction, cCursor, cWriter, cFuture, cError;
 
 #define ERROR(name) static VALUE cError_##name;
 #include "errors.h"
@@ -89,6 +223,14 @@ static VALUE cEnvironment, cDatabase, cTransaction, cCursor, cError;
 // BEGIN PROTOTYPES
 void Init_lmdb_ext();
 static MDB_txn* active_txn(VALUE self);
+static int auto_sync_options(VALUE key, VALUE value, AutoSyncOptions* options);
+static int auto_sync_stop(Environment* environment);
+static VALUE bulk_load_abort(VALUE arg);
+static unsigned int bulk_load_check(MDB_txn* txn, MDB_dbi dbi, double fill);
+static VALUE bulk_load_each(VALUE arg);
+static int bulk_load_options(VALUE key, VALUE value, BulkLoadOptions* options);
+static VALUE bulk_load_pair(RB_BLOCK_CALL_FUNC_ARGLIST(pair, arg));
+static void bulk_load_values(VALUE pair, int argc, const VALUE* argv, MDB_val* key, MDB_val* value);
 static VALUE call_with_transaction(VALUE venv, VALUE self, const char* name, int argc, const VALUE* argv, int flags);
 static VALUE call_with_transaction_helper(VALUE arg);
 static void check(int code);
@@ -104,17 +246,26 @@ static void cursor_mark(Cursor* cursor);
 static VALUE cursor_next(VALUE self);
 static VALUE cursor_prev(VALUE self);
 static VALUE cursor_put(int argc, VALUE* argv, VALUE self);
+static VALUE cursor_seek_forward(VALUE self, VALUE vkey);
 static VALUE cursor_set(VALUE self, VALUE vkey);
 static VALUE cursor_set_range(VALUE self, VALUE vkey);
+static VALUE database_bulk_load(int argc, VALUE *argv, VALUE self);
 static VALUE database_clear(VALUE self);
 static VALUE database_cursor(VALUE self);
 static VALUE database_delete(int argc, VALUE *argv, VALUE self);
+static VALUE database_delete_range(VALUE self, VALUE vfrom, VALUE vto);
 static VALUE database_drop(VALUE self);
+static VALUE database_estimate_range(VALUE self, VALUE vfrom, VALUE vto);
+static VALUE database_fill_histogram(int argc, VALUE *argv, VALUE self);
 static VALUE database_get(VALUE self, VALUE vkey);
+static VALUE database_ingest(int argc, VALUE *argv, VALUE self);
 static void database_mark(Database* database);
+static int database_options(VALUE key, VALUE value, DatabaseOptions* options);
 static VALUE database_put(int argc, VALUE *argv, VALUE self);
 static VALUE database_stat(VALUE self);
 static VALUE environment_active_txn(VALUE self);
+static VALUE environment_arena_stat(VALUE self);
+static VALUE environment_auto_sync(int argc, VALUE *argv, VALUE self);
 static VALUE environment_change_flags(int argc, VALUE* argv, VALUE self, int set);
 static void environment_check(Environment* environment);
 static VALUE environment_clear_flags(int argc, VALUE* argv, VALUE self);
@@ -125,6 +276,7 @@ static VALUE environment_flags(VALUE self);
 static void environment_free(Environment *environment);
 static VALUE environment_info(VALUE self);
 static void environment_mark(Environment* environment);
+static VALUE environment_max_key_size(VALUE self);
 static VALUE environment_new(int argc, VALUE *argv, VALUE klass);
 static int environment_options(VALUE key, VALUE value, EnvironmentOptions* options);
 static VALUE environment_path(VALUE self);
@@ -132,15 +284,63 @@ static void environment_set_active_txn(VALUE self, VALUE thread, VALUE txn);
 static VALUE environment_set_flags(int argc, VALUE* argv, VALUE self);
 static VALUE environment_stat(VALUE self);
 static VALUE environment_sync(int argc, VALUE *argv, VALUE self);
+static VALUE environment_sync_stat(VALUE self);
 static VALUE environment_transaction(int argc, VALUE *argv, VALUE self);
+static VALUE environment_writer(int argc, VALUE *argv, VALUE self);
+static void* future_block(void* arg);
+static VALUE future_done_p(VALUE self);
+static void future_free(Future* future);
+static void future_interrupt(void* arg);
+static void future_mark(Future* future);
+static VALUE future_value(VALUE self);
+static void future_wait(VALUE self);
+static VALUE group_begin(VALUE arg);
+static VALUE group_block(VALUE arg);
+static void group_broadcast(Environment* environment);
+static VALUE group_commit(VALUE arg);
+static VALUE group_leave(VALUE arg);
+static VALUE group_run(VALUE arg);
+static VALUE group_sleep(VALUE unused);
+static VALUE group_transaction(VALUE venv, VALUE(*fn)(VALUE), VALUE arg);
+static void* group_txn_begin(void* arg);
+static void* group_txn_commit(void* arg);
+static VALUE group_unwait(VALUE venv);
+static VALUE group_wait(VALUE venv);
+static void ingest_call(IngestArgs* args, void* (*fn)(void*));
+static VALUE ingest_each(VALUE arg);
+static VALUE ingest_free(VALUE arg);
+static void ingest_interrupt(void* arg);
+static void* ingest_load(void* arg);
+static int ingest_options(VALUE key, VALUE value, IngestOptions* options);
+static VALUE ingest_pair(RB_BLOCK_CALL_FUNC_ARGLIST(pair, arg));
+static void* ingest_spill(void* arg);
+static double monotonic_time();
+static VALUE need_key(VALUE self, VALUE vkey);
 static MDB_txn* need_txn(VALUE self);
+static size_t peak_rss();
+static VALUE run_transaction(VALUE venv, MDB_txn* parent, VALUE(*fn)(VALUE), VALUE arg, int flags);
 static VALUE stat2hash(const MDB_stat* stat);
+static void* sync_env(void* arg);
+static void* sync_stop(void* arg);
 static VALUE transaction_abort(VALUE self);
 static VALUE transaction_commit(VALUE self);
 static void transaction_finish(VALUE self, int commit);
 static void transaction_free(Transaction* transaction);
 static void transaction_mark(Transaction* transaction);
 static VALUE with_transaction(VALUE venv, VALUE(*fn)(VALUE), VALUE arg, int flags);
+static void writer_check(Writer* writer);
+static void writer_check_wait(Writer* writer);
+static VALUE writer_close(VALUE self);
+static Database* writer_database(Writer* writer, VALUE vdb);
+static VALUE writer_delete(int argc, VALUE *argv, VALUE self);
+static VALUE writer_flush(VALUE self);
+static void writer_free(Writer* writer);
+static VALUE writer_future(VALUE self);
+static void* writer_join(void* arg);
+static void writer_mark(Writer* writer);
+static int writer_options(VALUE key, VALUE value, WriterOptions* options);
+static VALUE writer_put(int argc, VALUE *argv, VALUE self);
+static VALUE writer_stat(VALUE self);
 // END PROTOTYPES
 
 #endif
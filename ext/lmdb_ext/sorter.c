@@ -0,0 +1,500 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sorter.h"
+
+typedef struct {
+        uint32_t ksize;
+        uint32_t vsize;
+} Header;
+
+typedef struct {
+        FILE* file;
+        char* buf;
+        int   level;
+} Run;
+
+typedef struct {
+        FILE*   file;           /* NULL for the in-memory run */
+        char*   rec;
+        size_t  cap;
+        size_t  pos;
+        int     order;
+        MDB_val key;
+        MDB_val value;
+} Source;
+
+typedef struct {
+        FILE*  file;
+        size_t bytes;
+} Writer;
+
+typedef struct {
+        MDB_loader* loader;
+        size_t      entries;
+} Feeder;
+
+typedef int (*Emit)(void* ctx, MDB_val* key, MDB_val* value);
+
+struct Sorter {
+        MDB_txn*     txn;
+        MDB_dbi      dbi;
+        size_t       memory;    /* limit for buffered records and their index */
+        size_t       iobuf;     /* stdio buffer size per run file */
+        char*        tmpdir;
+        char*        data;
+        size_t       size;
+        size_t       capacity;
+        size_t*      index;
+        size_t*      scratch;
+        size_t       count;
+        size_t       slots;
+        Run*         runs;
+        size_t       nruns;
+        SorterStat   stat;
+        volatile int interrupted;
+};
+
+// Room left for record data next to the index of the buffered records
+static size_t sorter_limit(const Sorter* s) {
+        size_t index = s->count * 2 * sizeof(size_t);
+        return s->memory > index ? s->memory - index : 0;
+}
+
+static int io_error(void) {
+        return errno ? errno : EIO;
+}
+
+static void record_get(const char* p, MDB_val* key, MDB_val* value) {
+        Header h;
+        memcpy(&h, p, sizeof(h));
+        key->mv_size = h.ksize;
+        key->mv_data = (char*)p + sizeof(h);
+        value->mv_size = h.vsize;
+        value->mv_data = (char*)key->mv_data + h.ksize;
+}
+
+static int sorter_compare(Sorter* s, size_t a, size_t b) {
+        MDB_val ka, kb, v;
+        record_get(s->data + a, &ka, &v);
+        record_get(s->data + b, &kb, &v);
+        return mdb_cmp(s->txn, s->dbi, &ka, &kb);
+}
+
+/* Stable merge sort of record offsets, so that later duplicates stay later */
+static void sorter_sort(Sorter* s, size_t* a, size_t* tmp, size_t n) {
+        size_t i, j, k, h, x;
+
+        if (n < 16) {
+                for (i = 1; i < n; ++i) {
+                        x = a[i];
+                        for (j = i; j > 0 && sorter_compare(s, x, a[j - 1]) < 0; --j)
+                                a[j] = a[j - 1];
+                        a[j] = x;
+                }
+                return;
+        }
+
+        h = n / 2;
+        sorter_sort(s, a, tmp, h);
+        sorter_sort(s, a + h, tmp, n - h);
+        if (sorter_compare(s, a[h - 1], a[h]) <= 0)
+                return;
+
+        memcpy(tmp, a, h * sizeof(size_t));
+        for (i = 0, j = h, k = 0; i < h && j < n; )
+                a[k++] = sorter_compare(s, a[j], tmp[i]) < 0 ? a[j++] : tmp[i++];
+        while (i < h)
+                a[k++] = tmp[i++];
+}
+
+static int source_next(Sorter* s, Source* src) {
+        if (!src->file) {
+                if (src->pos == s->count)
+                        return MDB_NOTFOUND;
+                record_get(s->data + s->index[src->pos++], &src->key, &src->value);
+                return MDB_SUCCESS;
+        }
+
+        Header h;
+        if (fread(&h, sizeof(h), 1, src->file) != 1)
+                return ferror(src->file) ? io_error() : MDB_NOTFOUND;
+
+        size_t need = (size_t)h.ksize + h.vsize;
+        if (need > src->cap) {
+                char* rec = realloc(src->rec, need);
+                if (!rec)
+                        return ENOMEM;
+                src->rec = rec;
+                src->cap = need;
+        }
+        if (need && fread(src->rec, 1, need, src->file) != need)
+                return ferror(src->file) ? io_error() : EIO;
+
+        src->key.mv_size = h.ksize;
+        src->key.mv_data = src->rec;
+        src->value.mv_size = h.vsize;
+        src->value.mv_data = src->rec + h.ksize;
+        return MDB_SUCCESS;
+}
+
+static int source_less(Sorter* s, const Source* a, const Source* b) {
+        int c = mdb_cmp(s->txn, s->dbi, &a->key, &b->key);
+        return c < 0 || (c == 0 && a->order < b->order);
+}
+
+static void heap_down(Sorter* s, Source** heap, size_t len, size_t i) {
+        for (;;) {
+                size_t l = 2 * i + 1, m = i;
+                if (l < len && source_less(s, heap[l], heap[m]))
+                        m = l;
+                if (l + 1 < len && source_less(s, heap[l + 1], heap[m]))
+                        m = l + 1;
+                if (m == i)
+                        return;
+                Source* t = heap[i];
+                heap[i] = heap[m];
+                heap[m] = t;
+                i = m;
+        }
+}
+
+/*
+ * k-way merge of sorted sources. Of several records with the same key
+ * only the one from the source with the highest order is emitted.
+ */
+static int sorter_merge(Sorter* s, Source* src, size_t n, Emit emit, void* ctx) {
+        Source** heap = malloc(n * sizeof(Source*));
+        char* pending = 0;
+        size_t len = 0, cap = 0, i;
+        MDB_val pkey, pvalue;
+        int have = 0, rc = MDB_SUCCESS;
+
+        if (!heap)
+                return ENOMEM;
+
+        for (i = 0; i < n; ++i) {
+                src[i].order = i;
+                rc = source_next(s, &src[i]);
+                if (rc == MDB_NOTFOUND)
+                        continue;
+                if (rc)
+                        goto done;
+                heap[len++] = &src[i];
+        }
+        for (i = len / 2; i-- > 0; )
+                heap_down(s, heap, len, i);
+
+        rc = MDB_SUCCESS;
+        while (len) {
+                if (s->interrupted) {
+                        rc = EINTR;
+                        goto done;
+                }
+
+                Source* top = heap[0];
+                if (have && mdb_cmp(s->txn, s->dbi, &top->key, &pkey) && (rc = emit(ctx, &pkey, &pvalue)))
+                        goto done;
+
+                // Hold on to the record until we know no later one has the same key
+                size_t need = top->key.mv_size + top->value.mv_size;
+                if (need > cap) {
+                        char* p = realloc(pending, need);
+                        if (!p) {
+                                rc = ENOMEM;
+                                goto done;
+                        }
+                        pending = p;
+                        cap = need;
+                }
+                pkey.mv_size = top->key.mv_size;
+                pkey.mv_data = memcpy(pending, top->key.mv_data, top->key.mv_size);
+                pvalue.mv_size = top->value.mv_size;
+                pvalue.mv_data = memcpy(pending + pkey.mv_size, top->value.mv_data, top->value.mv_size);
+                have = 1;
+
+                rc = source_next(s, top);
+                if (rc == MDB_NOTFOUND)
+                        heap[0] = heap[--len];
+                else if (rc)
+                        goto done;
+                heap_down(s, heap, len, 0);
+        }
+        rc = have ? emit(ctx, &pkey, &pvalue) : MDB_SUCCESS;
+
+done:
+        free(pending);
+        free(heap);
+        return rc;
+}
+
+static int sorter_write(void* ctx, MDB_val* key, MDB_val* value) {
+        Writer* w = (Writer*)ctx;
+        Header h = { key->mv_size, value->mv_size };
+
+        if (fwrite(&h, sizeof(h), 1, w->file) != 1 ||
+            fwrite(key->mv_data, 1, key->mv_size, w->file) != key->mv_size ||
+            (value->mv_size && fwrite(value->mv_data, 1, value->mv_size, w->file) != value->mv_size))
+                return io_error();
+
+        w->bytes += sizeof(h) + key->mv_size + value->mv_size;
+        return MDB_SUCCESS;
+}
+
+static int sorter_feed(void* ctx, MDB_val* key, MDB_val* value) {
+        Feeder* f = (Feeder*)ctx;
+        int rc = mdb_loader_put(f->loader, key, value);
+        if (!rc)
+                ++f->entries;
+        return rc;
+}
+
+static int sorter_tempfile(Sorter* s, Run* run) {
+        size_t len = strlen(s->tmpdir) + sizeof("/lmdb-sort-XXXXXX");
+        char* path = malloc(len);
+        int fd, rc;
+
+        if (!path)
+                return ENOMEM;
+        snprintf(path, len, "%s/lmdb-sort-XXXXXX", s->tmpdir);
+        fd = mkstemp(path);
+        rc = errno;
+        if (fd >= 0)
+                unlink(path);
+        free(path);
+        if (fd < 0)
+                return rc;
+
+        run->level = 0;
+        run->buf = malloc(s->iobuf);
+        run->file = run->buf ? fdopen(fd, "w+b") : 0;
+        if (!run->file) {
+                rc = run->buf ? io_error() : ENOMEM;
+                free(run->buf);
+                close(fd);
+                return rc;
+        }
+        setvbuf(run->file, run->buf, _IOFBF, s->iobuf);
+        return MDB_SUCCESS;
+}
+
+static void run_close(Run* run) {
+        fclose(run->file);
+        free(run->buf);
+}
+
+static int run_finish(Run* run) {
+        if (fflush(run->file) || fseek(run->file, 0, SEEK_SET))
+                return io_error();
+        return MDB_SUCCESS;
+}
+
+/* Replace runs [first, first + n) by a single run holding their merged contents */
+static int sorter_merge_runs(Sorter* s, size_t first, size_t n, int level) {
+        Source* src = calloc(n, sizeof(Source));
+        Run out;
+        size_t i;
+        int rc;
+
+        if (!src)
+                return ENOMEM;
+
+        if ((rc = sorter_tempfile(s, &out))) {
+                free(src);
+                return rc;
+        }
+
+        for (i = 0; i < n; ++i)
+                src[i].file = s->runs[first + i].file;
+
+        Writer w = { out.file, 0 };
+        rc = sorter_merge(s, src, n, sorter_write, &w);
+        if (!rc)
+                rc = run_finish(&out);
+
+        for (i = 0; i < n; ++i)
+                free(src[i].rec);
+        free(src);
+
+        if (rc) {
+                run_close(&out);
+                return rc;
+        }
+
+        for (i = 0; i < n; ++i)
+                run_close(&s->runs[first + i]);
+        memmove(s->runs + first + 1, s->runs + first + n, (s->nruns - first - n) * sizeof(Run));
+        out.level = level;
+        s->runs[first] = out;
+        s->nruns -= n - 1;
+        s->stat.spilled += w.bytes;
+        return MDB_SUCCESS;
+}
+
+int sorter_new(MDB_txn* txn, MDB_dbi dbi, size_t memory, const char* tmpdir, Sorter** ret) {
+        Sorter* s = calloc(1, sizeof(Sorter));
+        if (!s)
+                return ENOMEM;
+
+        s->txn = txn;
+        s->dbi = dbi;
+        // A third of the budget goes to the read buffers of the final merge
+        s->memory = memory - memory / 3;
+        s->iobuf = memory / 3 / SORTER_FANIN;
+        if (s->iobuf < 4096)
+                s->iobuf = 4096;
+        s->runs = malloc(SORTER_FANIN * 8 * sizeof(Run));
+        s->tmpdir = strdup(tmpdir);
+        if (!s->runs || !s->tmpdir) {
+                sorter_free(s);
+                return ENOMEM;
+        }
+
+        *ret = s;
+        return MDB_SUCCESS;
+}
+
+int sorter_add(Sorter* s, const MDB_val* key, const MDB_val* value) {
+        size_t need = sizeof(Header) + key->mv_size + value->mv_size;
+
+        if (key->mv_size > UINT32_MAX || value->mv_size > UINT32_MAX)
+                return MDB_BAD_VALSIZE;
+
+        if (s->size + need > s->capacity) {
+                size_t cap = s->capacity ? s->capacity : 65536;
+                size_t limit = sorter_limit(s);
+                while (cap < s->size + need)
+                        cap *= 2;
+                if (cap > limit && s->size + need <= limit)
+                        cap = limit;
+                char* data = realloc(s->data, cap);
+                if (!data)
+                        return ENOMEM;
+                s->data = data;
+                s->capacity = cap;
+        }
+
+        if (s->count == s->slots) {
+                size_t slots = s->slots ? 2 * s->slots : 4096;
+                size_t* index = realloc(s->index, slots * sizeof(size_t));
+                if (!index)
+                        return ENOMEM;
+                s->index = index;
+                size_t* scratch = realloc(s->scratch, slots * sizeof(size_t));
+                if (!scratch)
+                        return ENOMEM;
+                s->scratch = scratch;
+                s->slots = slots;
+        }
+
+        Header h = { key->mv_size, value->mv_size };
+        char* p = s->data + s->size;
+        memcpy(p, &h, sizeof(h));
+        memcpy(p + sizeof(h), key->mv_data, key->mv_size);
+        memcpy(p + sizeof(h) + key->mv_size, value->mv_data, value->mv_size);
+
+        s->index[s->count++] = s->size;
+        s->size += need;
+        ++s->stat.records;
+        return MDB_SUCCESS;
+}
+
+int sorter_full(const Sorter* s) {
+        return s->size >= sorter_limit(s);
+}
+
+int sorter_spill(Sorter* s) {
+        Source mem = { 0 };
+        Run run;
+        int rc;
+
+        if (!s->count)
+                return MDB_SUCCESS;
+
+        sorter_sort(s, s->index, s->scratch, s->count);
+
+        if (s->nruns == SORTER_FANIN * 8)
+                return ENOMEM;
+        if ((rc = sorter_tempfile(s, &run)))
+                return rc;
+
+        Writer w = { run.file, 0 };
+        if ((rc = sorter_merge(s, &mem, 1, sorter_write, &w)) || (rc = run_finish(&run))) {
+                run_close(&run);
+                return rc;
+        }
+
+        s->runs[s->nruns++] = run;
+        s->stat.runs++;
+        s->stat.spilled += w.bytes;
+        s->size = s->count = 0;
+
+        // Merge the newest runs as soon as there are enough of the same size
+        while (s->nruns >= SORTER_FANIN) {
+                size_t first = s->nruns - SORTER_FANIN;
+                int level = s->runs[first].level;
+                if (s->runs[s->nruns - 1].level != level)
+                        break;
+                if ((rc = sorter_merge_runs(s, first, SORTER_FANIN, level + 1)))
+                        return rc;
+        }
+        return MDB_SUCCESS;
+}
+
+int sorter_load(Sorter* s, MDB_loader* loader, size_t* entries) {
+        Source* src;
+        size_t i, n;
+        int rc;
+
+        if (s->count)
+                sorter_sort(s, s->index, s->scratch, s->count);
+
+        // Leave room for the in-memory run in the final merge
+        while (s->nruns > SORTER_FANIN - 1) {
+                n = s->nruns - SORTER_FANIN + 2;
+                if (n > SORTER_FANIN)
+                        n = SORTER_FANIN;
+                if ((rc = sorter_merge_runs(s, 0, n, s->runs[0].level + 1)))
+                        return rc;
+        }
+
+        n = s->nruns + 1;
+        if (!(src = calloc(n, sizeof(Source))))
+                return ENOMEM;
+        for (i = 0; i < s->nruns; ++i)
+                src[i].file = s->runs[i].file;
+
+        Feeder f = { loader, 0 };
+        rc = sorter_merge(s, src, n, sorter_feed, &f);
+        *entries = f.entries;
+
+        for (i = 0; i < n; ++i)
+                free(src[i].rec);
+        free(src);
+        return rc;
+}
+
+void sorter_interrupt(Sorter* s) {
+        s->interrupted = 1;
+}
+
+void sorter_stat(const Sorter* s, SorterStat* stat) {
+        *stat = s->stat;
+}
+
+void sorter_free(Sorter* s) {
+        size_t i;
+        for (i = 0; i < s->nruns; ++i)
+                run_close(&s->runs[i]);
+        free(s->runs);
+        free(s->tmpdir);
+        free(s->data);
+        free(s->index);
+        free(s->scratch);
+        free(s);
+}
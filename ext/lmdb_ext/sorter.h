@@ -0,0 +1,38 @@
+#ifndef _SORTER_H
+#define _SORTER_H
+
+#include <stddef.h>
+#include "lmdb.h"
+
+/*
+ * External merge sort of key/value records, used to feed unsorted
+ * input into an MDB_loader. Records are buffered in memory, sorted
+ * with the database's comparison function and spilled as sorted runs
+ * to unlinked temporary files. Runs are merged in tiers of at most
+ * SORTER_FANIN files, and the final merge streams straight into the
+ * loader. When the same key occurs more than once, the last one wins.
+ *
+ * Nothing in here touches Ruby, so sorter_spill and sorter_load can
+ * run without the GVL.
+ */
+
+#define SORTER_FANIN 64
+
+typedef struct Sorter Sorter;
+
+typedef struct {
+        size_t records;         /* records added */
+        size_t runs;            /* runs spilled to disk */
+        size_t spilled;         /* bytes written to temporary files */
+} SorterStat;
+
+int  sorter_new(MDB_txn* txn, MDB_dbi dbi, size_t memory, const char* tmpdir, Sorter** ret);
+int  sorter_add(Sorter* sorter, const MDB_val* key, const MDB_val* value);
+int  sorter_full(const Sorter* sorter);
+int  sorter_spill(Sorter* sorter);
+int  sorter_load(Sorter* sorter, MDB_loader* loader, size_t* entries);
+void sorter_interrupt(Sorter* sorter);
+void sorter_stat(const Sorter* sorter, SorterStat* stat);
+void sorter_free(Sorter* sorter);
+
+#endif
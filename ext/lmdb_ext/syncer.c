@@ -0,0 +1,141 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "syncer.h"
+
+struct Syncer {
+        MDB_env*        env;
+        double          interval;
+        size_t          max_dirty;
+        int             stopping;
+        double          last_sync;      /* monotonic time the last sync started */
+        pthread_t       thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t  wake;
+        SyncerStat      stat;
+};
+
+static double syncer_now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sleep for up to the given number of seconds, or until stopped
+static void syncer_sleep(Syncer* s, double seconds) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double t = deadline.tv_nsec / 1e9 + seconds;
+        deadline.tv_sec += (time_t)t;
+        deadline.tv_nsec = (long)((t - (time_t)t) * 1e9);
+        if (!s->stopping)
+                pthread_cond_timedwait(&s->wake, &s->mutex, &deadline);
+}
+
+// Called with the mutex held, which is dropped for the sync itself
+static int syncer_sync(Syncer* s) {
+        double start = syncer_now();
+        pthread_mutex_unlock(&s->mutex);
+        int rc = mdb_env_sync(s->env, 1);
+        double latency = syncer_now() - start;
+        pthread_mutex_lock(&s->mutex);
+
+        if (rc) {
+                s->stat.errors++;
+                s->stat.last_error = rc;
+                return rc;
+        }
+        s->last_sync = start;
+        s->stat.syncs++;
+        s->stat.last_latency = latency;
+        s->stat.total_latency += latency;
+        if (latency > s->stat.max_latency)
+                s->stat.max_latency = latency;
+        return 0;
+}
+
+static size_t syncer_unsynced(Syncer* s) {
+        size_t bytes = 0;
+        mdb_env_get_unsynced(s->env, &bytes);
+        return bytes;
+}
+
+static void* syncer_main(void* arg) {
+        Syncer* s = (Syncer*)arg;
+        double next = syncer_now() + s->interval;
+
+        pthread_mutex_lock(&s->mutex);
+        while (!s->stopping) {
+                double wait = next - syncer_now();
+                if (s->max_dirty && wait > SYNCER_POLL)
+                        wait = SYNCER_POLL;
+                if (wait > 0)
+                        syncer_sleep(s, wait);
+                if (s->stopping)
+                        break;
+
+                int due = syncer_now() >= next;
+                size_t unsynced = syncer_unsynced(s);
+                if (unsynced && (due || (s->max_dirty && unsynced >= s->max_dirty))) {
+                        syncer_sync(s);
+                        due = 1;
+                }
+                if (due)
+                        next = syncer_now() + s->interval;
+        }
+        pthread_mutex_unlock(&s->mutex);
+        return NULL;
+}
+
+int syncer_new(MDB_env* env, double interval, size_t max_dirty, Syncer** ret) {
+        Syncer* s = calloc(1, sizeof(Syncer));
+        if (!s)
+                return ENOMEM;
+        s->env = env;
+        s->interval = interval;
+        s->max_dirty = max_dirty;
+        s->last_sync = syncer_now();
+        pthread_mutex_init(&s->mutex, NULL);
+        pthread_cond_init(&s->wake, NULL);
+
+        int rc = pthread_create(&s->thread, NULL, syncer_main, s);
+        if (rc) {
+                syncer_free(s);
+                return rc;
+        }
+        *ret = s;
+        return 0;
+}
+
+void syncer_stat(Syncer* s, SyncerStat* stat) {
+        pthread_mutex_lock(&s->mutex);
+        *stat = s->stat;
+        stat->unsynced = syncer_unsynced(s);
+        stat->lag = stat->unsynced ? syncer_now() - s->last_sync : 0;
+        pthread_mutex_unlock(&s->mutex);
+}
+
+// Stops the thread, then syncs whatever is left
+int syncer_stop(Syncer* s) {
+        pthread_mutex_lock(&s->mutex);
+        s->stopping = 1;
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->thread, NULL);
+
+        int rc = 0;
+        pthread_mutex_lock(&s->mutex);
+        if (syncer_unsynced(s))
+                rc = syncer_sync(s);
+        pthread_mutex_unlock(&s->mutex);
+        return rc;
+}
+
+void syncer_free(Syncer* s) {
+        pthread_cond_destroy(&s->wake);
+        pthread_mutex_destroy(&s->mutex);
+        free(s);
+}
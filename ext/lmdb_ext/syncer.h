@@ -0,0 +1,38 @@
+#ifndef _SYNCER_H
+#define _SYNCER_H
+
+#include <stddef.h>
+#include "lmdb.h"
+
+/*
+ * A background thread that syncs an environment opened with nosync or
+ * mapasync. Every interval seconds it syncs if anything was committed
+ * since the last sync, so a crash loses at most the last interval
+ * plus the time a sync takes. With max_dirty set, it also syncs as
+ * soon as that many bytes are waiting. Stopping it syncs one last
+ * time.
+ *
+ * Nothing in here touches Ruby, so stopping can run without the GVL.
+ */
+
+#define SYNCER_POLL 0.01        /* seconds between checks of max_dirty */
+
+typedef struct Syncer Syncer;
+
+typedef struct {
+        size_t syncs;           /* syncs completed */
+        size_t errors;          /* syncs that failed */
+        int    last_error;      /* error of the last failed sync */
+        double last_latency;    /* seconds taken by the last sync */
+        double max_latency;
+        double total_latency;
+        size_t unsynced;        /* bytes committed but not yet synced */
+        double lag;             /* seconds since the last sync, if unsynced */
+} SyncerStat;
+
+int  syncer_new(MDB_env* env, double interval, size_t max_dirty, Syncer** ret);
+void syncer_stat(Syncer* syncer, SyncerStat* stat);
+int  syncer_stop(Syncer* syncer);
+void syncer_free(Syncer* syncer);
+
+#endif
@@ -0,0 +1,322 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "write_queue.h"
+
+enum {
+        OP_PUT,
+        OP_DEL,
+        OP_BARRIER,
+};
+
+struct WriteOp {
+        WriteOp*     next;
+        int          type;
+        MDB_dbi      dbi;
+        unsigned int flags;
+        MDB_val      key;
+        MDB_val      value;
+        int          has_value;
+        int          rc;
+        int          done;
+        int          interrupted;
+        int          refs;      /* the queue's and the submitter's */
+        char         data[];
+};
+
+struct WriteQueue {
+        MDB_env*        env;
+        size_t          max_batch;
+        double          max_delay;
+        WriteOp*        head;           /* submitted, newest first */
+        WriteOp*        pending;        /* taken by the writer, oldest first */
+        WriteOp*        tail;
+        size_t          npending;
+        int             sleeping;       /* the writer wants a signal on submit */
+        int             closing;
+        pthread_t       thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t  work;
+        pthread_cond_t  done;
+        WriteQueueStat  stat;
+};
+
+static int write_op_new(int type, MDB_dbi dbi, const MDB_val* key, const MDB_val* value, unsigned int flags, WriteOp** ret) {
+        size_t ksize = key ? key->mv_size : 0, vsize = value ? value->mv_size : 0;
+        WriteOp* op = malloc(sizeof(WriteOp) + ksize + vsize);
+        if (!op)
+                return ENOMEM;
+        memset(op, 0, sizeof(WriteOp));
+        op->type = type;
+        op->dbi = dbi;
+        op->flags = flags;
+        op->refs = 2;
+        op->key.mv_size = ksize;
+        op->key.mv_data = op->data;
+        if (ksize)
+                memcpy(op->data, key->mv_data, ksize);
+        op->value.mv_size = vsize;
+        op->value.mv_data = op->data + ksize;
+        if (vsize)
+                memcpy(op->data + ksize, value->mv_data, vsize);
+        op->has_value = value != NULL;
+        *ret = op;
+        return 0;
+}
+
+// Lock-free push; the writer is only signalled when it is waiting
+static void write_queue_push(WriteQueue* q, WriteOp* op) {
+        WriteOp* head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+        do {
+                op->next = head;
+        } while (!__atomic_compare_exchange_n(&q->head, &head, op, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+        if (__atomic_load_n(&q->sleeping, __ATOMIC_SEQ_CST)) {
+                pthread_mutex_lock(&q->mutex);
+                pthread_cond_signal(&q->work);
+                pthread_mutex_unlock(&q->mutex);
+        }
+}
+
+// Move everything submitted so far to the end of the pending list
+static void write_queue_take(WriteQueue* q) {
+        WriteOp* op = __atomic_exchange_n(&q->head, NULL, __ATOMIC_SEQ_CST);
+        WriteOp *first = NULL, *last = op;
+        size_t n = 0;
+
+        while (op) {
+                WriteOp* next = op->next;
+                op->next = first;
+                first = op;
+                op = next;
+                n++;
+        }
+        if (!first)
+                return;
+        if (q->tail)
+                q->tail->next = first;
+        else
+                q->pending = first;
+        q->tail = last;
+        q->npending += n;
+}
+
+static int write_queue_submitted(WriteQueue* q) {
+        return __atomic_load_n(&q->head, __ATOMIC_SEQ_CST) != NULL;
+}
+
+// Keep the batch open until it is full or max_delay has passed
+static void write_queue_linger(WriteQueue* q) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double s = deadline.tv_nsec / 1e9 + q->max_delay;
+        deadline.tv_sec += (time_t)s;
+        deadline.tv_nsec = (long)((s - (time_t)s) * 1e9);
+
+        pthread_mutex_lock(&q->mutex);
+        __atomic_store_n(&q->sleeping, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+                write_queue_take(q);
+                if (q->npending >= q->max_batch || q->closing)
+                        break;
+                if (pthread_cond_timedwait(&q->work, &q->mutex, &deadline) == ETIMEDOUT) {
+                        write_queue_take(q);
+                        break;
+                }
+        }
+        __atomic_store_n(&q->sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&q->mutex);
+}
+
+static int write_op_apply(MDB_txn* txn, WriteOp* op) {
+        MDB_val key = op->key, value = op->value;
+        switch (op->type) {
+        case OP_PUT:
+                return mdb_put(txn, op->dbi, &key, &value, op->flags);
+        case OP_DEL:
+                return mdb_del(txn, op->dbi, &key, op->has_value ? &value : NULL);
+        default:
+                return 0;
+        }
+}
+
+// Apply up to max_batch pending operations in one transaction
+static void write_queue_apply(WriteQueue* q) {
+        WriteOp *first = q->pending, *end = first, *op, *next;
+        size_t n = 0, applied = 0;
+        int rc;
+
+        while (end && n < q->max_batch) {
+                end = end->next;
+                n++;
+        }
+        q->pending = end;
+        if (!end)
+                q->tail = NULL;
+        q->npending -= n;
+
+        MDB_txn* txn;
+        rc = mdb_txn_begin(q->env, NULL, 0, &txn);
+        if (!rc) {
+                for (op = first; op != end; op = op->next) {
+                        int r = write_op_apply(txn, op);
+                        if (r == MDB_NOTFOUND || r == MDB_KEYEXIST || r == MDB_BAD_VALSIZE) {
+                                op->rc = r;
+                        } else if (r) {
+                                rc = r;
+                                break;
+                        } else if (op->type != OP_BARRIER) {
+                                applied++;
+                        }
+                }
+                if (rc)
+                        mdb_txn_abort(txn);
+                else
+                        rc = mdb_txn_commit(txn);
+        }
+
+        pthread_mutex_lock(&q->mutex);
+        for (op = first; op != end; op = next) {
+                next = op->next;
+                if (rc)
+                        op->rc = rc;
+                __atomic_store_n(&op->done, 1, __ATOMIC_RELEASE);
+                write_op_release(op);
+        }
+        if (!rc && applied) {
+                q->stat.ops += applied;
+                q->stat.batches++;
+        }
+        pthread_cond_broadcast(&q->done);
+        pthread_mutex_unlock(&q->mutex);
+}
+
+static void* write_queue_main(void* arg) {
+        WriteQueue* q = (WriteQueue*)arg;
+
+        for (;;) {
+                write_queue_take(q);
+                if (q->pending) {
+                        if (q->max_delay > 0 && q->npending < q->max_batch)
+                                write_queue_linger(q);
+                        write_queue_apply(q);
+                        continue;
+                }
+
+                pthread_mutex_lock(&q->mutex);
+                __atomic_store_n(&q->sleeping, 1, __ATOMIC_SEQ_CST);
+                if (!write_queue_submitted(q) && !q->closing) {
+                        q->stat.sleeps++;
+                        pthread_cond_wait(&q->work, &q->mutex);
+                }
+                __atomic_store_n(&q->sleeping, 0, __ATOMIC_SEQ_CST);
+                int closing = q->closing;
+                pthread_mutex_unlock(&q->mutex);
+
+                if (closing && !write_queue_submitted(q))
+                        break;
+        }
+        return NULL;
+}
+
+int write_queue_new(MDB_env* env, size_t max_batch, double max_delay, WriteQueue** ret) {
+        WriteQueue* q = calloc(1, sizeof(WriteQueue));
+        if (!q)
+                return ENOMEM;
+        q->env = env;
+        q->max_batch = max_batch ? max_batch : 1;
+        q->max_delay = max_delay;
+        pthread_mutex_init(&q->mutex, NULL);
+        pthread_cond_init(&q->work, NULL);
+        pthread_cond_init(&q->done, NULL);
+
+        int rc = pthread_create(&q->thread, NULL, write_queue_main, q);
+        if (rc) {
+                pthread_cond_destroy(&q->done);
+                pthread_cond_destroy(&q->work);
+                pthread_mutex_destroy(&q->mutex);
+                free(q);
+                return rc;
+        }
+        *ret = q;
+        return 0;
+}
+
+int write_queue_put(WriteQueue* q, MDB_dbi dbi, const MDB_val* key, const MDB_val* value, unsigned int flags, WriteOp** ret) {
+        int rc = write_op_new(OP_PUT, dbi, key, value, flags, ret);
+        if (!rc)
+                write_queue_push(q, *ret);
+        return rc;
+}
+
+int write_queue_del(WriteQueue* q, MDB_dbi dbi, const MDB_val* key, const MDB_val* value, WriteOp** ret) {
+        int rc = write_op_new(OP_DEL, dbi, key, value, 0, ret);
+        if (!rc)
+                write_queue_push(q, *ret);
+        return rc;
+}
+
+// Completes once everything submitted before it has been committed
+int write_queue_barrier(WriteQueue* q, WriteOp** ret) {
+        int rc = write_op_new(OP_BARRIER, 0, NULL, NULL, 0, ret);
+        if (!rc)
+                write_queue_push(q, *ret);
+        return rc;
+}
+
+// Returns EINTR if write_queue_interrupt was called for op first
+int write_queue_wait(WriteQueue* q, WriteOp* op) {
+        pthread_mutex_lock(&q->mutex);
+        while (!op->done && !op->interrupted)
+                pthread_cond_wait(&q->done, &q->mutex);
+        int rc = op->done ? 0 : EINTR;
+        op->interrupted = 0;
+        pthread_mutex_unlock(&q->mutex);
+        return rc;
+}
+
+void write_queue_interrupt(WriteQueue* q, WriteOp* op) {
+        pthread_mutex_lock(&q->mutex);
+        op->interrupted = 1;
+        pthread_cond_broadcast(&q->done);
+        pthread_mutex_unlock(&q->mutex);
+}
+
+// Applies everything submitted so far, then stops the writer thread
+int write_queue_close(WriteQueue* q) {
+        pthread_mutex_lock(&q->mutex);
+        q->closing = 1;
+        pthread_cond_signal(&q->work);
+        pthread_mutex_unlock(&q->mutex);
+        return pthread_join(q->thread, NULL);
+}
+
+void write_queue_stat(WriteQueue* q, WriteQueueStat* stat) {
+        pthread_mutex_lock(&q->mutex);
+        *stat = q->stat;
+        pthread_mutex_unlock(&q->mutex);
+}
+
+void write_queue_free(WriteQueue* q) {
+        pthread_cond_destroy(&q->done);
+        pthread_cond_destroy(&q->work);
+        pthread_mutex_destroy(&q->mutex);
+        free(q);
+}
+
+int write_op_done(const WriteOp* op) {
+        return __atomic_load_n(&op->done, __ATOMIC_ACQUIRE);
+}
+
+int write_op_result(const WriteOp* op) {
+        return op->rc;
+}
+
+void write_op_release(WriteOp* op) {
+        if (__atomic_sub_fetch(&op->refs, 1, __ATOMIC_ACQ_REL) == 0)
+                free(op);
+}
@@ -0,0 +1,46 @@
+#ifndef _WRITE_QUEUE_H
+#define _WRITE_QUEUE_H
+
+#include <stddef.h>
+#include "lmdb.h"
+
+/*
+ * A background thread that owns the write transaction of an
+ * environment. Any number of threads submit puts and deletes; they
+ * are pushed onto a lock-free stack, and the writer thread takes the
+ * whole stack at once, applies up to max_batch operations in one
+ * transaction and commits. When max_delay is set, the writer holds a
+ * batch open for up to that many seconds to let it fill up.
+ *
+ * Every operation has its own result, which can be waited for. An
+ * operation that fails with MDB_NOTFOUND or MDB_KEYEXIST fails on its
+ * own; any other error fails the whole batch.
+ *
+ * Nothing in here touches Ruby, so waiting and closing can run
+ * without the GVL.
+ */
+
+typedef struct WriteQueue WriteQueue;
+typedef struct WriteOp WriteOp;
+
+typedef struct {
+        size_t ops;             /* operations applied */
+        size_t batches;         /* transactions committed */
+        size_t sleeps;          /* times the writer ran out of work */
+} WriteQueueStat;
+
+int  write_queue_new(MDB_env* env, size_t max_batch, double max_delay, WriteQueue** ret);
+int  write_queue_put(WriteQueue* queue, MDB_dbi dbi, const MDB_val* key, const MDB_val* value, unsigned int flags, WriteOp** ret);
+int  write_queue_del(WriteQueue* queue, MDB_dbi dbi, const MDB_val* key, const MDB_val* value, WriteOp** ret);
+int  write_queue_barrier(WriteQueue* queue, WriteOp** ret);
+int  write_queue_wait(WriteQueue* queue, WriteOp* op);
+void write_queue_interrupt(WriteQueue* queue, WriteOp* op);
+int  write_queue_close(WriteQueue* queue);
+void write_queue_stat(WriteQueue* queue, WriteQueueStat* stat);
+void write_queue_free(WriteQueue* queue);
+
+int  write_op_done(const WriteOp* op);
+int  write_op_result(const WriteOp* op);
+void write_op_release(WriteOp* op);
+
+#endif
@@ -1,6 +1,8 @@
 require 'lmdb'
 require 'rspec'
 require 'fileutils'
+require 'fiddle'
+require 'timeout'
 
 SPEC_ROOT = File.dirname(__FILE__)
 TEMP_ROOT = File.join(SPEC_ROOT, 'tmp')
@@ -19,6 +21,20 @@ module LMDB::SpecHelper
   def env
     @env ||= LMDB::Environment.new :path => path
   end
+
+  # Number of pages of the file dirty in the page cache, from the Linux
+  # cachestat(2) system call, or nil where it is not available
+  def dirty_pages(file)
+    return nil unless RUBY_PLATFORM =~ /linux/
+    syscall = Fiddle::Function.new(Fiddle::Handle::DEFAULT['syscall'],
+      [Fiddle::TYPE_LONG, Fiddle::TYPE_INT, Fiddle::TYPE_VOIDP, Fiddle::TYPE_VOIDP, Fiddle::TYPE_INT],
+      Fiddle::TYPE_LONG)
+    File.open(file) do |f|
+      stat = "\0" * 40
+      return nil if syscall.call(451, f.fileno, [0, 0].pack('Q2'), stat, 0) != 0
+      stat.unpack('Q5')[1]
+    end
+  end
 end
 
 RSpec.configure do |c|
@@ -48,6 +48,50 @@ describe LMDB do
         env.flags.should_not include(:nosync)
         env.close
       end
+
+      it 'accepts a dirty page budget' do
+        proc { LMDB.new(path, :maxdirty => 10) }.should raise_error(LMDB::Error)
+        env = LMDB.new(path, :mapsize => 1 << 26, :maxdirty => 256)
+        env.info[:maxdirty].should == 256
+        db = env.database
+        keys = (1..20000).map { |i| '%08d' % i }.shuffle(:random => Random.new(1))
+        env.transaction do
+          keys.each { |k| db[k] = k * 8 }
+          keys.first(5000).each { |k| db.delete(k) }
+          keys.each { |k| db[k] = 'x' if db[k] }
+        end
+        db.size.should == 15000
+        db.to_a.should == keys.drop(5000).sort.map { |k| [k, 'x'] }
+        env.close
+      end
+
+      it 'accepts group commit' do
+        proc { LMDB.new(path, :group_commit => true, :writemap => true) }.should raise_error(LMDB::Error)
+        env = LMDB.new(path, :group_commit => true)
+        db = env.database
+        txnid = env.info[:last_txnid]
+        threads = 8.times.map do |t|
+          Thread.new do
+            50.times.map do |i|
+              begin
+                env.transaction do
+                  db["#{t}-#{i}"] = 'value'
+                  raise 'fail' if i % 10 == 3
+                end
+                true
+              rescue RuntimeError
+                db["#{t}-#{i}"].should be_nil
+                false
+              end
+            end
+          end
+        end
+        threads.map(&:value).flatten.count(true).should == 360
+        db.size.should == 360
+        # one commit per transaction would take 360 txnids; the batches take about 50
+        (env.info[:last_txnid] - txnid).should <= 100
+        env.close
+      end
     end
 
     it 'should return stat' do
@@ -83,6 +127,390 @@ describe LMDB do
       subject.sync(true).should be_nil
     end
 
+    it 'should sync in the background' do
+      env = LMDB.new(path, :nosync => true)
+      db = env.database
+      env.sync_stat.should be_nil
+      proc { env.auto_sync(:interval => 0) }.should raise_error(LMDB::Error)
+
+      env.auto_sync(:interval => 0.01)
+      db['key'] = 'value'
+      env.sync_stat[:unsynced_bytes].should > 0
+      sleep 0.01 until env.sync_stat[:syncs] > 0
+      env.sync_stat[:unsynced_bytes].should == 0
+      env.sync_stat[:lag].should == 0
+
+      env.auto_sync(:interval => 1000, :max_dirty_bytes => 1 << 16)
+      100.times { |i| db["key#{i}"] = 'value' * 100 }
+      sleep 0.01 until env.sync_stat[:syncs] > 0
+      env.auto_sync(false)
+      env.sync_stat.should be_nil
+      env.close
+    end
+
+    it 'should pipeline commits' do
+      proc { LMDB.new(path, :pipeline => true, :writemap => true) }.should raise_error(LMDB::Error)
+
+      env = LMDB.new(path, :pipeline => true)
+      env.flags.should include(:pipeline)
+      db = env.database
+      db['key'] = 'value'
+      env.writer do |writer|
+        threads = 4.times.map do |t|
+          Thread.new { 100.times.map { |i| writer.put(db, "#{t}-#{i}", 'value') }.each(&:value) }
+        end
+        threads.each(&:join)
+        db.size.should == 401
+        writer.delete(db, 'key').value.should be_nil
+      end
+      db['key'].should be_nil
+      env.close
+
+      env = LMDB.new(path)
+      env.database.size.should == 400
+      env.close
+    end
+
+    it 'should keep pipelined commits of a killed writer that were durable' do
+      LMDB.new(path) { |env| env.database }
+      reader, output = IO.pipe
+      pid = fork do
+        reader.close
+        output.sync = true
+        env = LMDB.new(path, :pipeline => true, :group_commit => true)
+        db = env.database
+        threads = 4.times.map do |t|
+          Thread.new do
+            (0..Float::INFINITY).each do |i|
+              key = '%d-%08d' % [t, i]
+              env.transaction { db[key] = 'v' * 100 }
+              output.puts key
+            end
+          end
+        end
+        threads.each(&:join)
+      end
+      output.close
+      durable = 200.times.map { reader.gets.chomp }
+      Process.kill(:KILL, pid)
+      Process.wait(pid)
+      reader.close
+
+      # a writer in another process carries on past the killed one
+      env = LMDB.new(path, :pipeline => true)
+      db = env.database
+      durable.each { |key| db[key].should == 'v' * 100 }
+      db.size.should >= durable.size
+      db['next'] = 'value'
+      db['next'].should == 'value'
+      env.close
+    end
+
+    it 'should pipeline commits from several processes' do
+      LMDB.new(path) { |env| env.database }
+      pids = 3.times.map do |p|
+        fork do
+          env = LMDB.new(path, :pipeline => true)
+          db = env.database
+          400.times { |i| env.transaction { db.put("#{p}-#{i}", 'value') } }
+          env.close
+          exit!(0)
+        end
+      end
+      pids.each { |pid| Process.wait(pid); $?.exitstatus.should == 0 }
+      env = LMDB.new(path)
+      env.database.size.should == 1200
+      env.close
+    end
+
+    it 'should write pages through io_uring if available' do
+      env = LMDB.new(path, :io_uring => true, :maxdirty => 64)
+      db = env.database
+      env.info[:io_uring_ops].should == 0
+      env.transaction { 1000.times { |i| db.put("key#{i}", 'value' * 100) } }
+      if env.flags.include?(:io_uring)
+        env.info[:io_uring_ops].should > 0
+      else
+        env.info[:io_uring_ops].should == 0
+      end
+      env.close
+
+      env = LMDB.new(path)
+      env.flags.should_not include(:io_uring)
+      db = env.database
+      db.size.should == 1000
+      db['key999'].should == 'value' * 100
+      env.close
+    end
+
+    it 'should sync writemap commits' do
+      env = LMDB.new(path, :writemap => true)
+      db = env.database
+      env.transaction { 1000.times { |i| db.put("key#{i}", 'value' * 100) } }
+      env.set_flags :nosync
+      db['key0'] = 'unsynced'
+      env.clear_flags :nosync
+      [1, 500, 999].each { |i| db["key#{i}"] = 'synced' }
+      env.close
+
+      env = LMDB.new(path)
+      db = env.database
+      db.size.should == 1000
+      db['key0'].should == 'unsynced'
+      db['key500'].should == 'synced'
+      env.close
+    end
+
+    it 'should sync the spilled pages of a writemap commit' do
+      env = LMDB.new(path, :writemap => true, :maxdirty => 64, :mapsize => 1 << 26)
+      db = env.database
+      env.transaction { 5000.times { |i| db.put("key#{i}", 'value' * 100) } }
+      env.info[:last_pgno].should > 64
+      dirty = dirty_pages(File.join(path, 'data.mdb'))
+      dirty.should == 0 if dirty
+      env.close
+    end
+
+    it 'should take keys up to the maximum key size' do
+      env = LMDB.new(path, :mapsize => 1 << 24)
+      db = env.database
+      max = env.max_key_size
+      max.should > 511
+      keys = (0...200).map { |i| '%04d' % i + 'k' * (max - 4) }.shuffle(random: Random.new(42))
+      env.transaction { keys.each { |k| db.put(k, 'value') } }
+      keys.each { |k| db.get(k).should == 'value' }
+      db.size.should == 200
+
+      proc { db.put('k' * (max + 1), 'value') }.should raise_error(LMDB::Error::BAD_VALSIZE)
+      proc { db.get('k' * (max + 1)) }.should raise_error(LMDB::Error::BAD_VALSIZE)
+      env.active_txn.should be_nil
+
+      dup = env.database('dup', :create => true, :dupsort => true)
+      env.transaction { 3.times { |i| dup.put(keys[i], i.to_s * max) } }
+      dup.cursor { |c| c.set(keys[1]); c.count.should == 1 }
+      env.transaction { 3.times { |i| dup.put(keys[0], i.to_s + 'x' * (max - 1)) } }
+      dup.cursor { |c| c.set(keys[0]); c.count.should == 4 }
+      proc { dup.put('a', 'v' * (max + 1)) }.should raise_error(LMDB::Error::BAD_VALSIZE)
+      env.close
+    end
+
+    it 'should put and delete random keys near the maximum key size' do
+      env = LMDB.new(path, :mapsize => 1 << 26)
+      db = env.database
+      max = env.max_key_size
+      random = Random.new(7)
+      keys = (0...1500).map do |i|
+        len = max - random.rand(4)
+        shared = random.rand(len - 6)
+        'k' * shared + '%06d' % i + (0...len - shared - 6).map { (97 + random.rand(26)).chr }.join
+      end
+      expected = {}
+      20.times do |round|
+        env.transaction do
+          400.times do
+            i = random.rand(keys.size)
+            if random.rand(3) == 0
+              db.delete(keys[i]) if expected.delete(keys[i])
+            else
+              db.put(keys[i], i.to_s)
+              expected[keys[i]] = i.to_s
+            end
+          end
+          if round % 5 == 4
+            expected.keys.sort.each_with_index do |k, n|
+              next if n % 8 == 0
+              db.delete(k)
+              expected.delete(k)
+            end
+          end
+        end
+      end
+      db.to_a.should == expected.sort
+      env.close
+    end
+
+    it 'should store the key prefix of a leaf page once' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 4)
+      plain = env.database('plain', :create => true)
+      pfx = env.database('pfx', :create => true, :prefixkey => true)
+      keys = (0...2000).map { |i| 'tenant/42/namespace/orders/2014-01-01/%06d' % i }
+      order = keys.shuffle(random: Random.new(42))
+      env.transaction { order.each { |k| plain.put(k, 'value'); pfx.put(k, 'value') } }
+      env.transaction { order.first(500).each { |k| pfx.delete(k) } }
+      rest = keys - order.first(500)
+      rest.each { |k| pfx.get(k).should == 'value' }
+      pfx.map { |k, v| k }.should == rest
+      gone = order.first(500).sort[100]
+      after = rest.select { |k| k > gone }
+      pfx.cursor { |c| c.set_range(gone).should == [after[0], 'value']; c.next.should == [after[1], 'value'] }
+      pfx.stat[:leaf_pages].should < plain.stat[:leaf_pages] / 2
+      proc { env.database('bad', :create => true, :prefixkey => true, :dupsort => true) }.should raise_error(LMDB::Error)
+      env.close
+    end
+
+    it 'should mark the data file once it holds a prefix-compressed database' do
+      # Older libraries only check the format version in the meta pages
+      env = LMDB.new(path, :maxdbs => 4)
+      psize = env.stat[:psize]
+      versions = proc { [0, 1].map { |i| File.binread(File.join(path, 'data.mdb'), 4, i * psize + 20).unpack('L')[0] } }
+      env.database('plain', :create => true)
+      versions.call.should == [1, 1]
+      pfx = env.database('pfx', :create => true, :prefixkey => true)
+      pfx['key'] = 'value'
+      env.close
+      versions.call.should == [2, 2]
+      LMDB.new(path, :maxdbs => 4) do |env|
+        env.database('pfx')['key'].should == 'value'
+      end
+    end
+
+    it 'should keep only the distinguishing part of long keys in branch pages' do
+      env = LMDB.new(path, :mapsize => 1 << 24)
+      db = env.database
+      rng = Random.new(42)
+      keys = (0...400).map { '%08x' % rng.rand(1 << 32) + 'k' * 1000 }.uniq
+      env.transaction { keys.each { |k| db.put(k, 'value') } }
+      db.stat[:depth].should == 2
+      keys.each { |k| db.get(k).should == 'value' }
+      env.transaction { keys.first(300).each { |k| db.delete(k) } }
+      db.map { |k, v| k }.should == keys.drop(300).sort
+      env.close
+    end
+
+    it 'should split pages at the given ratio' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 4)
+      plain = env.database('plain', :create => true)
+      packed = env.database('packed', :create => true, :split_ratio => 0.1, :merge_threshold => 0.1)
+      keys = (0...5000).map { |i| '%08d' % i }.reverse
+      env.transaction { keys.each { |k| plain.put(k, 'value'); packed.put(k, 'value') } }
+      packed.stat[:leaf_pages].should < plain.stat[:leaf_pages] * 2 / 3
+      packed.size.should == 5000
+
+      fill = packed.fill_histogram
+      fill[:leaf].size.should == 10
+      fill[:leaf].inject(:+).should == packed.stat[:leaf_pages]
+      fill[:branch].inject(:+).should == packed.stat[:branch_pages]
+      fill[:leaf][8..9].inject(:+).should > packed.stat[:leaf_pages] * 3 / 4
+      plain.fill_histogram(2)[:leaf].inject(:+).should == plain.stat[:leaf_pages]
+
+      proc { env.database('bad', :create => true, :split_ratio => 1.5) }.should raise_error(LMDB::Error)
+      proc { env.database('bad', :create => true, :merge_threshold => 0.6) }.should raise_error(LMDB::Error)
+      proc { env.database('bad', :create => true, :split_ratio => 0.9) }.should raise_error(LMDB::Error, /merge threshold/)
+      proc { env.database('bad', :create => true, :split_ratio => 0.3, :merge_threshold => 0.4) }.should raise_error(LMDB::Error, /merge threshold/)
+      proc { env.database('bad') }.should raise_error(LMDB::Error::NOTFOUND)
+      env.database('good', :create => true, :split_ratio => 0.9, :merge_threshold => 0.1)
+      env.close
+    end
+
+    it 'should allocate overflow pages from runs in a fragmented freelist' do
+      pages = [2, 3, 5, 8, 13]
+      value = proc { |i, n| ('%06d' % i) * (n * 4096 / 6 - 100) }
+      env = LMDB.new(path, :mapsize => 1 << 28)
+      db = env.database
+      env.transaction { 1000.times { |i| db.put('%06d' % i, value[i, pages[i % 5]]) } }
+      env.transaction { 1000.times { |i| db.delete('%06d' % i) if i % 5 != 4 && i % 3 != 0 } }
+      # Two empty commits so the freed pages become reusable
+      2.times { env.transaction { db.put('pad', '') } }
+      env.close
+
+      env = LMDB.new(path, :mapsize => 1 << 28)
+      db = env.database
+      last_pgno = env.info[:last_pgno]
+      expected = db.to_a
+      env.transaction do
+        300.times do |i|
+          db.put("blob#{i}", value[i, pages[i % 4]])
+          expected << ["blob#{i}", value[i, pages[i % 4]]]
+        end
+      end
+      env.info[:last_pgno].should == last_pgno
+      db.to_a.should == expected.sort
+      env.close
+    end
+
+    it 'should take dirty pages from an arena' do
+      LMDB.new(path) { |env| env.arena_stat.should be_nil }
+      proc { LMDB.new(path, :arena => 1 << 20, :hugepages => :yes) }.should raise_error(LMDB::Error)
+
+      env = LMDB.new(path, :arena => 1 << 20, :arena_retain => 1 << 16, :maxdirty => 64, :hugepages => :thp)
+      db = env.database
+      env.transaction do
+        1000.times { |i| db.put("key#{i}", 'value' * 20) }
+        env.transaction { db.put('big', 'x' * 100_000); db.delete('key0'); env.active_txn.abort }
+        db.put('big', 'y' * 100_000)
+      end
+      db.size.should == 1001
+      db['big'].should == 'y' * 100_000
+      db['key0'].should == 'value' * 20
+
+      stat = env.arena_stat
+      stat[:size].should == 2 << 20
+      stat[:resident].should > 0
+      stat[:resident].should <= 2 << 20
+      stat[:pages].should > stat[:reused]
+      stat[:hugetlb].should == false
+      env.close
+    end
+
+    it 'should merge nested transactions into an arena' do
+      env = LMDB.new(path, :arena => 64 << 20, :maxdirty => 256)
+      db = env.database
+      env.transaction do
+        2000.times { |i| db.put("key#{i}", 'a' * 50) }
+        5.times { |i| db.put("big#{i}", 'a' * (5000 << i)) }
+        env.transaction do
+          2000.times { |i| db.put("key#{i}", 'b' * 50) }
+          5.times { |i| db.put("big#{i}", 'b' * (5000 << i)) }
+        end
+        env.transaction do
+          db.put('big0', 'c' * 5000)
+          db.put('key0', 'c')
+        end
+      end
+      db.size.should == 2005
+      db['key0'].should == 'c'
+      db['key1999'].should == 'b' * 50
+      db['big0'].should == 'c' * 5000
+      db['big4'].should == 'b' * 80000
+      env.close
+    end
+
+    it 'should create environments with a larger page size' do
+      proc { LMDB.new(path, :pagesize => 3000) }.should raise_error(LMDB::Error)
+      proc { LMDB.new(path, :pagesize => 1 << 16) }.should raise_error(LMDB::Error)
+
+      env = LMDB.new(path, :pagesize => 1 << 15, :mapsize => 1 << 26)
+      db = env.database
+      keys = (0...2000).to_a.shuffle(random: Random.new(42))
+      env.transaction { keys.each { |i| db.put('%04d' % i, 'x' * (2000 + i * 3)) } }
+      db.stat[:psize].should == 1 << 15
+      db.stat[:overflow_pages].should == 0
+      env.transaction { keys.each { |i| db.delete('%04d' % i) if i % 3 > 0 } }
+      env.close
+
+      env = LMDB.new(path, :pagesize => 1 << 12)
+      db = env.database
+      db.stat[:psize].should == 1 << 15
+      db.size.should == 667
+      db['1998'].should == 'x' * 7994
+      env.close
+    end
+
+    it 'should share reader slots between threads' do
+      env = LMDB.new(path, :maxreaders => 8)
+      env.database['key'] = 'value'
+      ready, done = Queue.new, Queue.new
+      threads = 8.times.map do
+        Thread.new { env.transaction(true) { ready << env.database['key']; done.pop } }
+      end
+      8.times { ready.pop.should == 'value' }
+      proc { env.transaction(true) { } }.should raise_error(LMDB::Error::READERS_FULL)
+      threads.each { done << true }.each(&:join)
+      100.times { env.database['key'].should == 'value' }
+      env.info[:numreaders].should == 8
+      env.close
+    end
+
     it 'should accept custom flags' do
       subject.flags.should_not include(:nosync)
 
@@ -183,6 +611,16 @@ describe LMDB do
       db2['key'].should == '3'
     end
 
+    it 'should reuse transactions across databases' do
+      dbs = (1..10).map { |i| env.database("db#{i}", :create => true) }
+      100.times do |i|
+        db = dbs[i % 10]
+        env.transaction { db[i.to_s] = i.to_s; db.cursor { |c| c.last } }
+        env.transaction(true) { db[i.to_s].should == i.to_s }
+      end
+      dbs.map(&:size).should == [10] * 10
+    end
+
     it 'should get/put data' do
       subject.get('cat').should be_nil
       subject.put('cat', 'garfield').should be_nil
@@ -250,6 +688,250 @@ describe LMDB do
       db[bin1].should == bin2
       db['key'].should == bin2
     end
+
+    it 'should delete a range of keys' do
+      env.transaction { (0...20000).each { |i| db.put('r%05d' % i, 'x' * (i % 50)) } }
+      db.delete_range('r00100', 'r19900').should == 19800
+      db.size.should == 200
+      db.get('r00099').should == 'x' * 49
+      db.get('r00100').should be_nil
+      db.get('r19899').should be_nil
+      db.get('r19900').should == ''
+      db.delete_range('r00050', 'r00050').should == 0
+      db.delete_range(nil, 'r00010').should == 10
+      db.delete_range('r19950', nil).should == 50
+      db.map { |k, v| k }.should == (10...100).map { |i| 'r%05d' % i } + (19900...19950).map { |i| 'r%05d' % i }
+      db.delete_range(nil, nil).should == 140
+      db.size.should == 0
+    end
+
+    it 'should delete ranges of keys near the maximum key size' do
+      env = LMDB.new(path, :mapsize => 1 << 26)
+      db = env.database
+      max = env.max_key_size
+      random = Random.new(3)
+      keys = (0...2000).map do |i|
+        shared = random.rand(max - 8)
+        'k' * shared + '%06d' % i + 'x' * (max - shared - 7 - random.rand(2))
+      end.sort
+      expected = {}
+      put = proc { |list| env.transaction { list.each { |k| db.put(k, k[-20..-1]); expected[k] = k[-20..-1] } } }
+      put[keys.shuffle(:random => random)]
+      10.times do
+        from, to = [random.rand(keys.size), random.rand(keys.size)].sort
+        # a key between two stored keys leaves part of the first leaf
+        from = keys[from] + "\0"
+        inside = expected.keys.select { |k| k >= from && k < keys[to] }
+        db.delete_range(from, keys[to]).should == inside.size
+        inside.each { |k| expected.delete(k) }
+        put[keys.sample(50, :random => random)]
+      end
+      db.to_a.should == expected.sort
+      db.delete_range(nil, nil).should == expected.size
+      db.size.should == 0
+      env.close
+    end
+
+    it 'should delete a range of keys with duplicates' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 2)
+      dups = env.database('dups', :create => true, :dupsort => true)
+      count = proc { |i| i % 100 == 0 ? 500 : 1 + i % 3 }
+      env.transaction do
+        (0...3000).each { |i| count[i].times { |d| dups.put('d%04d' % i, d.to_s) } }
+      end
+      dups.delete_range('d0100', 'd2900').should == (100...2900).map(&count).inject(:+)
+      dups.size.should == ((0...100).map(&count) + (2900...3000).map(&count)).inject(:+)
+      dups.cursor { |c| c.set('d0099'); c.count }.should == 1
+      dups.cursor { |c| c.set('d2900'); c.count }.should == 500
+      env.close
+    end
+
+    it 'should estimate the size of a range of keys' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 2, :pagesize => 4096)
+      db = env.database('estimate', :create => true)
+      db.estimate_range(nil, nil)[:entries].should == 0
+      env.transaction { (0...20000).each { |i| db.put('e%05d' % (i * 7 % 20000), 'x' * (i % 60)) } }
+      db.estimate_range(nil, nil).should == db.stat
+      db.estimate_range('e00100', 'e00110')[:entries].should == 10
+      db.estimate_range('e00500', 'e00100')[:entries].should == 0
+      [[nil, 'e05000'], ['e02500', 'e17500'], ['e12000', 'e12900'], ['e19000', nil]].each do |from, to|
+        exact = ((from || 'e00000')[1..-1].to_i...(to || 'e20000')[1..-1].to_i).size
+        estimate = db.estimate_range(from, to)
+        # Each end is placed as if all pages below a branch held as many
+        # keys; with these fills that is off by under 1% of the entries.
+        (estimate[:entries] - exact).abs.should <= db.stat[:entries] / 100
+        estimate[:leaf_pages].should <= db.stat[:leaf_pages]
+      end
+
+      # With the 4K pages set above, these fills leave e11921-e11927 alone
+      # on a leaf and e12145-e12228 on another, where the keys are counted
+      # exactly.
+      [['e11922', 'e11927', 5], ['e11921', 'e11927', 6], ['e12150', 'e12220', 70]].each do |from, to, exact|
+        estimate = db.estimate_range(from, to)
+        estimate[:entries].should == exact
+        estimate[:leaf_pages].should == 1
+      end
+      env.close
+    end
+
+    it 'should find and delete integer duplicates' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 2)
+      ['L', 'Q'].each do |pack|
+        dups = env.database(pack, :create => true, :dupsort => true, :dupfixed => true, :integerdup => true)
+        values = (0...3000).map { |i| i * 7 + (i % 3 == 0 ? 1 << 31 : 0) }
+        env.transaction { values.shuffle.each { |v| dups.put('key', [v].pack(pack)) } }
+        env.transaction do
+          values.each_with_index { |v, i| dups.delete('key', [v].pack(pack)) if i.odd? }
+          proc { dups.delete('key', [values[1]].pack(pack)) }.should raise_error(LMDB::Error::NOTFOUND)
+          proc { dups.delete('key', [values[0] + 1].pack(pack)) }.should raise_error(LMDB::Error::NOTFOUND)
+        end
+        dups.cursor { |c| c.set('key'); c.count }.should == 1500
+      end
+      env.close
+    end
+
+    it 'should find integer keys however they are spread' do
+      env = LMDB.new(path, :mapsize => 1 << 24, :maxdbs => 2)
+      ints = env.database('ints', :create => true, :integerkey => true)
+      keys = (0...5000).map { |i| i % 3 == 0 ? i : i % 3 == 1 ? i * 1_000_003 : i << 40 }.sort
+      env.transaction { keys.shuffle.each { |k| ints.put([k].pack('Q'), k.to_s) } }
+      env.transaction(true) do
+        keys.each { |k| ints.get([k].pack('Q')).should == k.to_s }
+        ints.get([keys[1] + 1].pack('Q')).should be_nil
+        ints.cursor do |c|
+          keys.each_cons(2).select { |a, b| b > a + 1 }.sample(200, random: Random.new(1)).each do |a, b|
+            c.set_range([a + 1].pack('Q')).should == [[b].pack('Q'), b.to_s]
+          end
+        end
+      end
+      env.close
+    end
+
+    it 'should bulk load sorted pairs' do
+      pairs = (1..20000).map { |i| ['%08d' % i, "value#{i}" * (i % 7)] }
+      pairs << ['99999999', 'x' * 10000]
+      db.bulk_load(pairs)
+      db.size.should == 20001
+      db.to_a.should == pairs
+      db.stat[:depth].should > 1
+      db.stat[:overflow_pages].should > 0
+
+      (1..20000).step(3) { |i| db.delete('%08d' % i) }
+      db['00000002'] = 'changed'
+      db['00000002'].should == 'changed'
+      db['00019998'].should == 'value19998' * 6
+      db['00019999'].should be_nil
+      db.size.should == 20001 - 6667
+    end
+
+    it 'should bulk load pages to the requested fill' do
+      pairs = (1..5000).map { |i| ['%08d' % i, 'value'] }
+      full = env.database('full', :create => true)
+      half = env.database('half', :create => true)
+      full.bulk_load(pairs.each)
+      half.bulk_load(pairs, :fill => 0.5)
+      half.stat[:leaf_pages].should > full.stat[:leaf_pages] * 3 / 2
+      half.to_a.should == pairs
+    end
+
+    it 'should refuse unsorted or non-empty bulk loads' do
+      proc { db.bulk_load([['b', '1'], ['a', '2']]) }.should raise_error(LMDB::Error)
+      db.size.should == 0
+      db['a'] = '1'
+      proc { db.bulk_load([['b', '1']]) }.should raise_error(LMDB::Error)
+    end
+
+    it 'should ingest unsorted pairs through sorted runs' do
+      env = LMDB.new(path, :mapsize => 1 << 26)
+      db = env.database
+      keys = (1..60000).map { |i| '%08d' % i }.shuffle(:random => Random.new(1))
+      pairs = keys.map { |k| [k, k * 2] } + keys.first(100).map { |k| [k, 'last'] }
+      stat = db.ingest(pairs, :memory => 1 << 20, :tmpdir => mkpath('sort'))
+      stat[:records].should == 60100
+      stat[:entries].should == 60000
+      stat[:runs].should > 1
+      stat[:spilled].should > 0
+      stat[:peak_rss].should > 0
+
+      db.size.should == 60000
+      db.to_a.should == keys.sort.map { |k| [k, k * 2] }.each { |p| p[1] = 'last' if keys.first(100).include?(p[0]) }
+      Dir.entries(mkpath('sort')).size.should == 2
+      env.close
+    end
+
+    it 'should ingest in memory' do
+      [-1, 0, 1 << 19].each do |memory|
+        proc { db.ingest([['a', '1']], :memory => memory) }.should raise_error(LMDB::Error)
+      end
+      stat = db.ingest([['b', '1'], ['a', '2'], ['b', '3']])
+      stat[:runs].should == 0
+      db.to_a.should == [['a', '2'], ['b', '3']]
+      proc { db.ingest([['c', '1']]) }.should raise_error(LMDB::Error)
+    end
+  end
+
+  describe LMDB::Writer do
+    it 'should apply writes from many threads in batches' do
+      writer = env.writer(:max_batch => 100)
+      threads = 8.times.map do |t|
+        Thread.new { 200.times.map { |i| writer.put(db, "#{t}-#{i}", 'value') }.each(&:value) }
+      end
+      threads.each(&:join)
+      db.size.should == 1600
+      writer.stat[:ops].should == 1600
+      writer.stat[:batches].should >= 16
+
+      writer.delete(db, '0-0').value.should be_nil
+      proc { writer.delete(db, '0-0').value }.should raise_error(LMDB::Error::NOTFOUND)
+      proc { writer.put(db, '0-1', 'x', :nooverwrite => true).value }.should raise_error(LMDB::Error::KEYEXIST)
+      writer.put(db, '0-2', 'changed')
+      writer.flush
+      db['0-2'].should == 'changed'
+
+      proc { env.close }.should raise_error(LMDB::Error)
+      writer.close
+      proc { writer.put(db, 'key', 'value') }.should raise_error(LMDB::Error)
+    end
+
+    it 'should refuse to wait for the writer in a write transaction' do
+      writer = env.writer
+      Timeout.timeout(10) do
+        future = nil
+        env.transaction do
+          db.put('a', '1')
+          future = writer.put(db, 'b', '2')
+          proc { future.value }.should raise_error(LMDB::Error)
+          proc { writer.flush }.should raise_error(LMDB::Error)
+          proc { writer.close }.should raise_error(LMDB::Error)
+        end
+        future.value.should be_nil
+        env.transaction(true) { writer.put(db, 'c', '3').value.should be_nil }
+        writer.close
+      end
+      db.to_a.should == [['a', '1'], ['b', '2'], ['c', '3']]
+    end
+
+    it 'should close the writer after the block' do
+      env.writer { |writer| writer.put(db, 'key', 'value') }
+      db['key'].should == 'value'
+    end
+
+    it 'should finish a writer that was never closed' do
+      pid = fork do
+        $stderr.reopen(File::NULL)
+        env = LMDB.new(path)
+        db = env.database
+        writer = env.writer(:max_delay => 60)
+        500.times { |i| writer.put(db, "key#{i}", 'value') }
+        writer = nil
+        GC.start
+        # still open, and applied when the process exits
+        proc { env.close }.should raise_error(LMDB::Error)
+      end
+      Process.wait(pid)
+      $?.exitstatus.should == 0
+      LMDB.new(path) { |env| env.database.size.should == 500 }
+    end
   end
 
   describe LMDB::Cursor do
@@ -294,5 +976,35 @@ describe LMDB do
         c.set_range('\x00').should == ['key1', 'value1']
       end
     end
+
+    it 'should seek forward from the current position' do
+      env.transaction { (0...5000).each { |i| db.put('k%05d' % (i * 2), i.to_s) } }
+      db.cursor do |c|
+        c.seek_forward('k00000').should == ['k00000', '0']
+        [1, 2, 3, 301, 302, 4001, 9998].each do |i|
+          c.seek_forward('k%05d' % i).should == ['k%05d' % ((i + 1) / 2 * 2), ((i + 1) / 2).to_s]
+        end
+        c.seek_forward('k00010').should == ['k00010', '5']
+        c.seek_forward('key1').should == ['key1', 'value1']
+        proc { c.seek_forward('kz') }.should raise_error(LMDB::Error::NOTFOUND)
+      end
+    end
+
+    it 'should put keys near the current position' do
+      expected = {}
+      env.transaction do
+        db.cursor do |c|
+          (0...3000).each do |i|
+            k = 'n%05d' % ((i % 7 == 0 ? i * 7919 : i * 3) % 20000)
+            c.put(k, i.to_s, :nearby => true)
+            expected[k] = i.to_s
+          end
+          c.put('key1', 'other', :nearby => true)
+          expected['key1'] = 'other'
+        end
+      end
+      expected.each { |k, v| db.get(k).should == v }
+      db.stat[:entries].should == expected.size + 1
+    end
   end
 end